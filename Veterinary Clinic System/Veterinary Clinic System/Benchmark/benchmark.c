@@ -0,0 +1,1354 @@
+// Benchmarks for the clinic data structures (not part of the VS solution)
+//
+// Build and run from this folder ("make benchmark" does the same):
+//     gcc -std=c11 -O2 -pthread -I.. benchmark.c ../clinic.c ../core.c ../import.c ../index.c
+//         ../journal.c ../mapfile.c ../replay.c ../report.c ../scan.c ../stats.c ../store.c
+//         ../thread.c ../trace.c -o benchmark
+//     ./benchmark
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "clinic.h"
+#include "import.h"
+#include "report.h"
+#include "scan.h"
+#include "thread.h"
+
+#define LINEAR_LOOKUPS 1000
+#define HASH_LOOKUPS 1000000
+
+#define CONFLICT_CHECKS 1000000
+#define JOURNAL_CHANGES 10000
+#define LAYOUT_SCANS 20
+#define KERNEL_SCANS 50
+#define FREE_SLOT_QUERIES 1000
+#define REWRITE_CHANGES 20
+
+#define BENCH_PATIENT_FILE "benchPatients.txt"
+#define BENCH_APPOINT_FILE "benchAppointments.txt"
+#define BENCH_JOURNAL_FILE "benchJournal.txt"
+#define BENCH_IMAGE_FILE "benchClinic.img"
+#define BENCH_REPORT_FILE "benchReport.txt"
+
+// Phone descriptions by contact type (as clinic.c spells them)
+static const char* const phoneDescriptions[] = { "CELL", "HOME", "WORK", "TBD" };
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Current wall clock time in seconds
+static double nowSeconds(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Small deterministic pseudo-random generator (same sequence on every run)
+static unsigned int nextRandom(unsigned int* state)
+{
+    *state = *state * 1103515245u + 12345u;
+
+    return *state >> 8;
+}
+
+// The original linear scan used by findPatientIndexByPatientNum
+static int linearPatientIndex(int patientNumber, const struct ClinicData* data)
+{
+    int i, index;
+
+    index = -1;
+
+    for (i = 0; i < data->patients.slotCount && index == -1; i++)
+    {
+        if (patientNumberAt(data, i) == patientNumber)
+        {
+            index = i;
+        }
+    }
+
+    return index;
+}
+
+// The original fscanf patient import (same table and index work as importPatients)
+static int fscanfImportPatients(const char* datafile, struct ClinicData* data)
+{
+    int slot, num = 0;
+
+    char description[PHONE_DESC_LEN + 1];
+    char number[PHONE_LEN + 1];
+
+    struct PatientEntry patient = { 0 };
+    struct PatientEntry empty = { 0 };
+    struct Patient packed;
+
+    FILE* fp = fopen(datafile, "r");
+
+    if (fp != NULL)
+    {
+        while (fscanf(fp, "%d", &patient.patientNumber) == 1)
+        {
+            description[0] = number[0] = '\0';
+            fscanf(fp, "|%[^|]|%[^|]|%[^\n]", patient.name, description, number);
+            setPhone(&patient.phone, (enum PhoneType)phoneTypeByDescription(description),
+                     number);
+
+            if (patient.patientNumber && (slot = allocPatientSlot(data)) != -1 &&
+                packPatient(data, &patient, &packed))
+            {
+                writePatient(data, slot, &packed);
+                notePatientNumber(data, patient.patientNumber);
+                num++;
+
+                if (findPatientSlot(&data->patientIndex, patient.patientNumber) == -1)
+                {
+                    insertPatientSlot(&data->patientIndex, patient.patientNumber, slot);
+                }
+                insertPhoneSlot(&data->phoneIndex, phoneNumberKey(&patient.phone), slot);
+            }
+
+            patient = empty;
+        }
+
+        fclose(fp);
+    }
+
+    return num;
+}
+
+// The original fscanf appointment import (same table and index work as importAppointments)
+static int fscanfImportAppointments(const char* datafile, struct ClinicData* data)
+{
+    int i, size, num = 0, max = 0;
+
+    unsigned int key;
+
+    struct Appointment* appoints = NULL;
+    struct Appointment* grown;
+    struct Appointment temp = { 0 };
+
+    struct Date date = { 0 };
+    struct Time time = { 0 };
+
+    FILE* fp = fopen(datafile, "r");
+
+    if (fp != NULL)
+    {
+        while (fscanf(fp, "%d", &temp.patientNumber) == 1)
+        {
+            fscanf(fp, ",%d,%d,%d,%d,%d",
+                &date.year, &date.month, &date.day, &time.hour, &time.min);
+            temp.key = appointmentKey(&date, &time);
+
+            if (temp.patientNumber && num == max)
+            {
+                size = max ? max * 2 : 64;
+                grown = realloc(appoints, size * sizeof(struct Appointment));
+
+                if (grown != NULL)
+                {
+                    appoints = grown;
+                    max = size;
+                }
+            }
+
+            if (temp.patientNumber && num < max)
+            {
+                appoints[num++] = temp;
+            }
+        }
+
+        fclose(fp);
+    }
+
+    sortAppointments(appoints, num);
+    loadAppointments(data, appoints, num);
+
+    for (i = firstAppointmentIndex(data); i != -1; i = nextAppointmentIndex(data, i))
+    {
+        key = appointmentKeyAt(data, i);
+        addDayCount(&data->dayIndex, (int)(key >> KEY_DATE_SHIFT), (int)(key & KEY_SLOT_MASK));
+    }
+
+    free(appoints);
+
+    return num;
+}
+
+// The original patient layout (fixed-size strings, 36 bytes)
+struct FieldPatient
+{
+    int patientNumber;
+    char name[NAME_LEN + 1];
+    char description[PHONE_DESC_LEN + 1];
+    char number[PHONE_LEN + 1];
+};
+
+// The original appointment layout (seven ints)
+struct FieldAppointment
+{
+    int patientNumber;
+    struct Time time;
+    struct Date date;
+};
+
+// The original field by field comparison used by compareDateTime
+static int fieldCompareDateTime(const struct FieldAppointment* apt1,
+                                const struct FieldAppointment* apt2)
+{
+    int result = 0;
+
+    int date1, date2, time1, time2;
+
+    date1 = apt1->date.year * 10000 + apt1->date.month * 100 + apt1->date.day;
+    date2 = apt2->date.year * 10000 + apt2->date.month * 100 + apt2->date.day;
+    time1 = apt1->time.hour * 60 + apt1->time.min;
+    time2 = apt2->time.hour * 60 + apt2->time.min;
+
+    if (!((date1 == date2) && (time1 == time2)))
+    {
+        if (date1 < date2)
+        {
+            result = -1;
+        }
+        else if (date1 > date2)
+        {
+            result = 1;
+        }
+        else if (time1 < time2)
+        {
+            result = -1;
+        }
+        else
+        {
+            result = 1;
+        }
+    }
+
+    return result;
+}
+
+// qsort callback for the field by field comparison
+static int fieldCompareAppointments(const void* apt1, const void* apt2)
+{
+    return fieldCompareDateTime(apt1, apt2);
+}
+
+// Conflict check as addAppointment did it: find where an appointment
+// would go in a sorted array and see whether that slot is taken
+static int fieldSlotTaken(const struct FieldAppointment appoints[], int count,
+                          const struct FieldAppointment* appoint)
+{
+    int low = 0, high = count, mid;
+
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+
+        if (fieldCompareDateTime(&appoints[mid], appoint) < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low < count && fieldCompareDateTime(&appoints[low], appoint) == 0;
+}
+
+// The same conflict check on packed appointments
+static int slotTaken(const struct Appointment appoints[], int count,
+                     const struct Appointment* appoint)
+{
+    int low = 0, high = count, mid;
+
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+
+        if (compareDateTime(&appoints[mid], appoint) < 0)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low < count && compareDateTime(&appoints[low], appoint) == 0;
+}
+
+// The original displayFormattedPhone, printing to a file
+static void printfFormattedPhone(FILE* fp, const char* phoneNum)
+{
+    int i, digit = 0;
+
+    char s1[PHONE_LEN], s2[PHONE_LEN], s3[PHONE_LEN];
+
+    for (i = 0; i < (int)strlen(phoneNum); i++)
+    {
+        if (isdigit((unsigned char)phoneNum[i]))
+        {
+            digit++;
+        }
+    }
+
+    if (digit == PHONE_LEN)
+    {
+        sscanf(phoneNum, "%3s%3s%4s", s1, s2, s3);
+        fprintf(fp, "(%s)%s-%s", s1, s2, s3);
+    }
+    else
+    {
+        fprintf(fp, "(___)___-____");
+    }
+}
+
+// The original displayScheduleTableHeader and displayScheduleData loop
+// for all records, printing to a file
+static void printfSchedule(FILE* fp, const struct ClinicData* data)
+{
+    int pos, index;
+
+    char number[PHONE_LEN + 1];
+
+    struct Appointment appoint;
+    struct Patient patient;
+    struct Date date;
+    struct Time time;
+
+    fprintf(fp, "Clinic Appointments for the Date: ");
+    fprintf(fp, "<ALL>\n\n");
+    fprintf(fp, "Date       Time  Pat.# Name            Phone#\n"
+                "---------- ----- ----- --------------- --------------------\n");
+
+    for (pos = firstAppointmentIndex(data); pos != -1; pos = nextAppointmentIndex(data, pos))
+    {
+        readAppointment(data, pos, &appoint);
+        index = findPatientIndexByPatientNum(appoint.patientNumber, data);
+
+        if (index != -1)
+        {
+            readPatient(data, index, &patient);
+            appointmentDate(&appoint, &date);
+            appointmentTime(&appoint, &time);
+
+            fprintf(fp, "%04d-%02d-%02d ", date.year, date.month, date.day);
+            fprintf(fp, "%02d:%02d %05d %-15s ", time.hour, time.min,
+                    patient.patientNumber, patientName(data, &patient));
+
+            phoneNumber(&patient.phone, number);
+            printfFormattedPhone(fp, number);
+
+            fprintf(fp, " (%s)\n", phoneDescription(&patient.phone));
+        }
+    }
+
+    fputc('\n', fp);
+}
+
+// Whether two files hold the same bytes
+static int sameFiles(const char* file1, const char* file2)
+{
+    int c1, c2, result = 0;
+
+    FILE* fp1 = fopen(file1, "rb");
+    FILE* fp2 = fopen(file2, "rb");
+
+    if (fp1 != NULL && fp2 != NULL)
+    {
+        do
+        {
+            c1 = fgetc(fp1);
+            c2 = fgetc(fp2);
+        } while (c1 == c2 && c1 != EOF);
+
+        result = c1 == c2;
+    }
+
+    if (fp1 != NULL)
+    {
+        fclose(fp1);
+    }
+    if (fp2 != NULL)
+    {
+        fclose(fp2);
+    }
+
+    return result;
+}
+
+// Fill both layouts with the same random appointments
+static void randomAppointments(struct FieldAppointment fields[], struct Appointment appoints[],
+                               int count, unsigned int seed)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+    {
+        fields[i].patientNumber = 1024 + (int)(nextRandom(&seed) % count) * 8;
+        fields[i].date.year = 2024 + (int)(nextRandom(&seed) % 5);
+        fields[i].date.month = 1 + (int)(nextRandom(&seed) % 12);
+        fields[i].date.day = 1 + (int)(nextRandom(&seed) % 28);
+        fields[i].time.hour = 10 + (int)(nextRandom(&seed) % 4);
+        fields[i].time.min = (int)(nextRandom(&seed) % 2) * 30;
+
+        appoints[i].patientNumber = fields[i].patientNumber;
+        appoints[i].key = appointmentKey(&fields[i].date, &fields[i].time);
+    }
+}
+
+// Write data files with "rows" patients and as many appointments
+static int writeBenchFiles(int rows)
+{
+    int i, result = 0;
+
+    unsigned int seed = 3;
+
+    FILE* patients = fopen(BENCH_PATIENT_FILE, "w");
+    FILE* appoints = fopen(BENCH_APPOINT_FILE, "w");
+
+    if (patients != NULL && appoints != NULL)
+    {
+        for (i = 0; i < rows; i++)
+        {
+            fprintf(patients, "%d|Patient %07d|CELL|%010u\n", 1024 + i * 8, i,
+                    nextRandom(&seed) % 1000000000u + 1000000000u);
+            fprintf(appoints, "%d,%d,%d,%d,%d,%d\n", 1024 + (int)(nextRandom(&seed) % rows) * 8,
+                    2024 + (int)(nextRandom(&seed) % 5), 1 + (int)(nextRandom(&seed) % 12),
+                    1 + (int)(nextRandom(&seed) % 28), 10 + (int)(nextRandom(&seed) % 4),
+                    (int)(nextRandom(&seed) % 2) * 30);
+        }
+
+        result = 1;
+    }
+
+    if (patients != NULL)
+    {
+        fclose(patients);
+    }
+    if (appoints != NULL)
+    {
+        fclose(appoints);
+    }
+
+    return result;
+}
+
+// Fingerprint of every patient slot (with its name spelled out) and
+// appointment, in table order
+static unsigned long long clinicChecksum(const struct ClinicData* data)
+{
+    int i;
+
+    unsigned long long hash = 14695981039346656037ull;
+
+    struct Patient patient;
+    struct Appointment appoint;
+    const unsigned char* bytes;
+    size_t j;
+
+    for (i = 0; i < data->patients.slotCount; i++)
+    {
+        readPatient(data, i, &patient);
+        hash = (hash ^ (unsigned int)patient.patientNumber) * 1099511628211ull;
+        hash = (hash ^ patient.phone.packed) * 1099511628211ull;
+
+        bytes = (const unsigned char*)(patient.patientNumber ? patientName(data, &patient) : "");
+        for (j = 0; bytes[j]; j++)
+        {
+            hash = (hash ^ bytes[j]) * 1099511628211ull;
+        }
+    }
+
+    for (i = firstAppointmentIndex(data); i != -1; i = nextAppointmentIndex(data, i))
+    {
+        readAppointment(data, i, &appoint);
+        hash = (hash ^ (unsigned int)appoint.patientNumber) * 1099511628211ull;
+        hash = (hash ^ appoint.key) * 1099511628211ull;
+    }
+
+    return hash;
+}
+
+// Time one import function (returns rows per second; "count" gets the rows
+// imported and "checksum" the fingerprint of the tables built)
+static double timeImport(int (*import)(const char*, struct ClinicData*), const char* datafile,
+                         int* count, unsigned long long* checksum)
+{
+    double start, seconds;
+
+    struct ClinicData data = { 0 };
+
+    start = nowSeconds();
+    *count = import(datafile, &data);
+    seconds = nowSeconds() - start;
+
+    *checksum = clinicChecksum(&data);
+
+    freeClinicData(&data);
+
+    return *count / seconds;
+}
+
+
+//////////////////////////////////////
+// BENCHMARKS
+//////////////////////////////////////
+
+// Compare patient number lookups: linear scan vs. hash index
+static void benchPatientLookup(int count)
+{
+    int i, slot, number, mismatches = 0;
+
+    unsigned int seed;
+
+    long long sum = 0;
+
+    double start, linearNs, hashNs;
+
+    struct Patient patient = { 0 };
+    struct ClinicData data = { 0 };
+
+    for (i = 0, slot = 0; i < count && slot != -1; i++)
+    {
+        slot = allocPatientSlot(&data);
+
+        if (slot != -1)
+        {
+            patient.patientNumber = 1024 + i * 8;
+            writePatient(&data, slot, &patient);
+            insertPatientSlot(&data.patientIndex, 1024 + i * 8, slot);
+        }
+    }
+
+    if (slot != -1)
+    {
+        // Both lookups must agree before they are timed
+        seed = 7;
+        for (i = 0; i < LINEAR_LOOKUPS; i++)
+        {
+            number = 1024 + (int)(nextRandom(&seed) % (count + count / 10)) * 8;
+            if (linearPatientIndex(number, &data) !=
+                findPatientIndexByPatientNum(number, &data))
+            {
+                mismatches++;
+            }
+        }
+
+        seed = 1;
+        start = nowSeconds();
+        for (i = 0; i < LINEAR_LOOKUPS; i++)
+        {
+            sum += linearPatientIndex(1024 + (int)(nextRandom(&seed) % count) * 8, &data);
+        }
+        linearNs = (nowSeconds() - start) * 1e9 / LINEAR_LOOKUPS;
+
+        seed = 1;
+        start = nowSeconds();
+        for (i = 0; i < HASH_LOOKUPS; i++)
+        {
+            sum += findPatientIndexByPatientNum(1024 + (int)(nextRandom(&seed) % count) * 8,
+                                                &data);
+        }
+        hashNs = (nowSeconds() - start) * 1e9 / HASH_LOOKUPS;
+
+        printf("%-9d %14.1f %14.1f %9.0fx %s\n", count, linearNs, hashNs,
+               linearNs / hashNs, mismatches ? "MISMATCH" : "");
+
+        // Printing the sum keeps the timed loops from being optimised away
+        fprintf(stderr, "checksum %lld\n", sum);
+    }
+
+    freeClinicData(&data);
+}
+
+// Compare the fscanf imports with the block reader and hand-written parsers
+// (on one thread)
+static void benchImport(int rows)
+{
+    int oldCount, newCount;
+
+    unsigned long long oldSum, newSum;
+
+    double oldRate, newRate;
+
+    setImportThreads(1);
+
+    if (writeBenchFiles(rows))
+    {
+        oldRate = timeImport(fscanfImportPatients, BENCH_PATIENT_FILE, &oldCount, &oldSum);
+        newRate = timeImport(importPatients, BENCH_PATIENT_FILE, &newCount, &newSum);
+
+        printf("%-9d %-12s %14.0f %14.0f %9.1fx %s\n", rows, "patients", oldRate, newRate,
+               newRate / oldRate, oldSum != newSum ? "MISMATCH" : "");
+
+        oldRate = timeImport(fscanfImportAppointments, BENCH_APPOINT_FILE, &oldCount, &oldSum);
+        newRate = timeImport(importAppointments, BENCH_APPOINT_FILE, &newCount, &newSum);
+
+        printf("%-9d %-12s %14.0f %14.0f %9.1fx %s\n", rows, "appointments", oldRate, newRate,
+               newRate / oldRate, oldSum != newSum ? "MISMATCH" : "");
+    }
+
+    remove(BENCH_PATIENT_FILE);
+    remove(BENCH_APPOINT_FILE);
+}
+
+// Import the same files with more and more parsing threads; the tables
+// built must be identical for every thread count
+static void benchImportThreads(int rows)
+{
+    int i, count, threads[] = { 1, 2, 4, 8 };
+
+    unsigned long long patientSum, appointSum, firstPatientSum = 0, firstAppointSum = 0;
+
+    double patientRate, appointRate;
+
+    if (writeBenchFiles(rows))
+    {
+        for (i = 0; i < (int)(sizeof(threads) / sizeof(threads[0])); i++)
+        {
+            setImportThreads(threads[i]);
+
+            patientRate = timeImport(importPatients, BENCH_PATIENT_FILE, &count, &patientSum);
+            appointRate = timeImport(importAppointments, BENCH_APPOINT_FILE, &count, &appointSum);
+
+            if (i == 0)
+            {
+                firstPatientSum = patientSum;
+                firstAppointSum = appointSum;
+            }
+
+            printf("%-9d %-7d %14.0f %14.0f %s\n", rows, threads[i], patientRate, appointRate,
+                   patientSum != firstPatientSum || appointSum != firstAppointSum ?
+                   "MISMATCH" : "");
+        }
+    }
+
+    setImportThreads(0);
+
+    remove(BENCH_PATIENT_FILE);
+    remove(BENCH_APPOINT_FILE);
+}
+
+// Compare sorting and conflict checks on the original seven int records
+// (field by field comparison) and on the packed records (ordering keys)
+static void benchOrdering(int count)
+{
+    int i, mismatches = 0, taken = 0;
+
+    double start, fieldSortMs, keySortMs, fieldCheckNs, keyCheckNs;
+
+    struct FieldAppointment* fieldSorted = malloc(count * sizeof(struct FieldAppointment));
+    struct FieldAppointment* fieldProbes =
+        malloc(CONFLICT_CHECKS * sizeof(struct FieldAppointment));
+    struct Appointment* keySorted = malloc(count * sizeof(struct Appointment));
+    struct Appointment* keyProbes = malloc(CONFLICT_CHECKS * sizeof(struct Appointment));
+
+    if (fieldSorted != NULL && fieldProbes != NULL && keySorted != NULL && keyProbes != NULL)
+    {
+        randomAppointments(fieldSorted, keySorted, count, 5);
+        randomAppointments(fieldProbes, keyProbes, CONFLICT_CHECKS, 9);
+
+        start = nowSeconds();
+        qsort(fieldSorted, count, sizeof(struct FieldAppointment), fieldCompareAppointments);
+        fieldSortMs = (nowSeconds() - start) * 1e3;
+
+        start = nowSeconds();
+        sortAppointments(keySorted, count);
+        keySortMs = (nowSeconds() - start) * 1e3;
+
+        for (i = 0; i < count; i++)
+        {
+            if (appointmentKey(&fieldSorted[i].date, &fieldSorted[i].time) != keySorted[i].key)
+            {
+                mismatches++;
+            }
+        }
+
+        start = nowSeconds();
+        for (i = 0; i < CONFLICT_CHECKS; i++)
+        {
+            taken += fieldSlotTaken(fieldSorted, count, &fieldProbes[i]);
+        }
+        fieldCheckNs = (nowSeconds() - start) * 1e9 / CONFLICT_CHECKS;
+
+        start = nowSeconds();
+        for (i = 0; i < CONFLICT_CHECKS; i++)
+        {
+            taken -= slotTaken(keySorted, count, &keyProbes[i]);
+        }
+        keyCheckNs = (nowSeconds() - start) * 1e9 / CONFLICT_CHECKS;
+
+        printf("%-9d %-14s %14.2f %14.2f %9.1fx %s\n", count, "sort (ms)", fieldSortMs,
+               keySortMs, fieldSortMs / keySortMs, mismatches ? "MISMATCH" : "");
+        printf("%-9d %-14s %14.1f %14.1f %9.1fx %s\n", count, "check (ns)", fieldCheckNs,
+               keyCheckNs, fieldCheckNs / keyCheckNs, taken ? "MISMATCH" : "");
+        printf("%-9d %-14s %14.1f %14.1f %9.1fx\n", count, "memory (MB)",
+               count * sizeof(struct FieldAppointment) / 1e6,
+               count * sizeof(struct Appointment) / 1e6,
+               (double)sizeof(struct FieldAppointment) / sizeof(struct Appointment));
+    }
+
+    free(fieldSorted);
+    free(fieldProbes);
+    free(keySorted);
+    free(keyProbes);
+}
+
+// Compare "is this slot taken?" checks on an imported clinic: a binary
+// search of the appointment table vs. one bit of the day's slot bitmap
+static void benchSlotCheck(int rows)
+{
+    int i, mismatches = 0, searchTaken = 0, bitmapTaken = 0, pos;
+
+    unsigned int seed = 23;
+
+    double start, searchNs, bitmapNs;
+
+    struct Appointment* probes = malloc(CONFLICT_CHECKS * sizeof(struct Appointment));
+    struct Date date = { 0 };
+    struct Time time = { 0 };
+    struct ClinicData data = { 0 };
+
+    if (probes != NULL && writeBenchFiles(rows) &&
+        importAppointments(BENCH_APPOINT_FILE, &data) == rows)
+    {
+        // The same date and time ranges writeBenchFiles draws from
+        for (i = 0; i < CONFLICT_CHECKS; i++)
+        {
+            date.year = 2024 + (int)(nextRandom(&seed) % 5);
+            date.month = 1 + (int)(nextRandom(&seed) % 12);
+            date.day = 1 + (int)(nextRandom(&seed) % 28);
+            time.hour = 10 + (int)(nextRandom(&seed) % 4);
+            time.min = (int)(nextRandom(&seed) % 2) * 30;
+            probes[i].key = appointmentKey(&date, &time);
+        }
+
+        for (i = 0; i < CONFLICT_CHECKS; i++)
+        {
+            pos = findAppointmentIndex(&data, &probes[i]);
+
+            if ((pos != -1 && appointmentKeyAt(&data, pos) == probes[i].key) !=
+                findDaySlot(&data.dayIndex, (int)(probes[i].key >> KEY_DATE_SHIFT),
+                            (int)(probes[i].key & KEY_SLOT_MASK)))
+            {
+                mismatches++;
+            }
+        }
+
+        start = nowSeconds();
+        for (i = 0; i < CONFLICT_CHECKS; i++)
+        {
+            pos = findAppointmentIndex(&data, &probes[i]);
+            searchTaken += pos != -1 && appointmentKeyAt(&data, pos) == probes[i].key;
+        }
+        searchNs = (nowSeconds() - start) * 1e9 / CONFLICT_CHECKS;
+
+        start = nowSeconds();
+        for (i = 0; i < CONFLICT_CHECKS; i++)
+        {
+            bitmapTaken += findDaySlot(&data.dayIndex, (int)(probes[i].key >> KEY_DATE_SHIFT),
+                                       (int)(probes[i].key & KEY_SLOT_MASK));
+        }
+        bitmapNs = (nowSeconds() - start) * 1e9 / CONFLICT_CHECKS;
+
+        printf("%-9d %14.1f %14.1f %9.1fx %s\n", rows, searchNs, bitmapNs, searchNs / bitmapNs,
+               mismatches || searchTaken != bitmapTaken ? "MISMATCH" : "");
+    }
+
+    free(probes);
+    freeClinicData(&data);
+
+    remove(BENCH_PATIENT_FILE);
+    remove(BENCH_APPOINT_FILE);
+}
+
+// Compare finding the first SUGGESTED_SLOTS free times after "fullDays"
+// fully booked days: a binary search per candidate slot vs. the day
+// index's slot bitmaps
+static void benchFreeSlots(int fullDays)
+{
+    int i, k, found, pos, mismatches = 0;
+
+    double start, searchUs, bitmapUs;
+
+    unsigned int keys[SUGGESTED_SLOTS], searched[SUGGESTED_SLOTS];
+
+    struct Date date = { 2025, 1, 1 };
+    struct Appointment temp = { 0 };
+    struct ClinicData data = { 0 };
+
+    // Every slot of the first "fullDays" days, with the last day's first
+    // slot left free so the answer spans a full day and a partial one
+    temp.patientNumber = 1024;
+
+    for (i = 0; i < fullDays * APPOINT_SLOTS; i++)
+    {
+        temp.key = (unsigned int)(dateToDayNumber(&date) + i / APPOINT_SLOTS) << KEY_DATE_SHIFT |
+                   (unsigned int)(i % APPOINT_SLOTS);
+
+        if (i != (fullDays - 1) * APPOINT_SLOTS)
+        {
+            insertAppointment(&data, &temp);
+        }
+    }
+
+    start = nowSeconds();
+    for (k = 0; k < FREE_SLOT_QUERIES; k++)
+    {
+        found = 0;
+        temp.key = appointmentDayKey(&date);
+
+        while (found < SUGGESTED_SLOTS)
+        {
+            pos = findAppointmentIndex(&data, &temp);
+
+            if ((temp.key & KEY_SLOT_MASK) < APPOINT_SLOTS &&
+                (pos == -1 || appointmentKeyAt(&data, pos) != temp.key))
+            {
+                searched[found++] = temp.key;
+            }
+
+            temp.key = (temp.key & KEY_SLOT_MASK) < APPOINT_SLOTS ? temp.key + 1 :
+                       ((temp.key >> KEY_DATE_SHIFT) + 1) << KEY_DATE_SHIFT;
+        }
+    }
+    searchUs = (nowSeconds() - start) * 1e6 / FREE_SLOT_QUERIES;
+
+    start = nowSeconds();
+    for (k = 0; k < FREE_SLOT_QUERIES; k++)
+    {
+        found = findFreeSlots(&data, appointmentDayKey(&date), -1, keys, SUGGESTED_SLOTS);
+    }
+    bitmapUs = (nowSeconds() - start) * 1e6 / FREE_SLOT_QUERIES;
+
+    for (i = 0; i < SUGGESTED_SLOTS; i++)
+    {
+        mismatches += i >= found || keys[i] != searched[i];
+    }
+
+    printf("%-9d %14.2f %14.3f %9.1fx %s\n", fullDays, searchUs, bitmapUs, searchUs / bitmapUs,
+           mismatches ? "MISMATCH" : "");
+
+    freeClinicData(&data);
+}
+
+// Compare the original and the compact patient layouts with "names"
+// distinct names: bytes per patient (records, name arena and intern table)
+// and a scan for cell phones in area codes below 500
+static void benchPatientLayout(int rows, int names)
+{
+    int i, slot, fieldCount = 0, packedCount = 0;
+
+    unsigned int seed = 11;
+
+    double start, fieldNs, packedNs, fieldBytes, packedBytes;
+
+    struct FieldPatient* fields = calloc(rows, sizeof(struct FieldPatient));
+    struct PatientEntry entry = { 0 };
+    struct ClinicData data = { 0 };
+    struct Patient patient;
+
+    for (i = 0, slot = 0; fields != NULL && i < rows && slot != -1; i++)
+    {
+        fields[i].patientNumber = 1024 + i * 8;
+        sprintf(fields[i].name, "Patient %07d", i % names);
+        strcpy(fields[i].description, phoneDescriptions[nextRandom(&seed) % 4]);
+
+        if (strcmp(fields[i].description, "TBD") != 0)
+        {
+            sprintf(fields[i].number, "%010u", nextRandom(&seed) % 1000000000u * 9u);
+        }
+
+        entry.patientNumber = fields[i].patientNumber;
+        strcpy(entry.name, fields[i].name);
+        setPhone(&entry.phone, (enum PhoneType)phoneTypeByDescription(fields[i].description),
+                 fields[i].number);
+
+        slot = allocPatientSlot(&data);
+
+        if (slot != -1 && packPatient(&data, &entry, &patient))
+        {
+            writePatient(&data, slot, &patient);
+        }
+        else
+        {
+            slot = -1;
+        }
+    }
+
+    if (fields != NULL && slot != -1)
+    {
+        start = nowSeconds();
+        for (i = 0; i < rows; i++)
+        {
+            if (strcmp(fields[i].description, "CELL") == 0 && fields[i].number[0] < '5')
+            {
+                fieldCount++;
+            }
+        }
+        fieldNs = (nowSeconds() - start) * 1e9 / rows;
+
+        start = nowSeconds();
+        for (i = 0; i < data.patients.slotCount; i++)
+        {
+            readPatient(&data, i, &patient);
+
+            if (phoneType(&patient.phone) == PHONE_CELL &&
+                phoneNumberKey(&patient.phone) - 1 < 5000000000ll)
+            {
+                packedCount++;
+            }
+        }
+        packedNs = (nowSeconds() - start) * 1e9 / rows;
+
+        fieldBytes = (double)sizeof(struct FieldPatient);
+        packedBytes = ((double)data.patients.blockCount * STORE_BLOCK_SIZE +
+                       (double)data.names.blockCount * STORE_BLOCK_SIZE +
+                       (double)data.names.refCapacity * sizeof(unsigned int)) / rows;
+
+        printf("%-9d %-9d %-14s %14d %14d %9.1fx\n", rows, names, "record (B)",
+               (int)sizeof(struct FieldPatient), (int)sizeof(struct Patient),
+               (double)sizeof(struct FieldPatient) / sizeof(struct Patient));
+        printf("%-9d %-9d %-14s %14.1f %14.1f %9.1fx\n", rows, names, "all (B)", fieldBytes,
+               packedBytes, fieldBytes / packedBytes);
+        printf("%-9d %-9d %-14s %14.2f %14.2f %9.1fx %s\n", rows, names, "scan (ns)", fieldNs,
+               packedNs, fieldNs / packedNs, fieldCount != packedCount ? "MISMATCH" : "");
+    }
+
+    free(fields);
+    freeClinicData(&data);
+}
+
+// Time the whole-table scans on a clinic built with one record layout:
+// walking every patient slot, a phone number range filter and a patient's
+// appointments filter (ns per record; "found" gets the records matched)
+static void timeLayoutScans(int layout, int rows, double ns[3], long long found[3])
+{
+    int i, slot;
+
+    int* matches = malloc(rows * sizeof(int));
+
+    double start;
+
+    struct ClinicData data = { 0 };
+
+    setStoreLayout(layout);
+
+    found[0] = found[1] = found[2] = 0;
+
+    if (matches != NULL && importPatients(BENCH_PATIENT_FILE, &data) == rows &&
+        importAppointments(BENCH_APPOINT_FILE, &data) == rows)
+    {
+        start = nowSeconds();
+        for (i = 0; i < LAYOUT_SCANS; i++)
+        {
+            for (slot = nextPatientSlot(&data, 0); slot != -1;
+                 slot = nextPatientSlot(&data, slot + 1))
+            {
+                found[0] += patientNumberAt(&data, slot) & 1;
+            }
+        }
+        ns[0] = (nowSeconds() - start) * 1e9 / LAYOUT_SCANS / rows;
+
+        // The lowest tenth of the numbers written (from 24 random bits)
+        start = nowSeconds();
+        for (i = 0; i < LAYOUT_SCANS; i++)
+        {
+            found[1] += filterPatientsByPhone(&data, 1000000001ll, 1001677722ll, matches, rows);
+        }
+        ns[1] = (nowSeconds() - start) * 1e9 / LAYOUT_SCANS / rows;
+
+        start = nowSeconds();
+        for (i = 0; i < LAYOUT_SCANS; i++)
+        {
+            found[2] += filterAppointmentsByPatient(&data, 1024 + i * 8, matches, rows);
+        }
+        ns[2] = (nowSeconds() - start) * 1e9 / LAYOUT_SCANS / rows;
+    }
+
+    free(matches);
+    freeClinicData(&data);
+
+    setStoreLayout(STORE_ROWS);
+}
+
+// Compare the row and column record layouts on whole-table scans
+static void benchStoreLayout(int rows)
+{
+    int i;
+
+    double rowNs[3] = { 0 }, columnNs[3] = { 0 };
+
+    long long rowFound[3], columnFound[3];
+
+    static const char* const scans[] = { "all patients", "phone range", "appointments" };
+
+    if (writeBenchFiles(rows))
+    {
+        timeLayoutScans(STORE_ROWS, rows, rowNs, rowFound);
+        timeLayoutScans(STORE_COLUMNS, rows, columnNs, columnFound);
+
+        for (i = 0; i < 3; i++)
+        {
+            printf("%-9d %-14s %14.2f %14.2f %9.1fx %s\n", rows, scans[i], rowNs[i],
+                   columnNs[i], rowNs[i] / columnNs[i],
+                   rowFound[i] != columnFound[i] ? "MISMATCH" : "");
+        }
+    }
+
+    remove(BENCH_PATIENT_FILE);
+    remove(BENCH_APPOINT_FILE);
+}
+
+// Compare the scan kernels at each instruction set on "count" values: a
+// month of appointment keys, a range of phone numbers and one taken slot
+static void benchScanKernels(int count)
+{
+    int i, k, level, selected[3][3] = { { 0 } };
+
+    unsigned int seed = 17, month, slot;
+
+    double start, ns[3][3] = { { 0 } };
+
+    static const char* const kernels[] = { "date range", "phone range", "slot taken" };
+
+    unsigned int* keys = malloc(count * sizeof(unsigned int));
+    unsigned long long* phones = malloc(count * sizeof(unsigned long long));
+    unsigned long long* bitmap = malloc(SCAN_BITMAP_WORDS(count) * sizeof(unsigned long long));
+
+    struct Date date = { 2025, 3, 1 };
+    struct Time time = { 10, 30 };
+
+    if (keys != NULL && phones != NULL && bitmap != NULL)
+    {
+        for (i = 0; i < count; i++)
+        {
+            // Five years of days around the month scanned
+            keys[i] = (unsigned int)(dateToDayNumber(&date) - 912 + (int)(nextRandom(&seed) % 1826))
+                      << KEY_DATE_SHIFT | nextRandom(&seed) % 18u;
+            phones[i] = (1000000001ull + nextRandom(&seed) % 16777216u * 59u) << PHONE_TYPE_BITS |
+                        nextRandom(&seed) % 4u;
+        }
+
+        month = appointmentDayKey(&date);
+        slot = appointmentKey(&date, &time);
+
+        for (level = SCAN_SCALAR; level <= SCAN_AVX2; level++)
+        {
+            setScanLevel(level);
+
+            start = nowSeconds();
+            for (k = 0; k < KERNEL_SCANS; k++)
+            {
+                selected[level][0] = selectRange32(keys, count, month,
+                                                   month + (31u << KEY_DATE_SHIFT) - 1, bitmap);
+            }
+            ns[level][0] = (nowSeconds() - start) * 1e9 / KERNEL_SCANS / count;
+
+            // Numbers 100 0000000 to 109 9999999 (about a tenth), any contact type
+            start = nowSeconds();
+            for (k = 0; k < KERNEL_SCANS; k++)
+            {
+                selected[level][1] = selectRange64(phones, count, 1000000001ull << PHONE_TYPE_BITS,
+                                                   1100000000ull << PHONE_TYPE_BITS | 3u, bitmap);
+            }
+            ns[level][1] = (nowSeconds() - start) * 1e9 / KERNEL_SCANS / count;
+
+            start = nowSeconds();
+            for (k = 0; k < KERNEL_SCANS; k++)
+            {
+                selected[level][2] = selectRange32(keys, count, slot, slot, bitmap);
+            }
+            ns[level][2] = (nowSeconds() - start) * 1e9 / KERNEL_SCANS / count;
+        }
+
+        setScanLevel(SCAN_AVX2);
+
+        for (k = 0; k < 3; k++)
+        {
+            printf("%-9d %-14s %14.3f %14.3f %14.3f %9.1fx %s\n", count, kernels[k],
+                   ns[SCAN_SCALAR][k], ns[SCAN_SSE2][k], ns[SCAN_AVX2][k],
+                   ns[SCAN_SCALAR][k] / ns[scanLevel()][k],
+                   selected[SCAN_SSE2][k] != selected[SCAN_SCALAR][k] ||
+                   selected[SCAN_AVX2][k] != selected[SCAN_SCALAR][k] ? "MISMATCH" : "");
+        }
+    }
+
+    free(keys);
+    free(phones);
+    free(bitmap);
+}
+
+// Compare the cost of saving one patient change: a journal append and
+// commit vs. rewriting the patient file (no forced syncs in either case)
+static void benchJournal(int rows)
+{
+    int i, slot, replayed;
+
+    char name[NAME_LEN + 1];
+
+    double start, journalUs, rewriteUs;
+
+    struct Patient patient;
+
+    struct ClinicData data = { 0 };
+    struct ClinicData check = { 0 };
+
+    setImportThreads(1);
+    setJournalSync(JOURNAL_SYNC_NONE);
+
+    remove(BENCH_JOURNAL_FILE);
+
+    if (writeBenchFiles(rows) && importPatients(BENCH_PATIENT_FILE, &data) == rows &&
+        openJournal(&data, BENCH_JOURNAL_FILE, BENCH_PATIENT_FILE, BENCH_APPOINT_FILE) == 0)
+    {
+        start = nowSeconds();
+        for (i = 0; i < JOURNAL_CHANGES; i++)
+        {
+            slot = i % rows;
+            readPatient(&data, slot, &patient);
+            strcpy(name, patientName(&data, &patient));
+            name[0] = 'A' + i % 26;
+            patient.name = internName(&data, name);
+            writePatient(&data, slot, &patient);
+            journalPatient(&data, &patient);
+            commitJournal(&data);
+        }
+        journalUs = (nowSeconds() - start) * 1e6 / JOURNAL_CHANGES;
+
+        start = nowSeconds();
+        for (i = 0; i < REWRITE_CHANGES; i++)
+        {
+            exportPatients(BENCH_PATIENT_FILE ".tmp", &data);
+        }
+        rewriteUs = (nowSeconds() - start) * 1e6 / REWRITE_CHANGES;
+
+        // Replaying the journal over the original file must give the same table
+        importPatients(BENCH_PATIENT_FILE, &check);
+        replayed = openJournal(&check, BENCH_JOURNAL_FILE, BENCH_PATIENT_FILE,
+                               BENCH_APPOINT_FILE);
+
+        printf("%-9d %14.1f %14.1f %9.0fx %s\n", rows, journalUs, rewriteUs,
+               rewriteUs / journalUs,
+               replayed != JOURNAL_CHANGES || clinicChecksum(&data) != clinicChecksum(&check) ?
+               "MISMATCH" : "");
+
+    }
+
+    closeJournal(&check);
+    closeJournal(&data);
+
+    freeClinicData(&check);
+    freeClinicData(&data);
+
+    setJournalSync(JOURNAL_SYNC_COMMIT);
+    setImportThreads(0);
+
+    remove(BENCH_PATIENT_FILE);
+    remove(BENCH_PATIENT_FILE ".tmp");
+    remove(BENCH_APPOINT_FILE);
+    remove(BENCH_JOURNAL_FILE);
+}
+
+// Compare listing every appointment through printf with rendering it into
+// a report buffer; both go to a file, which must come out the same
+static void benchReport(int rows)
+{
+    int count;
+
+    double start, printfNs, reportNs;
+
+    // Too big for the stack of some platforms
+    static struct Report report;
+
+    struct ClinicData data = { 0 };
+
+    FILE* fp;
+
+    if (writeBenchFiles(rows) && importPatients(BENCH_PATIENT_FILE, &data) == rows &&
+        (count = importAppointments(BENCH_APPOINT_FILE, &data)) > 0)
+    {
+        start = nowSeconds();
+        if ((fp = fopen(BENCH_REPORT_FILE ".printf", "w")) != NULL)
+        {
+            printfSchedule(fp, &data);
+            fclose(fp);
+        }
+        printfNs = (nowSeconds() - start) * 1e9 / count;
+
+        start = nowSeconds();
+        if ((fp = fopen(BENCH_REPORT_FILE ".report", "w")) != NULL)
+        {
+            openReport(&report, fp);
+            renderScheduleTableHeader(&report, NULL, 1);
+            renderScheduleRange(&report, &data, firstAppointmentIndex(&data),
+                                data.appointments.count, 1);
+            reportChar(&report, '\n');
+            flushReport(&report);
+            fclose(fp);
+        }
+        reportNs = (nowSeconds() - start) * 1e9 / count;
+
+        printf("%-9d %14.1f %14.1f %9.1fx %s\n", rows, printfNs, reportNs, printfNs / reportNs,
+               sameFiles(BENCH_REPORT_FILE ".printf", BENCH_REPORT_FILE ".report") ?
+               "" : "MISMATCH");
+    }
+
+    freeClinicData(&data);
+
+    remove(BENCH_PATIENT_FILE);
+    remove(BENCH_APPOINT_FILE);
+    remove(BENCH_REPORT_FILE ".printf");
+    remove(BENCH_REPORT_FILE ".report");
+}
+
+// Compare starting up from the text files with mapping a clinic image
+// holding the same records
+static void benchImage(int rows)
+{
+    double start, textMs, imageMs;
+
+    unsigned long long textSum, imageSum;
+
+    struct ClinicData data = { 0 };
+
+    remove(BENCH_IMAGE_FILE);
+
+    if (writeBenchFiles(rows) && openClinicImage(&data, BENCH_IMAGE_FILE) == 0)
+    {
+        importPatients(BENCH_PATIENT_FILE, &data);
+        importAppointments(BENCH_APPOINT_FILE, &data);
+        freeClinicData(&data);
+
+        start = nowSeconds();
+        importPatients(BENCH_PATIENT_FILE, &data);
+        importAppointments(BENCH_APPOINT_FILE, &data);
+        textMs = (nowSeconds() - start) * 1e3;
+
+        textSum = clinicChecksum(&data);
+        freeClinicData(&data);
+
+        start = nowSeconds();
+        openClinicImage(&data, BENCH_IMAGE_FILE);
+        imageMs = (nowSeconds() - start) * 1e3;
+
+        imageSum = clinicChecksum(&data);
+
+        printf("%-9d %14.1f %14.1f %9.1fx %s\n", rows, textMs, imageMs, textMs / imageMs,
+               textSum != imageSum ? "MISMATCH" : "");
+    }
+
+    freeClinicData(&data);
+
+    remove(BENCH_PATIENT_FILE);
+    remove(BENCH_APPOINT_FILE);
+    remove(BENCH_IMAGE_FILE);
+}
+
+int main(void)
+{
+    printf("Patient number lookup (ns/lookup)\n"
+           "Patients  Linear scan    Hash index     Speedup\n"
+           "--------- -------------- -------------- ----------\n");
+
+    benchPatientLookup(10000);
+    benchPatientLookup(100000);
+    benchPatientLookup(1000000);
+
+    printf("\nImport (rows/sec)\n"
+           "Rows      File         fscanf         Block parser   Speedup\n"
+           "--------- ------------ -------------- -------------- ----------\n");
+
+    benchImport(100000);
+    benchImport(1000000);
+
+    printf("\nParallel import (rows/sec, %d processors)\n"
+           "Rows      Threads Patients       Appointments\n"
+           "--------- ------- -------------- --------------\n", processorCount());
+
+    benchImportThreads(2000000);
+
+    printf("\nAppointment ordering\n"
+           "Rows      Operation      7 int records  Packed records Speedup\n"
+           "--------- -------------- -------------- -------------- ----------\n");
+
+    benchOrdering(100000);
+    benchOrdering(1000000);
+
+    printf("\nSlot conflict check (ns/check)\n"
+           "Rows      Binary search  Slot bitmap    Speedup\n"
+           "--------- -------------- -------------- ----------\n");
+
+    benchSlotCheck(10000);
+    benchSlotCheck(1000000);
+
+    printf("\nNext %d free slots after a booked run (us/query)\n"
+           "Full days Binary search  Slot bitmap    Speedup\n"
+           "--------- -------------- -------------- ----------\n", SUGGESTED_SLOTS);
+
+    benchFreeSlots(30);
+    benchFreeSlots(180);
+    benchFreeSlots(3650);
+
+    printf("\nPatient layout (per patient)\n"
+           "Rows      Names     Measure        Fixed strings  Compact        Ratio\n"
+           "--------- --------- -------------- -------------- -------------- ----------\n");
+
+    benchPatientLayout(1000000, 1000000);
+    benchPatientLayout(1000000, 100000);
+    benchPatientLayout(1000000, 10000);
+
+    printf("\nWhole-table scans (ns/record)\n"
+           "Rows      Scan           Rows           Columns        Speedup\n"
+           "--------- -------------- -------------- -------------- ----------\n");
+
+    benchStoreLayout(100000);
+    benchStoreLayout(1000000);
+
+    printf("\nScan kernels (ns/value, best: level %d)\n"
+           "Values    Kernel         Scalar         SSE2           AVX2           Speedup\n"
+           "--------- -------------- -------------- -------------- -------------- ----------\n",
+           scanLevel());
+
+    benchScanKernels(100000);
+    benchScanKernels(1000000);
+
+    printf("\nSaving one patient change (us/change)\n"
+           "Patients  Journal        File rewrite   Speedup\n"
+           "--------- -------------- -------------- ----------\n");
+
+    benchJournal(10000);
+    benchJournal(100000);
+    benchJournal(1000000);
+
+    printf("\nStartup (ms)\n"
+           "Rows      Text import    Mapped image   Speedup\n"
+           "--------- -------------- -------------- ----------\n");
+
+    benchImage(100000);
+    benchImage(1000000);
+    benchImage(4000000);
+
+    printf("\nSchedule listing, all records to a file (ns/row)\n"
+           "Rows      printf         Report buffer  Speedup\n"
+           "--------- -------------- -------------- ----------\n");
+
+    benchReport(100000);
+    benchReport(1000000);
+
+    return 0;
+}
@@ -0,0 +1,316 @@
+// Booking benchmark: front desk threads booking, cancelling, adding,
+// removing and looking up on one clinic at once (not part of the VS
+// solution)
+//
+// Build and run from this folder ("make desks" builds it):
+//     gcc -std=c11 -O2 -pthread -I.. desks.c generator.c ../clinic.c ../core.c ../desk.c
+//         ../import.c ../index.c ../journal.c ../mapfile.c ../replay.c ../report.c
+//         ../scan.c ../stats.c ../store.c ../thread.c ../trace.c -o desks
+//     ./desks [rows] [seed] [threads]
+//
+// Generates "rows" patients and appointments (default 100000, seed 1) and
+// runs DESKS_OPERATIONS operations split over 1, 2, 4, ... up to "threads"
+// desks (default: twice the processors), each on a freshly imported
+// clinic.  Every run is done twice: through the front desk's day and
+// patient locks ("sharded"), and with every operation also holding one
+// lock for the whole clinic ("global"), as a single lock would serialise
+// them.  Writes one tab-separated line per run: the locking, the desks,
+// the operations, the seconds and the operations per second.  Lines
+// starting with '#' describe the run.
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "clinic.h"
+#include "desk.h"
+#include "generator.h"
+#include "import.h"
+#include "thread.h"
+
+#define DESKS_OPERATIONS 400000
+#define DESKS_MAX_THREADS 64
+
+// Days bookings are made on: DESKS_DAYS days from DESKS_FIRST_DAY (a day
+// number), past the generated schedule so most slots start out free
+#define DESKS_FIRST_DAY 22000
+#define DESKS_DAYS 20000
+
+// Bookings a desk remembers to cancel later
+#define DESKS_BOOKED 64
+
+// Percent of operations that book, cancel, look up, add or remove a
+// patient; the rest list a day
+#define DESKS_BOOK_PERCENT 35
+#define DESKS_CANCEL_PERCENT 15
+#define DESKS_FIND_PERCENT 20
+#define DESKS_ADD_PERCENT 5
+#define DESKS_REMOVE_PERCENT 5
+
+#define DESKS_PATIENT_FILE "desksPatients.txt"
+#define DESKS_APPOINT_FILE "desksAppointments.txt"
+
+// Data type: DeskWorker
+// One desk's share of a run; "global" is held around every operation when
+// not NULL, and the results are folded into "total"
+struct DeskWorker
+{
+    struct FrontDesk* desk;
+    struct Mutex* global;
+    unsigned int seed;
+    int patients;
+    int operations;
+    long long total;
+    struct Thread thread;
+};
+
+// Results folded in so the work cannot be optimized away
+static volatile long long sink;
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Current wall clock time in seconds
+static double nowSeconds(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Small deterministic pseudo-random generator (same sequence on every run)
+static unsigned int nextRandom(unsigned int* state)
+{
+    *state = *state * 1103515245u + 12345u;
+
+    return *state >> 8;
+}
+
+// Random number from 0 to "limit" - 1, for limits beyond the 24 bits of
+// nextRandom
+static int randomIndex(unsigned int* state, int limit)
+{
+    unsigned long long value = (unsigned long long)nextRandom(state) << 24 | nextRandom(state);
+
+    return (int)(value % (unsigned long long)limit);
+}
+
+// Run one desk's operations (thread function)
+static void runDesk(void* arg)
+{
+    int i, pick, suggested, found, booked = 0;
+
+    long long total = 0;
+
+    unsigned int keys[SUGGESTED_SLOTS];
+
+    struct DeskWorker* worker = arg;
+    struct Appointment appoint;
+    struct Appointment mine[DESKS_BOOKED];
+    struct Appointment day[APPOINT_SLOTS];
+    struct PatientEntry patient;
+    struct Date date;
+
+    char phone[PHONE_LEN + 1];
+
+    for (i = 0; i < worker->operations; i++)
+    {
+        pick = randomIndex(&worker->seed, 100);
+
+        appoint.patientNumber = generatedPatientNumber(randomIndex(&worker->seed,
+                                                                   worker->patients));
+        appoint.key = (unsigned int)(DESKS_FIRST_DAY + randomIndex(&worker->seed, DESKS_DAYS))
+                      << KEY_DATE_SHIFT |
+                      (unsigned int)randomIndex(&worker->seed, APPOINT_SLOTS);
+
+        if (worker->global != NULL)
+        {
+            lockMutex(worker->global);
+        }
+
+        if (pick < DESKS_BOOK_PERCENT)
+        {
+            if (deskBook(worker->desk, &appoint, keys, &suggested) == DESK_OK)
+            {
+                mine[booked++ % DESKS_BOOKED] = appoint;
+            }
+            total += suggested;
+        }
+        else if (pick < DESKS_BOOK_PERCENT + DESKS_CANCEL_PERCENT)
+        {
+            // Cancel one of this desk's bookings when it has any
+            if (booked)
+            {
+                appoint = mine[--booked % DESKS_BOOKED];
+            }
+            total += deskCancel(worker->desk, &appoint) == DESK_OK;
+        }
+        else if (pick < DESKS_BOOK_PERCENT + DESKS_CANCEL_PERCENT + DESKS_FIND_PERCENT)
+        {
+            found = deskFindPatient(worker->desk, appoint.patientNumber, &patient);
+            total += found == DESK_OK ? patient.name[0] : 0;
+        }
+        else if (pick < DESKS_BOOK_PERCENT + DESKS_CANCEL_PERCENT + DESKS_FIND_PERCENT +
+                        DESKS_ADD_PERCENT)
+        {
+            sprintf(phone, "%03d%07d", 201 + randomIndex(&worker->seed, 789),
+                    randomIndex(&worker->seed, 10000000));
+            snprintf(patient.name, sizeof(patient.name), "Desk %d", i);
+            setPhone(&patient.phone, PHONE_CELL, phone);
+
+            total += deskAddPatient(worker->desk, &patient) == DESK_OK;
+        }
+        else if (pick < DESKS_BOOK_PERCENT + DESKS_CANCEL_PERCENT + DESKS_FIND_PERCENT +
+                        DESKS_ADD_PERCENT + DESKS_REMOVE_PERCENT)
+        {
+            // A random patient rather than one just added: removing the
+            // highest number makes the next add rescan the patient table
+            total += deskRemovePatient(worker->desk, appoint.patientNumber) == DESK_OK;
+        }
+        else
+        {
+            appointmentDate(&appoint, &date);
+            total += deskQueryDay(worker->desk, &date, day, APPOINT_SLOTS);
+        }
+
+        if (worker->global != NULL)
+        {
+            unlockMutex(worker->global);
+        }
+    }
+
+    worker->total = total;
+}
+
+// Run the operations split over "threads" desks on a freshly imported
+// clinic (returns seconds taken, -1 if the clinic could not be set up)
+static double timeDesks(int threads, int rows, int useGlobal)
+{
+    int i, ok;
+
+    double start, result = -1.0;
+
+    struct ClinicData data = { 0 };
+    struct FrontDesk desk;
+    struct Mutex global = { 0 };
+    struct DeskWorker workers[DESKS_MAX_THREADS] = { 0 };
+
+    ok = importPatients(DESKS_PATIENT_FILE, &data) > 0 &&
+         importAppointments(DESKS_APPOINT_FILE, &data) >= 0 &&
+         openFrontDesk(&desk, &data);
+
+    if (ok && (!useGlobal || initMutex(&global)))
+    {
+        for (i = 0; i < threads; i++)
+        {
+            workers[i].desk = &desk;
+            workers[i].global = useGlobal ? &global : NULL;
+            workers[i].seed = 17u + (unsigned int)i;
+            workers[i].patients = rows;
+            workers[i].operations = DESKS_OPERATIONS / threads;
+        }
+
+        start = nowSeconds();
+
+        for (i = 0; i < threads; i++)
+        {
+            if (!startThread(&workers[i].thread, runDesk, &workers[i]))
+            {
+                runDesk(&workers[i]);
+            }
+        }
+
+        for (i = 0; i < threads; i++)
+        {
+            joinThread(&workers[i].thread);
+        }
+
+        result = nowSeconds() - start;
+
+        for (i = 0; i < threads; i++)
+        {
+            sink += workers[i].total;
+        }
+    }
+
+    freeMutex(&global);
+
+    if (ok)
+    {
+        closeFrontDesk(&desk);
+    }
+
+    freeClinicData(&data);
+
+    return result;
+}
+
+// Write one result line
+static void printResult(const char* locking, int threads, double seconds)
+{
+    int ops = DESKS_OPERATIONS / threads * threads;
+
+    printf("%s\t%d\t%d\t%.3f\t%.0f\n", locking, threads, ops, seconds,
+           seconds > 0 ? ops / seconds : 0.0);
+}
+
+
+int main(int argc, char* argv[])
+{
+    int threads, useGlobal;
+
+    int rows = argc > 1 ? atoi(argv[1]) : 100000;
+    int maxThreads = argc > 3 ? atoi(argv[3]) : 2 * processorCount();
+
+    unsigned int seed = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 1u;
+
+    int status = 0;
+
+    double seconds;
+
+    if (rows < 1 || maxThreads < 1 || maxThreads > DESKS_MAX_THREADS)
+    {
+        printf("Usage: desks [rows] [seed] [threads (1 to %d)]\n", DESKS_MAX_THREADS);
+        status = 1;
+    }
+    else if (!generateClinicData(DESKS_PATIENT_FILE, DESKS_APPOINT_FILE, rows, rows, seed))
+    {
+        printf("ERROR: The data files could not be written!\n");
+        status = 1;
+    }
+    else
+    {
+        printf("# clinic desks: %d patients, %d appointments, seed %u, %d processors\n",
+               rows, rows, seed, processorCount());
+        printf("locking\tdesks\tops\tseconds\tops_per_second\n");
+
+        for (threads = 1; threads <= maxThreads && !status; threads *= 2)
+        {
+            for (useGlobal = 0; useGlobal < 2 && !status; useGlobal++)
+            {
+                seconds = timeDesks(threads, rows, useGlobal);
+
+                if (seconds < 0)
+                {
+                    printf("ERROR: The clinic could not be imported!\n");
+                    status = 1;
+                }
+                else
+                {
+                    printResult(useGlobal ? "global" : "sharded", threads, seconds);
+                }
+            }
+        }
+    }
+
+    remove(DESKS_PATIENT_FILE);
+    remove(DESKS_APPOINT_FILE);
+
+    return status;
+}
@@ -0,0 +1,46 @@
+// Writes synthetic clinic data files (not part of the VS solution)
+//
+// Build and run from this folder ("make generate" builds it):
+//     gcc -std=c11 -O2 -pthread -I.. generate.c generator.c ../clinic.c ../core.c
+//         ../import.c ../index.c ../journal.c ../mapfile.c ../replay.c ../report.c ../scan.c
+//         ../stats.c ../store.c ../thread.c ../trace.c -o generate
+//     ./generate <patients> [appointments] [seed]
+//
+// writes patientData.txt and appointmentData.txt to the current folder
+// (appointments defaults to the number of patients and seed to 1)
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "generator.h"
+
+int main(int argc, char* argv[])
+{
+    int patients = argc > 1 ? atoi(argv[1]) : 0;
+    int appointments = argc > 2 ? atoi(argv[2]) : patients;
+
+    unsigned int seed = argc > 3 ? (unsigned int)strtoul(argv[3], NULL, 10) : 1u;
+
+    int status = 0;
+
+    if (patients < 1 || appointments < 0)
+    {
+        printf("Usage: generate <patients> [appointments] [seed]\n");
+        status = 1;
+    }
+    else if (!generateClinicData("patientData.txt", "appointmentData.txt", patients,
+                                 appointments, seed))
+    {
+        printf("ERROR: The data files could not be written!\n");
+        status = 1;
+    }
+    else
+    {
+        printf("Wrote %d patient and %d appointment records (seed %u)\n", patients,
+               appointments, seed);
+    }
+
+    return status;
+}
@@ -0,0 +1,189 @@
+// Synthetic clinic data in the import formats (not part of the VS solution)
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+
+#include "clinic.h"
+#include "generator.h"
+
+// Pet names and owner surnames households are made from
+static const char* const petNames[] =
+{
+    "Shaggy", "Pugsley", "Beans", "Banjo", "Lettuce", "Bullet", "Bessie", "Potato",
+    "Archie", "Wyatt", "Bug", "Pickles", "Insect", "Rover", "Mugsy", "Biscuit",
+    "Luna", "Max", "Bella", "Charlie", "Daisy", "Milo", "Coco", "Rocky", "Ziggy",
+    "Pepper", "Nala", "Oscar", "Tilly", "Moose", "Olive", "Gizmo"
+};
+
+static const char* const surnames[] =
+{
+    "Yanson", "Maulin", "Codi", "Lemme", "Lidgely", "Yards", "Ashness", "Tevlin",
+    "Green", "Peas", "Davidov", "Malone", "Okafor", "Nguyen", "Kowal", "Brandt",
+    "Silva", "Moreau", "Haddad", "Rossi", "Lund", "Park", "Quinn", "Ortega"
+};
+
+// Contact types by household, in percent (CELL, HOME, WORK, TBD)
+static const int contactPercents[] = { 50, 25, 10, 15 };
+static const char* const contactNames[] = { "CELL", "HOME", "WORK", "TBD" };
+
+#define COUNT_OF(array) ((int)(sizeof(array) / sizeof((array)[0])))
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Next value of a xorshift generator (never 0 for a non-zero state)
+static unsigned long long nextValue(unsigned long long* state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+// Random number from 0 to "limit" - 1
+static int randomBelow(unsigned long long* state, int limit)
+{
+    return (int)(nextValue(state) % (unsigned long long)limit);
+}
+
+// Write the patient file, one household at a time
+static int writePatients(FILE* fp, int patients, unsigned long long* state)
+{
+    int i, pet, pets, type, roll, result = 1;
+
+    char name[NAME_LEN + 1];
+    char phone[PHONE_LEN + 1];
+
+    const char* surname;
+
+    for (i = 0; i < patients && result; )
+    {
+        // Households of 1 (50%), 2 (25%), 3 (15%) or 4 (10%) pets
+        roll = randomBelow(state, 100);
+        pets = roll < 50 ? 1 : roll < 75 ? 2 : roll < 90 ? 3 : 4;
+
+        surname = surnames[randomBelow(state, COUNT_OF(surnames))];
+
+        roll = randomBelow(state, 100);
+        for (type = 0; roll >= contactPercents[type]; type++)
+        {
+            roll -= contactPercents[type];
+        }
+
+        // Area codes 201 to 989; TBD contacts have no number yet
+        phone[0] = '\0';
+        if (type != COUNT_OF(contactNames) - 1)
+        {
+            sprintf(phone, "%03d%07d", 201 + randomBelow(state, 789),
+                    randomBelow(state, 10000000));
+        }
+
+        for (pet = 0; pet < pets && i < patients && result; pet++, i++)
+        {
+            snprintf(name, sizeof(name), "%s %s",
+                     petNames[randomBelow(state, COUNT_OF(petNames))], surname);
+
+            result = fprintf(fp, "%d|%s|%s|%s\n", generatedPatientNumber(i), name,
+                             contactNames[type], phone) > 0;
+        }
+    }
+
+    return result;
+}
+
+// Write the appointment file
+static int writeAppointments(FILE* fp, int patients, int appointments, unsigned long long* state)
+{
+    int i, day, slot, minutes, patient, result = 1;
+
+    struct Date date;
+
+    struct Date center = { GENERATOR_CENTER_YEAR, GENERATOR_CENTER_MONTH,
+                           GENERATOR_CENTER_DAY };
+
+    int centerDay = dateToDayNumber(&center);
+
+    for (i = 0; i < appointments && result; i++)
+    {
+        do
+        {
+            if (randomBelow(state, 100) < GENERATOR_BACKGROUND_PERCENT)
+            {
+                day = centerDay - GENERATOR_BACKGROUND_YEARS * 365 +
+                      randomBelow(state, 2 * GENERATOR_BACKGROUND_YEARS * 365 + 1);
+            }
+            else
+            {
+                // The sum of three even draws bunches up in the middle
+                day = centerDay - GENERATOR_SPREAD_DAYS +
+                      (randomBelow(state, GENERATOR_SPREAD_DAYS + 1) +
+                       randomBelow(state, GENERATOR_SPREAD_DAYS + 1) +
+                       randomBelow(state, GENERATOR_SPREAD_DAYS + 1)) * 2 / 3;
+            }
+
+            // Day 0 (1970-01-01) was a Thursday
+        } while ((day % 7 + 7 + 4) % 7 == 0);
+
+        dayNumberToDate(day, &date);
+
+        // The earlier of two slots favours the morning
+        slot = randomBelow(state, APPOINT_SLOTS);
+        minutes = randomBelow(state, APPOINT_SLOTS);
+        slot = minutes < slot ? minutes : slot;
+        minutes = FIRST_HOUR * 60 + FIRST_MIN + slot * APPOINT_LENGTH;
+
+        // The product of two even draws favours the lowest (oldest) patients
+        patient = (int)((unsigned long long)randomBelow(state, patients) *
+                        (unsigned long long)(randomBelow(state, patients) + 1) / patients);
+
+        result = fprintf(fp, "%d,%d,%d,%d,%d,%d\n", generatedPatientNumber(patient),
+                         date.year, date.month, date.day, minutes / 60, minutes % 60) > 0;
+    }
+
+    return result;
+}
+
+
+//////////////////////////////////////
+// GENERATOR FUNCTIONS
+//////////////////////////////////////
+
+// Write "patients" patient records and "appointments" appointment records
+// in the import formats (returns 0 if a file could not be written)
+int generateClinicData(const char* patientFile, const char* appointFile, int patients,
+                       int appointments, unsigned int seed)
+{
+    int result = 0;
+
+    unsigned long long state = 0x9e3779b97f4a7c15ull ^ seed;
+
+    FILE* patientFp = fopen(patientFile, "w");
+    FILE* appointFp = fopen(appointFile, "w");
+
+    if (patientFp != NULL && appointFp != NULL && patients > 0)
+    {
+        result = writePatients(patientFp, patients, &state) &&
+                 writeAppointments(appointFp, patients, appointments, &state);
+    }
+
+    if (patientFp != NULL && fclose(patientFp) != 0)
+    {
+        result = 0;
+    }
+    if (appointFp != NULL && fclose(appointFp) != 0)
+    {
+        result = 0;
+    }
+
+    return result;
+}
+
+// Patient number of the i-th generated patient (from 0)
+int generatedPatientNumber(int i)
+{
+    return GENERATOR_FIRST_PATIENT + i * GENERATOR_PATIENT_STEP;
+}
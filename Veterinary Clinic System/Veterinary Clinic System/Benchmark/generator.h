@@ -0,0 +1,42 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// First patient number and the step between numbers (as in the sample data)
+#define GENERATOR_FIRST_PATIENT 1024
+#define GENERATOR_PATIENT_STEP 8
+
+// Busiest day of the generated schedule and how far most bookings fall
+// from it (in days)
+#define GENERATOR_CENTER_YEAR 2025
+#define GENERATOR_CENTER_MONTH 6
+#define GENERATOR_CENTER_DAY 15
+#define GENERATOR_SPREAD_DAYS 270
+
+// Percent of bookings spread evenly over GENERATOR_BACKGROUND_YEARS on
+// each side of the busiest day rather than clustered around it
+#define GENERATOR_BACKGROUND_PERCENT 20
+#define GENERATOR_BACKGROUND_YEARS 5
+
+
+//////////////////////////////////////
+// GENERATOR FUNCTIONS
+//////////////////////////////////////
+
+// Write "patients" patient records and "appointments" appointment records
+// in the import formats.  Patients come in households of one to four pets
+// sharing a surname and the owner's phone (some owners only have a TBD
+// contact with no number).  Bookings cluster around the busiest day,
+// favour the morning and the long-standing patients, and skip Sundays.
+// The same seed always writes the same files.  (returns 0 if a file could
+// not be written)
+int generateClinicData(const char* patientFile, const char* appointFile, int patients,
+                       int appointments, unsigned int seed);
+
+// Patient number of the i-th generated patient (from 0)
+int generatedPatientNumber(int i);
+
+#endif // !GENERATOR_H
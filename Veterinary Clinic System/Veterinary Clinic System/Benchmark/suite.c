@@ -0,0 +1,363 @@
+// Benchmark suite timing the clinic operations on generated data (not part
+// of the VS solution)
+//
+// Build and run from this folder ("make suite" builds it):
+//     gcc -std=c11 -O2 -pthread -I.. suite.c generator.c ../clinic.c ../core.c ../import.c
+//         ../index.c ../journal.c ../mapfile.c ../replay.c ../report.c ../scan.c ../stats.c
+//         ../store.c ../thread.c ../trace.c -o suite
+//     ./suite [rows] [seed]
+//
+// Generates "rows" patients and appointments (default 100000, seed 1) and
+// writes one tab-separated line per operation: its name, the rows loaded,
+// the operations timed and the nanoseconds per operation.  Lines starting
+// with '#' describe the run, so the output of two commits can be compared
+// line by line.
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "clinic.h"
+#include "generator.h"
+#include "import.h"
+#include "scan.h"
+
+#define SUITE_LOOKUPS 1000000
+#define SUITE_CONFLICT_CHECKS 1000000
+#define SUITE_DAY_VIEWS 10000
+
+#define SUITE_PATIENT_FILE "suitePatients.txt"
+#define SUITE_APPOINT_FILE "suiteAppointments.txt"
+#define SUITE_LISTING_FILE "suiteListing.txt"
+
+// Results folded in so the timed work cannot be optimized away
+static volatile long long sink;
+
+// Listings are rendered here (too big for the stack of some platforms)
+static struct Report listing;
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Current wall clock time in seconds
+static double nowSeconds(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Small deterministic pseudo-random generator (same sequence on every run)
+static unsigned int nextRandom(unsigned int* state)
+{
+    *state = *state * 1103515245u + 12345u;
+
+    return *state >> 8;
+}
+
+// Random number from 0 to "limit" - 1, for limits beyond the 24 bits of
+// nextRandom
+static int randomIndex(unsigned int* state, int limit)
+{
+    unsigned long long value = (unsigned long long)nextRandom(state) << 24 | nextRandom(state);
+
+    return (int)(value % (unsigned long long)limit);
+}
+
+// Every appointment in date/time order (returns NULL if out of memory)
+static struct Appointment* readAllAppointments(const struct ClinicData* data)
+{
+    int i, count = 0;
+
+    struct Appointment* appoints = malloc((data->appointments.count + 1) *
+                                          sizeof(struct Appointment));
+
+    if (appoints != NULL)
+    {
+        for (i = firstAppointmentIndex(data); i != -1; i = nextAppointmentIndex(data, i))
+        {
+            readAppointment(data, i, &appoints[count++]);
+        }
+    }
+
+    return appoints;
+}
+
+// Write one result line
+static void printResult(const char* operation, int rows, int ops, double seconds)
+{
+    printf("%s\t%d\t%d\t%.1f\n", operation, rows, ops, ops ? seconds * 1e9 / ops : 0.0);
+}
+
+
+//////////////////////////////////////
+// SUITE OPERATIONS
+//////////////////////////////////////
+
+// Import both data files into "data"
+static void timeImport(struct ClinicData* data, int rows)
+{
+    int count;
+
+    double start;
+
+    start = nowSeconds();
+    count = importPatients(SUITE_PATIENT_FILE, data);
+    printResult("import_patients", rows, count, nowSeconds() - start);
+
+    start = nowSeconds();
+    count = importAppointments(SUITE_APPOINT_FILE, data);
+    printResult("import_appointments", rows, count, nowSeconds() - start);
+}
+
+// Sort a shuffled copy of every appointment
+static void timeSort(const struct ClinicData* data, int rows)
+{
+    int i, j, count = data->appointments.count;
+
+    unsigned int seed = 5;
+
+    double start;
+
+    struct Appointment swap;
+    struct Appointment* appoints = readAllAppointments(data);
+
+    if (appoints != NULL && count)
+    {
+        for (i = count - 1; i > 0; i--)
+        {
+            j = randomIndex(&seed, i + 1);
+            swap = appoints[i];
+            appoints[i] = appoints[j];
+            appoints[j] = swap;
+        }
+
+        start = nowSeconds();
+        sortAppointments(appoints, count);
+        printResult("sort_appointments", rows, count, nowSeconds() - start);
+
+        sink += appoints[count / 2].key;
+    }
+
+    free(appoints);
+}
+
+// Look patients up by number and by phone number
+static void timeLookups(const struct ClinicData* data, int rows)
+{
+    int i, slot;
+
+    unsigned int seed = 7;
+
+    double start;
+
+    long long* keys = malloc(SUITE_LOOKUPS * sizeof(long long));
+
+    struct Patient patient;
+
+    start = nowSeconds();
+    for (i = 0; i < SUITE_LOOKUPS; i++)
+    {
+        sink += findPatientIndexByPatientNum(generatedPatientNumber(randomIndex(&seed, rows)),
+                                             data);
+    }
+    printResult("lookup_patient_number", rows, SUITE_LOOKUPS, nowSeconds() - start);
+
+    if (keys != NULL)
+    {
+        // Numbers of random patients, TBD contacts included (their key is
+        // the empty number's, shared by every one of them)
+        for (i = 0; i < SUITE_LOOKUPS; i++)
+        {
+            slot = findPatientIndexByPatientNum(generatedPatientNumber(randomIndex(&seed, rows)),
+                                                data);
+            keys[i] = -1;
+
+            if (slot != -1)
+            {
+                readPatient(data, slot, &patient);
+                keys[i] = phoneNumberKey(&patient.phone);
+            }
+        }
+
+        start = nowSeconds();
+        for (i = 0; i < SUITE_LOOKUPS; i++)
+        {
+            sink += findPhoneSlot(&data->phoneIndex, keys[i]);
+        }
+        printResult("lookup_phone", rows, SUITE_LOOKUPS, nowSeconds() - start);
+    }
+
+    free(keys);
+}
+
+// Check random slots on booked days for conflicts
+static void timeConflictChecks(const struct ClinicData* data, const struct Appointment* appoints,
+                               int rows)
+{
+    int i, taken = 0;
+
+    unsigned int seed = 11;
+
+    double start;
+
+    unsigned int* keys = malloc(SUITE_CONFLICT_CHECKS * sizeof(unsigned int));
+
+    if (keys != NULL && data->appointments.count)
+    {
+        for (i = 0; i < SUITE_CONFLICT_CHECKS; i++)
+        {
+            keys[i] = (appoints[randomIndex(&seed, data->appointments.count)].key &
+                       ~KEY_SLOT_MASK) |
+                      (unsigned int)randomIndex(&seed, APPOINT_SLOTS);
+        }
+
+        start = nowSeconds();
+        for (i = 0; i < SUITE_CONFLICT_CHECKS; i++)
+        {
+            taken += isSlotTaken(data, keys[i]);
+        }
+        printResult("conflict_check", rows, SUITE_CONFLICT_CHECKS, nowSeconds() - start);
+
+        sink += taken;
+    }
+
+    free(keys);
+}
+
+// Render the schedule of random booked days, as "view by date" does
+static void timeDayViews(const struct ClinicData* data, const struct Appointment* appoints,
+                         int rows)
+{
+    int i, count;
+
+    unsigned int seed = 13;
+    unsigned int dayKey;
+
+    double start;
+
+    int* positions = malloc((data->appointments.count + 1) * sizeof(int));
+
+    struct Date date;
+
+    FILE* fp = fopen(SUITE_LISTING_FILE, "w");
+
+    if (positions != NULL && fp != NULL && data->appointments.count)
+    {
+        openReport(&listing, fp);
+
+        start = nowSeconds();
+        for (i = 0; i < SUITE_DAY_VIEWS; i++)
+        {
+            appointmentDate(&appoints[randomIndex(&seed, data->appointments.count)], &date);
+            dayKey = appointmentDayKey(&date);
+
+            count = filterAppointmentsByKey(data, dayKey, dayKey | KEY_SLOT_MASK, positions,
+                                            findDayCount(&data->dayIndex,
+                                                         dateToDayNumber(&date)));
+
+            renderScheduleTableHeader(&listing, &date, 0);
+            renderSchedulePositions(&listing, data, positions, count, 0);
+        }
+        flushReport(&listing);
+        printResult("day_view", rows, SUITE_DAY_VIEWS, nowSeconds() - start);
+    }
+
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+    free(positions);
+}
+
+// Render every appointment and every patient, as the "view all" menus do
+static void timeListings(const struct ClinicData* data, int rows)
+{
+    int i;
+
+    double start;
+
+    struct Patient patient;
+
+    FILE* fp = fopen(SUITE_LISTING_FILE, "w");
+
+    if (fp != NULL)
+    {
+        openReport(&listing, fp);
+
+        start = nowSeconds();
+        renderScheduleTableHeader(&listing, NULL, 1);
+        renderScheduleRange(&listing, data, firstAppointmentIndex(data),
+                            data->appointments.count, 1);
+        flushReport(&listing);
+        printResult("list_appointments", rows, data->appointments.count, nowSeconds() - start);
+
+        start = nowSeconds();
+        renderPatientTableHeader(&listing);
+        for (i = nextPatientSlot(data, 0); i != -1; i = nextPatientSlot(data, i + 1))
+        {
+            readPatient(data, i, &patient);
+            renderPatientData(&listing, data, &patient, FMT_TABLE);
+        }
+        flushReport(&listing);
+        printResult("list_patients", rows, data->patients.liveCount, nowSeconds() - start);
+
+        fclose(fp);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int rows = argc > 1 ? atoi(argv[1]) : 100000;
+
+    unsigned int seed = argc > 2 ? (unsigned int)strtoul(argv[2], NULL, 10) : 1u;
+
+    int status = 0;
+
+    struct Appointment* appoints = NULL;
+    struct ClinicData data = { 0 };
+
+    if (rows < 1)
+    {
+        printf("Usage: suite [rows] [seed]\n");
+        status = 1;
+    }
+    else if (!generateClinicData(SUITE_PATIENT_FILE, SUITE_APPOINT_FILE, rows, rows, seed))
+    {
+        printf("ERROR: The data files could not be written!\n");
+        status = 1;
+    }
+    else
+    {
+        printf("# clinic suite: %d patients, %d appointments, seed %u, scan level %d\n",
+               rows, rows, seed, scanLevel());
+        printf("operation\trows\tops\tns_per_op\n");
+
+        timeImport(&data, rows);
+        timeSort(&data, rows);
+        timeLookups(&data, rows);
+
+        // Conflict checks and day views pick days that have bookings
+        if ((appoints = readAllAppointments(&data)) != NULL && data.appointments.count)
+        {
+            timeConflictChecks(&data, appoints, rows);
+            timeDayViews(&data, appoints, rows);
+        }
+
+        timeListings(&data, rows);
+    }
+
+    free(appoints);
+    freeClinicData(&data);
+
+    remove(SUITE_PATIENT_FILE);
+    remove(SUITE_APPOINT_FILE);
+    remove(SUITE_LISTING_FILE);
+
+    return status;
+}
@@ -0,0 +1,587 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "batch.h"
+#include "clinic.h"
+#include "desk.h"
+#include "import.h"
+#include "thread.h"
+
+// Data type: BatchRun
+// A batch being run: its front desk, its results, and the commands run
+// since the last commit
+struct BatchRun
+{
+    struct FrontDesk* desk;
+    struct Report* results;
+    int pending;
+};
+
+// Data type: BatchCommand
+// A command name and the function that runs it on the text after the
+// first '|'; the function renders "ok..." or "error|..." and returns 0 if
+// the command failed
+struct BatchCommand
+{
+    const char* name;
+    int (*run)(struct BatchRun* batch, const char* args, int length, struct Report* report);
+};
+
+// Data type: BatchTerminal
+// A command file run by runBatchDesks on a thread of its own, and what
+// runBatch returned for it
+struct BatchTerminal
+{
+    struct FrontDesk* desk;
+    const char* batchFile;
+    FILE* out;
+    int count;
+    int failed;
+    struct Thread thread;
+};
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Render a failed command's reason (returns 0)
+static int renderError(struct Report* report, const char* reason)
+{
+    reportText(report, "error|");
+    reportText(report, reason);
+
+    return 0;
+}
+
+// Read a patient number making up all of "args" (returns 0 if it is not a
+// number from 1 to 999999999)
+static int parsePatientNumber(const char* args, int length, int* number)
+{
+    int i;
+
+    *number = 0;
+
+    for (i = 0; i < length && i < 9 && args[i] >= '0' && args[i] <= '9'; i++)
+    {
+        *number = *number * 10 + (args[i] - '0');
+    }
+
+    return i == length && *number > 0;
+}
+
+// Render a date and time as "YYYY-MM-DD HH:MM"
+static void renderDateTime(struct Report* report, const struct Date* date,
+                           const struct Time* time)
+{
+    reportNumber(report, date->year, 4);
+    reportChar(report, '-');
+    reportNumber(report, date->month, 2);
+    reportChar(report, '-');
+    reportNumber(report, date->day, 2);
+    reportChar(report, ' ');
+    reportNumber(report, time->hour, 2);
+    reportChar(report, ':');
+    reportNumber(report, time->min, 2);
+}
+
+// Commit the changes made so far and write out their results
+static void commitBatch(struct BatchRun* batch)
+{
+    deskCommit(batch->desk);
+
+    flushReport(batch->results);
+    batch->pending = 0;
+}
+
+// Make room for "length" bytes of results, committing first if the full
+// buffer would otherwise write out results of changes not yet committed
+static void reserveResults(struct BatchRun* batch, int length)
+{
+    if (batch->pending && batch->results->used + length > REPORT_BUFFER_SIZE)
+    {
+        commitBatch(batch);
+    }
+}
+
+// Run one terminal's command file (thread function)
+static void runTerminal(void* arg)
+{
+    struct BatchTerminal* terminal = arg;
+
+    terminal->count = runBatch(terminal->desk, terminal->batchFile, terminal->out,
+                               &terminal->failed);
+}
+
+
+//////////////////////////////////////
+// COMMANDS
+//////////////////////////////////////
+
+// add-patient|name|description|phone: store a patient under the next
+// patient number
+static int runAddPatient(struct BatchRun* batch, const char* args, int length,
+                         struct Report* report)
+{
+    int result = 0;
+
+    char line[BATCH_LINE_LEN + 3];
+
+    const char* error;
+
+    struct PatientEntry entry;
+
+    // The fields are those of a data file record after its patient number
+    length = sprintf(line, "0|%.*s", length, args);
+
+    if (!parsePatientLine(line, length, &entry, &error))
+    {
+        result = renderError(report, error);
+    }
+    else
+    {
+        switch (deskAddPatient(batch->desk, &entry))
+        {
+        case DESK_OK:
+            reportText(report, "ok|");
+            reportNumber(report, entry.patientNumber, 0);
+
+            result = 1;
+            break;
+        case DESK_FULL:
+            renderError(report, "patient listing is full");
+            break;
+        default:
+            renderError(report, "out of memory");
+            break;
+        }
+    }
+
+    return result;
+}
+
+// remove-patient|<patient number>: remove a patient (its appointments stay,
+// as with the menu)
+static int runRemovePatient(struct BatchRun* batch, const char* args, int length,
+                            struct Report* report)
+{
+    int number, result = 0;
+
+    if (!parsePatientNumber(args, length, &number))
+    {
+        renderError(report, "patient number is not a number");
+    }
+    else if (deskRemovePatient(batch->desk, number) == DESK_NOT_FOUND)
+    {
+        renderError(report, "patient record not found");
+    }
+    else
+    {
+        reportText(report, "ok");
+
+        result = 1;
+    }
+
+    return result;
+}
+
+// find-patient|<patient number>: a patient as its data file record
+static int runFindPatient(struct BatchRun* batch, const char* args, int length,
+                          struct Report* report)
+{
+    int number, result = 0;
+
+    char phone[PHONE_LEN + 1];
+
+    struct PatientEntry patient;
+
+    if (!parsePatientNumber(args, length, &number))
+    {
+        renderError(report, "patient number is not a number");
+    }
+    else if (deskFindPatient(batch->desk, number, &patient) == DESK_NOT_FOUND)
+    {
+        renderError(report, "patient record not found");
+    }
+    else
+    {
+        phoneNumber(&patient.phone, phone);
+
+        reportText(report, "ok|");
+        reportNumber(report, patient.patientNumber, 0);
+        reportChar(report, '|');
+        reportText(report, patient.name);
+        reportChar(report, '|');
+        reportText(report, phoneDescription(&patient.phone));
+        reportChar(report, '|');
+        reportText(report, phone);
+
+        result = 1;
+    }
+
+    return result;
+}
+
+// book|number,year,month,day,hour,minute: book a free slot for a patient
+// (a taken slot lists the next free ones)
+static int runBook(struct BatchRun* batch, const char* args, int length,
+                   struct Report* report)
+{
+    int i, suggested, result = 0;
+
+    unsigned int keys[SUGGESTED_SLOTS];
+
+    const char* error;
+
+    struct Appointment appoint;
+    struct Appointment offered = { 0 };
+    struct Date date;
+    struct Time time;
+
+    if (!parseAppointmentLine(args, length, &appoint, &error))
+    {
+        renderError(report, error);
+    }
+    else
+    {
+        switch (deskBook(batch->desk, &appoint, keys, &suggested))
+        {
+        case DESK_OK:
+            reportText(report, "ok");
+
+            result = 1;
+            break;
+        case DESK_NOT_FOUND:
+            renderError(report, "patient record not found");
+            break;
+        case DESK_TAKEN:
+            renderError(report, "appointment timeslot is not available");
+            break;
+        default:
+            renderError(report, "out of memory");
+            break;
+        }
+
+        // Only a taken slot has free times suggested
+        for (i = 0; i < suggested; i++)
+        {
+            offered.key = keys[i];
+            appointmentDate(&offered, &date);
+            appointmentTime(&offered, &time);
+
+            reportChar(report, '|');
+            renderDateTime(report, &date, &time);
+        }
+    }
+
+    return result;
+}
+
+// cancel|number,year,month,day,hour,minute: remove a patient's appointment
+static int runCancel(struct BatchRun* batch, const char* args, int length,
+                     struct Report* report)
+{
+    int result = 0;
+
+    const char* error;
+
+    struct Appointment appoint;
+
+    if (!parseAppointmentLine(args, length, &appoint, &error))
+    {
+        renderError(report, error);
+    }
+    else if (deskCancel(batch->desk, &appoint) == DESK_NOT_FOUND)
+    {
+        renderError(report, "appointment record not found");
+    }
+    else
+    {
+        reportText(report, "ok");
+
+        result = 1;
+    }
+
+    return result;
+}
+
+// query-day|year,month,day: the times and patients booked on a day
+static int runQueryDay(struct BatchRun* batch, const char* args, int length,
+                       struct Report* report)
+{
+    int i, count, capacity = APPOINT_SLOTS, used = -1, result = 0;
+
+    char text[BATCH_LINE_LEN + 1];
+
+    struct Date date = { 0 };
+    struct Time time;
+    struct Appointment slots[APPOINT_SLOTS];
+    struct Appointment* appoint = slots;
+    struct Appointment* larger;
+
+    sprintf(text, "%.*s", length, args);
+
+    if (sscanf(text, "%d,%d,%d%n", &date.year, &date.month, &date.day, &used) != 3 ||
+        used != length)
+    {
+        renderError(report, "expected three comma separated numbers");
+    }
+    else if (date.year < FIRST_YEAR || date.year > LAST_YEAR)
+    {
+        renderError(report, "year is out of range");
+    }
+    else if (date.month < JAN || date.month > DEC)
+    {
+        renderError(report, "month is out of range");
+    }
+    else if (date.day < 1 || date.day > daysInMonth(date.year, date.month))
+    {
+        renderError(report, "day is out of range");
+    }
+    else
+    {
+        // A day booked through the menus has a slot each, but imported data
+        // can pack more in; the copy is retried in a larger array if the day
+        // grew while it was allocated
+        while ((count = deskQueryDay(batch->desk, &date, appoint, capacity)) > capacity &&
+               (larger = malloc(count * sizeof(struct Appointment))) != NULL)
+        {
+            if (appoint != slots)
+            {
+                free(appoint);
+            }
+
+            appoint = larger;
+            capacity = count;
+        }
+
+        if (count > capacity)
+        {
+            renderError(report, "out of memory");
+        }
+        else
+        {
+            reserveResults(batch, BATCH_RESULT_LEN + count * BATCH_DAY_ENTRY_LEN);
+
+            reportText(report, "ok|");
+            reportNumber(report, count, 0);
+
+            for (i = 0; i < count; i++)
+            {
+                appointmentTime(&appoint[i], &time);
+
+                reportChar(report, '|');
+                reportNumber(report, time.hour, 2);
+                reportChar(report, ':');
+                reportNumber(report, time.min, 2);
+                reportChar(report, ',');
+                reportNumber(report, appoint[i].patientNumber, 0);
+            }
+
+            result = 1;
+        }
+
+        if (appoint != slots)
+        {
+            free(appoint);
+        }
+    }
+
+    return result;
+}
+
+// Commands by name
+static const struct BatchCommand batchCommands[] =
+{
+    { "add-patient", runAddPatient },
+    { "remove-patient", runRemovePatient },
+    { "find-patient", runFindPatient },
+    { "book", runBook },
+    { "cancel", runCancel },
+    { "query-day", runQueryDay }
+};
+
+
+//////////////////////////////////////
+// BATCH FUNCTIONS
+//////////////////////////////////////
+
+// Run the commands of a batch file ("-" for stdin) without prompting,
+// writing one result line per command (returns # of commands run or -1 if
+// the file could not be opened; "failed" gets # of commands that failed)
+int runBatch(struct FrontDesk* desk, const char* batchFile, FILE* out, int* failed)
+{
+    int i, c, length, nameLength, lineNumber = 0, ok, result = -1;
+
+    char line[BATCH_LINE_LEN + 2];
+
+    const char* args;
+    const char* bar;
+
+    // Each terminal running a batch has its own results (too big for a
+    // thread's stack on some systems)
+    struct Report* results = malloc(sizeof(struct Report));
+
+    struct BatchRun batch = { 0 };
+
+    FILE* fp = strcmp(batchFile, "-") == 0 ? stdin : fopen(batchFile, "r");
+
+    *failed = 0;
+
+    if (fp != NULL && results != NULL)
+    {
+        result = 0;
+
+        openReport(results, out);
+
+        batch.desk = desk;
+        batch.results = results;
+
+        while (fgets(line, sizeof(line), fp) != NULL)
+        {
+            lineNumber++;
+            length = (int)strlen(line);
+
+            // A line that did not fit is skipped to its end and fails
+            ok = length < BATCH_LINE_LEN + 1 || line[length - 1] == '\n';
+
+            if (!ok)
+            {
+                do
+                {
+                    c = fgetc(fp);
+                } while (c != '\n' && c != EOF);
+            }
+
+            while (length && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+            {
+                line[--length] = '\0';
+            }
+
+            if (length && line[0] != '#')
+            {
+                bar = memchr(line, '|', length);
+                nameLength = bar != NULL ? (int)(bar - line) : length;
+                args = bar != NULL ? bar + 1 : line + length;
+
+                reserveResults(&batch, BATCH_RESULT_LEN);
+
+                reportNumber(results, lineNumber, 0);
+                reportChar(results, '|');
+
+                for (i = 0; i < (int)(sizeof(batchCommands) / sizeof(batchCommands[0])) &&
+                     (strncmp(batchCommands[i].name, line, nameLength) != 0 ||
+                      batchCommands[i].name[nameLength] != '\0'); i++)
+                {
+                    ;
+                }
+
+                if (!ok)
+                {
+                    renderError(results, "line is too long");
+                }
+                else if (i == (int)(sizeof(batchCommands) / sizeof(batchCommands[0])))
+                {
+                    ok = renderError(results, "unknown command");
+                }
+                else
+                {
+                    ok = batchCommands[i].run(&batch, args, (int)(line + length - args), results);
+                }
+                reportChar(results, '\n');
+
+                result++;
+                *failed += !ok;
+
+                if (++batch.pending == BATCH_COMMIT_COMMANDS)
+                {
+                    commitBatch(&batch);
+                }
+            }
+        }
+
+        commitBatch(&batch);
+    }
+
+    if (fp != NULL && fp != stdin)
+    {
+        fclose(fp);
+    }
+
+    free(results);
+
+    return result;
+}
+
+// Run several batch files at once, each on a thread of its own as if typed
+// at its own front desk, writing each file's results to the file named
+// after it with BATCH_RESULT_SUFFIX added (returns # of commands run or -1
+// if a file could not be opened; "failed" gets # of commands that failed)
+int runBatchDesks(struct FrontDesk* desk, char* batchFiles[], int files, int* failed)
+{
+    int i, result = -1;
+
+    char* resultFile;
+
+    struct BatchTerminal* terminals = calloc(files, sizeof(struct BatchTerminal));
+
+    *failed = 0;
+
+    if (terminals != NULL)
+    {
+        result = 0;
+
+        for (i = 0; i < files && result != -1; i++)
+        {
+            terminals[i].desk = desk;
+            terminals[i].batchFile = batchFiles[i];
+
+            resultFile = malloc(strlen(batchFiles[i]) + sizeof(BATCH_RESULT_SUFFIX));
+
+            if (resultFile != NULL)
+            {
+                sprintf(resultFile, "%s%s", batchFiles[i], BATCH_RESULT_SUFFIX);
+                terminals[i].out = fopen(resultFile, "w");
+                free(resultFile);
+            }
+
+            if (terminals[i].out == NULL)
+            {
+                result = -1;
+            }
+        }
+
+        // A terminal whose thread does not start runs once the others are
+        // under way
+        for (i = 0; i < files && result != -1; i++)
+        {
+            if (!startThread(&terminals[i].thread, runTerminal, &terminals[i]))
+            {
+                runTerminal(&terminals[i]);
+            }
+        }
+
+        for (i = 0; i < files; i++)
+        {
+            joinThread(&terminals[i].thread);
+
+            if (result != -1)
+            {
+                result = terminals[i].count != -1 ? result + terminals[i].count : -1;
+                *failed += terminals[i].failed;
+            }
+
+            if (terminals[i].out != NULL)
+            {
+                fclose(terminals[i].out);
+            }
+        }
+    }
+
+    free(terminals);
+
+    return result;
+}
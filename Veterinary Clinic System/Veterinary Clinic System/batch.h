@@ -0,0 +1,65 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// Longest batch command line (longer lines fail)
+#define BATCH_LINE_LEN 256
+
+// Commands whose changes reach the journal (and their results the output)
+// together
+#define BATCH_COMMIT_COMMANDS 1000
+
+// Room a result line needs, with its line number: any command's but a
+// query-day's, which also needs BATCH_DAY_ENTRY_LEN per appointment listed
+// ("|HH:MM,<patient number>"); the changes made so far are committed
+// before a result that might not fit, so results never reach the output
+// before the changes they report
+#define BATCH_RESULT_LEN 128
+#define BATCH_DAY_ENTRY_LEN 17
+
+// Added to a command file's name to name the file runBatchDesks writes its
+// results to
+#define BATCH_RESULT_SUFFIX ".results"
+
+
+//////////////////////////////////////
+// Structures
+//////////////////////////////////////
+
+struct FrontDesk;
+
+
+//////////////////////////////////////
+// BATCH FUNCTIONS
+//////////////////////////////////////
+
+// Run the commands of a batch file ("-" for stdin) without prompting, one
+// per line with '|' between fields (blank lines and lines starting with '#'
+// are skipped):
+//     add-patient|name|description|phone      ok|<patient number>
+//     remove-patient|<patient number>         ok
+//     find-patient|<patient number>           ok|<patient data file record>
+//     book|<appointment data file record>     ok
+//     cancel|<appointment data file record>   ok
+//     query-day|year,month,day                ok|<count>|HH:MM,<patient number>|...
+// Each command writes "<line number>|" and its result to "out", or
+// "<line number>|error|<reason>" if it failed; a booking whose slot is
+// taken adds the next free times as "|YYYY-MM-DD HH:MM".  Results are
+// written once their changes are committed to the journal.  Several
+// batches can run on one front desk at once.
+// (returns # of commands run or -1 if the file could not be opened;
+// "failed" gets # of commands that failed)
+int runBatch(struct FrontDesk* desk, const char* batchFile, FILE* out, int* failed);
+
+// Run several batch files at once, each on a thread of its own as if typed
+// at its own front desk, writing each file's results to the file named
+// after it with BATCH_RESULT_SUFFIX added (returns # of commands run or -1
+// if a file could not be opened; "failed" gets # of commands that failed)
+int runBatchDesks(struct FrontDesk* desk, char* batchFiles[], int files, int* failed);
+
+#endif // !BATCH_H
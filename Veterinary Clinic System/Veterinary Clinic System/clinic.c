@@ -1,77 +1,231 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "core.h"
 #include "clinic.h"
+#include "import.h"
+#include "replay.h"
+#include "stats.h"
+#include "trace.h"
+
+// Data type: AppointmentImport (records collected by importAppointments)
+struct AppointmentImport
+{
+    struct Appointment* appoints;
+    int count;
+    int max;
+};
+
+// Phone descriptions by contact type (enum PhoneType)
+static const char* const phoneDescriptions[] = { "CELL", "HOME", "WORK", "TBD" };
 
 
 //////////////////////////////////////
 // DISPLAY FUNCTIONS
 //////////////////////////////////////
 
-// Display's the patient table header (table format)
-void displayPatientTableHeader(void)
+// Report the display functions format the screen into (each listing is
+// written to stdout in one piece when it is complete)
+static struct Report screen;
+
+// Render a phone number as (###)###-#### or (___)___-____ when there is
+// none (the stored number is always empty or PHONE_LEN digits, so this
+// spells out exactly what displayFormattedPhone prints)
+static void renderPhone(struct Report* report, const struct Phone* phone)
+{
+    char number[PHONE_LEN + 1];
+    char text[] = "(___)___-____";
+
+    phoneNumber(phone, number);
+
+    if (number[0] != '\0')
+    {
+        memcpy(text + 1, number, 3);
+        memcpy(text + 5, number + 3, 3);
+        memcpy(text + 9, number + 6, 4);
+    }
+
+    reportText(report, text);
+}
+
+// Render a patient's phone number and contact type: "(###)###-#### (CELL)\n"
+static void renderPhoneLine(struct Report* report, const struct Phone* phone)
 {
-    printf("Pat.# Name            Phone#\n"
-           "----- --------------- --------------------\n");
+    renderPhone(report, phone);
+    reportText(report, " (");
+    reportText(report, phoneDescription(phone));
+    reportText(report, ")\n");
 }
 
-// Displays a single patient record in FMT_FORM | FMT_TABLE format
-void displayPatientData(const struct Patient* patient, int fmt)
+// Render the patient table header (table format)
+void renderPatientTableHeader(struct Report* report)
+{
+    reportText(report, "Pat.# Name            Phone#\n"
+                       "----- --------------- --------------------\n");
+}
+
+// Render a single patient record in FMT_FORM | FMT_TABLE format
+void renderPatientData(struct Report* report, const struct ClinicData* data,
+                       const struct Patient* patient, int fmt)
 {
     if (fmt == FMT_FORM)
     {
-        printf("Name  : %s\n"
-               "Number: %05d\n"
-               "Phone : ", patient->name, patient->patientNumber);
-        displayFormattedPhone(patient->phone.number);
-        printf(" (%s)\n", patient->phone.description);
+        reportText(report, "Name  : ");
+        reportText(report, patientName(data, patient));
+        reportText(report, "\nNumber: ");
+        reportNumber(report, patient->patientNumber, 5);
+        reportText(report, "\nPhone : ");
     }
     else
     {
-        printf("%05d %-15s ", patient->patientNumber,
-               patient->name);
-        displayFormattedPhone(patient->phone.number);
-        printf(" (%s)\n", patient->phone.description);
+        reportNumber(report, patient->patientNumber, 5);
+        reportChar(report, ' ');
+        reportPadded(report, patientName(data, patient), NAME_LEN);
+        reportChar(report, ' ');
     }
+    renderPhoneLine(report, &patient->phone);
 }
 
-// Display's appointment schedule headers (date-specific or all records)
-void displayScheduleTableHeader(const struct Date* date, int isAllRecords)
+// Render appointment schedule headers (date-specific or all records)
+void renderScheduleTableHeader(struct Report* report, const struct Date* date, int isAllRecords)
 {
-    printf("Clinic Appointments for the Date: ");
+    reportText(report, "Clinic Appointments for the Date: ");
 
     if (isAllRecords)
     {
-        printf("<ALL>\n\n");
-        printf("Date       Time  Pat.# Name            Phone#\n"
-               "---------- ----- ----- --------------- --------------------\n");
+        reportText(report, "<ALL>\n\n"
+                           "Date       Time  Pat.# Name            Phone#\n"
+                           "---------- ----- ----- --------------- --------------------\n");
     }
     else
     {
-        printf("%04d-%02d-%02d\n\n", date->year, date->month, date->day);
-        printf("Time  Pat.# Name            Phone#\n"
-               "----- ----- --------------- --------------------\n");
+        reportNumber(report, date->year, 4);
+        reportChar(report, '-');
+        reportNumber(report, date->month, 2);
+        reportChar(report, '-');
+        reportNumber(report, date->day, 2);
+        reportText(report, "\n\n"
+                           "Time  Pat.# Name            Phone#\n"
+                           "----- ----- --------------- --------------------\n");
     }
 }
 
-// Display a single appointment record with patient info. in tabular format
-void displayScheduleData(const struct Patient* patient,
-                         const struct Appointment* appoint,
-                         int includeDateField)
+// Render a single appointment record with patient info. in tabular format
+void renderScheduleData(struct Report* report, const struct ClinicData* data,
+                        const struct Patient* patient, const struct Appointment* appoint,
+                        int includeDateField)
 {
+    struct Date date;
+    struct Time time;
+
+    appointmentDate(appoint, &date);
+    appointmentTime(appoint, &time);
+
     if (includeDateField)
     {
-        printf("%04d-%02d-%02d ", appoint->date.year, appoint->date.month,
-               appoint->date.day);
+        reportNumber(report, date.year, 4);
+        reportChar(report, '-');
+        reportNumber(report, date.month, 2);
+        reportChar(report, '-');
+        reportNumber(report, date.day, 2);
+        reportChar(report, ' ');
+    }
+    reportNumber(report, time.hour, 2);
+    reportChar(report, ':');
+    reportNumber(report, time.min, 2);
+    reportChar(report, ' ');
+    reportNumber(report, patient->patientNumber, 5);
+    reportChar(report, ' ');
+    reportPadded(report, patientName(data, patient), NAME_LEN);
+    reportChar(report, ' ');
+
+    renderPhoneLine(report, &patient->phone);
+}
+
+// Render a run of appointments joined with their patient records (the
+// patient number index resolves each row, so the cost is linear in rows)
+void renderScheduleRange(struct Report* report, const struct ClinicData* data, int first,
+                         int count, int includeDateField)
+{
+    int i, pos, index;
+
+    struct Appointment appoint;
+    struct Patient patient;
+
+    for (i = 0, pos = first; i < count && pos != -1; i++)
+    {
+        readAppointment(data, pos, &appoint);
+        index = findPatientIndexByPatientNum(appoint.patientNumber, data);
+
+        // Appointments whose patient has been removed are not listed
+        if (index != -1)
+        {
+            readPatient(data, index, &patient);
+            renderScheduleData(report, data, &patient, &appoint, includeDateField);
+        }
+
+        pos = nextAppointmentIndex(data, pos);
+    }
+}
+
+// Render the appointments at a list of positions joined with their
+// patient records
+void renderSchedulePositions(struct Report* report, const struct ClinicData* data,
+                             const int* positions, int count, int includeDateField)
+{
+    int i, index;
+
+    struct Appointment appoint;
+    struct Patient patient;
+
+    for (i = 0; i < count; i++)
+    {
+        readAppointment(data, positions[i], &appoint);
+        index = findPatientIndexByPatientNum(appoint.patientNumber, data);
+
+        // Appointments whose patient has been removed are not listed
+        if (index != -1)
+        {
+            readPatient(data, index, &patient);
+            renderScheduleData(report, data, &patient, &appoint, includeDateField);
+        }
     }
-    printf("%02d:%02d %05d %-15s ", appoint->time.hour, appoint->time.min,
-           patient->patientNumber, patient->name);
+}
 
-    displayFormattedPhone(patient->phone.number);
+// Display's the patient table header (table format)
+void displayPatientTableHeader(void)
+{
+    openReport(&screen, stdout);
+    renderPatientTableHeader(&screen);
+    flushReport(&screen);
+}
+
+// Displays a single patient record in FMT_FORM | FMT_TABLE format
+void displayPatientData(const struct ClinicData* data, const struct Patient* patient, int fmt)
+{
+    openReport(&screen, stdout);
+    renderPatientData(&screen, data, patient, fmt);
+    flushReport(&screen);
+}
 
-    printf(" (%s)\n", patient->phone.description);
+// Display's appointment schedule headers (date-specific or all records)
+void displayScheduleTableHeader(const struct Date* date, int isAllRecords)
+{
+    openReport(&screen, stdout);
+    renderScheduleTableHeader(&screen, date, isAllRecords);
+    flushReport(&screen);
+}
+
+// Display a single appointment record with patient info. in tabular format
+void displayScheduleData(const struct ClinicData* data, const struct Patient* patient,
+                         const struct Appointment* appoint,
+                         int includeDateField)
+{
+    openReport(&screen, stdout);
+    renderScheduleData(&screen, data, patient, appoint, includeDateField);
+    flushReport(&screen);
 }
 
 
@@ -82,7 +236,7 @@ void displayScheduleData(const struct Patient* patient,
 // main menu
 void menuMain(struct ClinicData* data)
 {
-    int selection;
+    int selection, events;
 
     do {
         printf("Veterinary Clinic System\n"
@@ -93,7 +247,7 @@ void menuMain(struct ClinicData* data)
                "0) Exit System\n"
                "-------------------------\n"
                "Selection: ");
-        selection = inputIntRange(0, 2);
+        selection = inputIntRangeHidden(0, 2, STATS_MENU_ITEM);
         putchar('\n');
         switch (selection)
         {
@@ -107,20 +261,35 @@ void menuMain(struct ClinicData* data)
             }
             break;
         case 1:
-            menuPatient(data->patients, data->maxPatient);
+            menuPatient(data);
             break;
         case 2:
             menuAppointment(data);
             break;
+        case STATS_MENU_ITEM:
+            reportStats(stdout);
+            putchar('\n');
+
+            // A trace being recorded is written out too
+            events = flushTrace();
+
+            if (events != -1)
+            {
+                printf("Wrote %d trace events.\n\n", events);
+            }
+            suspend();
+            break;
         }
     } while (selection);
 }
 
 // Menu: Patient Management
-void menuPatient(struct Patient patient[], int max)
+void menuPatient(struct ClinicData* data)
 {
     int selection;
 
+    long long start;
+
     do {
         printf("Patient Management\n"
                "=========================\n"
@@ -138,39 +307,65 @@ void menuPatient(struct Patient patient[], int max)
         switch (selection)
         {
         case 1:
-            displayAllPatients(patient, max, FMT_TABLE);
+            start = actionClock();
+            displayAllPatients(data, FMT_TABLE);
+            finishAction(ACTION_VIEW_PATIENTS, start);
             suspend();
             break;
         case 2:
-            searchPatientData(patient, max);
+            searchPatientData(data);
             break;
         case 3:
-            addPatient(patient, max);
+            start = actionClock();
+            addPatient(data);
+            finishAction(ACTION_ADD_PATIENT, start);
             suspend();
             break;
         case 4:
-            editPatient(patient, max);
+            start = actionClock();
+            editPatient(data);
+            finishAction(ACTION_EDIT_PATIENT, start);
             break;
         case 5:
-            removePatient(patient, max);
+            start = actionClock();
+            removePatient(data);
+            finishAction(ACTION_REMOVE_PATIENT, start);
             suspend();
             break;
         }
+
+        // The command's changes reach the journal (or the image) together
+        commitJournal(data);
+        syncClinicImage(data);
+
+        // Squeeze out a little of what deletes left behind between commands
+        compactClinicData(data, STORE_COMPACT_BUDGET);
     } while (selection);
 }
 
-// Menu: Patient edit
-void menuPatientEdit(struct Patient* patient)
+// Menu: Patient edit (keeps the phone index current when the phone changes)
+void menuPatientEdit(struct ClinicData* data, int index)
 {
     int selection;
 
+    unsigned int ref;
+
+    char name[NAME_LEN + 1];
+    char number[PHONE_LEN + 1];
+
+    struct Phone phone;
+    struct Patient patient;
+
+    readPatient(data, index, &patient);
+
     do {
         printf("Edit Patient (%05d)\n"
                "=========================\n"
                "1) NAME : %s\n"
-               "2) PHONE: ", patient->patientNumber, patient->name);
+               "2) PHONE: ", patient.patientNumber, patientName(data, &patient));
         
-        displayFormattedPhone(patient->phone.number);
+        phoneNumber(&patient.phone, number);
+        displayFormattedPhone(number);
         
         printf("\n"
                "-------------------------\n"
@@ -183,14 +378,43 @@ void menuPatientEdit(struct Patient* patient)
         if (selection == 1)
         {
             printf("Name  : ");
-            inputCString(patient->name, 1, NAME_LEN);
+            inputCString(name, 1, NAME_LEN);
             putchar('\n');
-            printf("Patient record updated!\n\n");
+
+            ref = internName(data, name);
+
+            if (ref)
+            {
+                patient.name = ref;
+                writePatient(data, index, &patient);
+                journalPatient(data, &patient);
+                printf("Patient record updated!\n\n");
+            }
+            else
+            {
+                printf("ERROR: Out of memory, patient record not updated!\n\n");
+            }
         }
         else if (selection == 2)
         {
-            inputPhoneData(&patient->phone);
-            printf("Patient record updated!\n\n");
+            phone = patient.phone;
+            inputPhoneData(&patient.phone);
+
+            removePhoneSlot(&data->phoneIndex, phoneNumberKey(&phone), index);
+
+            if (insertPhoneSlot(&data->phoneIndex, phoneNumberKey(&patient.phone), index))
+            {
+                writePatient(data, index, &patient);
+                journalPatient(data, &patient);
+                printf("Patient record updated!\n\n");
+            }
+            else
+            {
+                // The old number goes back where it was removed from
+                patient.phone = phone;
+                insertPhoneSlot(&data->phoneIndex, phoneNumberKey(&patient.phone), index);
+                printf("ERROR: Out of memory, patient record not updated!\n\n");
+            }
         }
 
     } while (selection);
@@ -201,6 +425,8 @@ void menuAppointment(struct ClinicData* data)
 {
     int selection;
 
+    long long start;
+
     do {
         printf("Appointment Management\n"
                "==============================\n"
@@ -217,61 +443,80 @@ void menuAppointment(struct ClinicData* data)
         switch (selection)
         {
         case 1:
+            start = actionClock();
             viewAllAppointments(data);
+            finishAction(ACTION_VIEW_APPOINTMENTS, start);
             suspend();
             break;
         case 2:
+            start = actionClock();
             viewAppointmentSchedule(data);
+            finishAction(ACTION_VIEW_SCHEDULE, start);
             suspend();
             break;
         case 3:
-            addAppointment(data->appointments, data->maxAppointments,
-                           data->patients, data->maxPatient);
+            start = actionClock();
+            addAppointment(data);
+            finishAction(ACTION_ADD_APPOINTMENT, start);
             suspend();
             break;
         case 4:
-            removeAppointment(data->appointments, data->maxAppointments,
-                              data->patients, data->maxPatient);
+            start = actionClock();
+            removeAppointment(data);
+            finishAction(ACTION_REMOVE_APPOINTMENT, start);
             suspend();
             break;
         }
+
+        // The command's changes reach the journal (or the image) together
+        commitJournal(data);
+        syncClinicImage(data);
+
+        // Squeeze out a little of what deletes left behind between commands
+        compactClinicData(data, STORE_COMPACT_BUDGET);
     } while (selection);
 }
 
 // Display's all patient data in the FMT_FORM | FMT_TABLE format
-void displayAllPatients(const struct Patient patient[], int max, int fmt)
+void displayAllPatients(const struct ClinicData* data, int fmt)
 {
     int i, records;
 
+    struct Patient patient;
+
+    openReport(&screen, stdout);
+
     if (fmt == FMT_TABLE)
     {
-        displayPatientTableHeader();
+        renderPatientTableHeader(&screen);
     }
 
     records = 0;
 
-    for (i = 0; i < max; i++)
+    // Only the patient number is read to skip the empty slots
+    for (i = nextPatientSlot(data, 0); i != -1; i = nextPatientSlot(data, i + 1))
     {
-        if (patient[i].patientNumber)
-        {
-            displayPatientData(&patient[i], fmt);
-            records++;
-        }
+        readPatient(data, i, &patient);
+        renderPatientData(&screen, data, &patient, fmt);
+        records++;
     }
 
     if (!records)
     {
-        putchar('\n');
-        printf("*** No records found ***\n");
+        reportText(&screen, "\n*** No records found ***\n");
     }
-    putchar('\n');
+    reportChar(&screen, '\n');
+
+    flushReport(&screen);
 }
 
 // Search for a patient record based on patient number or phone number
-void searchPatientData(const struct Patient patient[], int max)
+void searchPatientData(const struct ClinicData* data)
 {
     int selection;
 
+    long long start;
+
     do
     {
         printf("Search Options\n"
@@ -289,49 +534,58 @@ void searchPatientData(const struct Patient patient[], int max)
         switch (selection)
         {
         case 1:
-            searchPatientByPatientNumber(patient, max);
+            start = actionClock();
+            searchPatientByPatientNumber(data);
+            finishAction(ACTION_SEARCH_BY_NUMBER, start);
             suspend();
             break;
         case 2:
-            searchPatientByPhoneNumber(patient, max);
+            start = actionClock();
+            searchPatientByPhoneNumber(data);
+            finishAction(ACTION_SEARCH_BY_PHONE, start);
             suspend();
             break;
         }
     } while (selection);
 }
 
-// Add a new patient record to the patient array
-void addPatient(struct Patient patient[], int max)
+// Add a new patient record to the patient table
+void addPatient(struct ClinicData* data)
 {
-    int i, index, found;
+    int index, number;
 
-    found = 0;
+    struct PatientEntry entry = { 0 };
 
-    for (i = 0; i < max && !found; i++)
-    {
-        if (!patient[i].patientNumber)
-        {
-            index = i;
-            found = 1;
-        }
-    }
+    // The patient number is taken first: it may rescan the table, which
+    // must not see the slot handed out below as a patient yet
+    number = nextPatientNumber(data);
 
-    if (!found)
+    // Re-uses an emptied slot before growing the table
+    index = allocPatientSlot(data);
+
+    if (index == -1)
     {
         printf("ERROR: Patient listing is FULL!\n\n");
     }
     else
     {
-        patient[index].patientNumber = nextPatientNumber(patient, max);
+        entry.patientNumber = number;
 
-        inputPatient(&patient[index]);
+        inputPatient(&entry);
 
-        printf("*** New patient record added ***\n\n");
+        if (storeNewPatient(data, index, &entry))
+        {
+            printf("*** New patient record added ***\n\n");
+        }
+        else
+        {
+            printf("ERROR: Out of memory, patient record not added!\n\n");
+        }
     }
 }
 
-// Edit a patient record from the patient array
-void editPatient(struct Patient patient[], int max)
+// Edit a patient record from the patient table
+void editPatient(struct ClinicData* data)
 {
     int num, index;
 
@@ -340,11 +594,11 @@ void editPatient(struct Patient patient[], int max)
     num = inputIntPositive();
     putchar('\n');
 
-    index = findPatientIndexByPatientNum(num, patient, max);
+    index = findPatientIndexByPatientNum(num, data);
 
     if (index >= 0 && num > 0)
     {
-        menuPatientEdit(&patient[index]);
+        menuPatientEdit(data, index);
     }
     else
     {
@@ -352,25 +606,27 @@ void editPatient(struct Patient patient[], int max)
     }
 }
 
-// Remove a patient record from the patient array
-void removePatient(struct Patient patient[], int max)
+// Remove a patient record from the patient table
+void removePatient(struct ClinicData* data)
 {
     int num, index;
 
     char input;
 
-    struct Patient empty = { 0 };
+    struct Patient patient;
 
     printf("Enter the patient number: ");
 
     num = inputIntPositive();
     putchar('\n');
 
-    index = findPatientIndexByPatientNum(num, patient, max);
+    index = findPatientIndexByPatientNum(num, data);
 
     if (index >= 0 && num > 0)
     {
-        displayPatientData(&patient[index], FMT_FORM);
+        readPatient(data, index, &patient);
+
+        displayPatientData(data, &patient, FMT_FORM);
         putchar('\n');
         printf("Are you sure you want to remove this patient record? (y/n): ");
 
@@ -378,7 +634,7 @@ void removePatient(struct Patient patient[], int max)
 
         if (input == 'y')
         {
-            patient[index] = empty;
+            deletePatient(data, index);
             printf("Patient record has been removed!\n");
         }
         else
@@ -396,154 +652,175 @@ void removePatient(struct Patient patient[], int max)
 // View ALL scheduled appointments
 void viewAllAppointments(struct ClinicData* data)
 {
-    int i, j;
+    unsigned long long start = statStart(STAT_VIEW_APPOINTMENTS);
 
-    displayScheduleTableHeader(NULL, 1);
+    traceBegin(__func__);
 
-    for (i = 0; i < data->maxAppointments; i++)
-    {
-        for (j = 0; j < data->maxPatient; j++)
-        {
-            if (data->appointments[i].patientNumber == data->patients[j].patientNumber)
-            {
-                displayScheduleData(&data->patients[j], &data->appointments[i], 1);
-            }
-        }
-    }
-    putchar('\n');
+    openReport(&screen, stdout);
+
+    renderScheduleTableHeader(&screen, NULL, 1);
+
+    renderScheduleRange(&screen, data, firstAppointmentIndex(data), data->appointments.count, 1);
+
+    reportChar(&screen, '\n');
+
+    flushReport(&screen);
+
+    traceEnd(__func__);
+
+    finishStat(STAT_VIEW_APPOINTMENTS, start, data->appointments.count);
 }
 
 
 // View appointment schedule for the user input date
 void viewAppointmentSchedule(struct ClinicData* data)
 {
-    int i, j, tableIdx;
-    
-    struct Date tempDate = { 0 };
+    int count;
+
+    int* positions = NULL;
+
+    unsigned int dayKey;
 
-    inputYearMonthDay(&tempDate);
+    unsigned long long start;
+
+    struct Date date = { 0 };
+
+    inputYearMonthDay(&date);
+    dayKey = appointmentDayKey(&date);
     putchar('\n');
 
-    tableIdx = -1;
+    // Timed once the date has been typed
+    start = statStart(STAT_VIEW_SCHEDULE);
+    traceBegin(__func__);
 
-    for (i = 0; i < data->maxAppointments; i++)
+    // The day index says how many records the day has, so the scan of the
+    // day's keys can fill a list of exactly that size
+    count = findDayCount(&data->dayIndex, dateToDayNumber(&date));
+
+    if (count > 0 && (positions = malloc(count * sizeof(int))) == NULL)
     {
-        if (compareDate(&tempDate, &data->appointments[i].date) == 0)
-        {
-            tableIdx = i;
-        }
+        printf("ERROR: Out of memory, appointments not listed!\n\n");
     }
-
-    if (tableIdx > -1)
+    else if (count > 0)
     {
-        displayScheduleTableHeader(&data->appointments[tableIdx].date, 0);
+        count = filterAppointmentsByKey(data, dayKey, dayKey | KEY_SLOT_MASK, positions,
+                                        count);
 
-        for (i = 0; i < data->maxAppointments; i++)
-        {
-            if (compareDate(&tempDate, &data->appointments[i].date) == 0)
-            {
-                for (j = 0; j < data->maxPatient && data->patients[j].patientNumber > 0; j++)
-                {
-                    if (data->appointments[i].patientNumber == data->patients[j].patientNumber)
-                    {
-                        displayScheduleData(&data->patients[j], &data->appointments[i], 0);
-                    }
-                }
-            }
-        }
-        putchar('\n');
+        openReport(&screen, stdout);
+
+        renderScheduleTableHeader(&screen, &date, 0);
+
+        renderSchedulePositions(&screen, data, positions, count, 0);
+
+        reportChar(&screen, '\n');
+
+        flushReport(&screen);
     }
     else
     {
         printf("No appointments found.\n\n");
     }
+
+    free(positions);
+
+    traceEnd(__func__);
+
+    finishStat(STAT_VIEW_SCHEDULE, start, count > 0 ? count : 0);
 }
 
 
-// Add an appointment record to the appointment array
-void addAppointment(struct Appointment appoints[], int maxAppoints,
-    struct Patient patients[], int maxPatients)
+// Add an appointment record to the appointment table
+void addAppointment(struct ClinicData* data)
 {
-    int i, index, next, validTime;
+    int i, index, validTime, suggested;
 
+    unsigned int keys[SUGGESTED_SLOTS];
+
+    struct Date date = { 0 };
+    struct Time time = { 0 };
     struct Appointment temp = { 0 };
+    struct Appointment offered = { 0 };
 
-    next = -1;
+    printf("Patient Number: ");
+    temp.patientNumber = inputIntPositive();
 
-    for (i = 0; (i < maxAppoints) & (next == -1); i++)
-    {
-        if (!(appoints[i].patientNumber > 0))
-        {
-            next = i;
-        }
-    }
+    index = findPatientIndexByPatientNum(temp.patientNumber, data);
 
-    if (next < 0)
+    if (index == -1)
     {
-        printf("ERROR: Appointment slots are full!\n\n");
+        printf("ERROR: Patient record not found!\n\n");
     }
     else
     {
-        printf("Patient Number: ");
-        temp.patientNumber = inputIntPositive();
+        do
+        {
+            validTime = 1;
 
-        index = findPatientIndexByPatientNum(temp.patientNumber, patients, maxPatients);
+            inputYearMonthDay(&date);
+            inputHourMin(&time);
+            temp.key = appointmentKey(&date, &time);
 
-        if (index == -1)
-        {
-            printf("ERROR: Patient record not found!\n\n");
-        }
-        else
-        {
-            do
+            if (isSlotTaken(data, temp.key))
             {
-                validTime = 1;
+                validTime = 0;
+            }
 
-                inputYearMonthDay(&temp.date);
-                inputHourMin(&temp.time);
+            putchar('\n');
 
-                for (i = 0; i < maxAppoints; i++)
-                {
-                    if (compareDateTime(&temp, &appoints[i]) == 0)
-                    {
-                        validTime = 0;
-                    }
-                }
+            if (!validTime)
+            {
+                printf("ERROR: Appointment timeslot is not available!\n");
 
-                putchar('\n');
+                // Offer the next free times so the next guess can succeed
+                suggested = findFreeSlots(data, temp.key, -1, keys, SUGGESTED_SLOTS);
 
-                if (!validTime)
-                {
-                    printf("ERROR: Appointment timeslot is not available!\n\n");
-                }
-                else
+                if (suggested)
                 {
-                    appoints[next] = temp;
+                    printf("Next available:");
 
-                    sortAppointments(appoints, maxAppoints);
+                    for (i = 0; i < suggested; i++)
+                    {
+                        offered.key = keys[i];
+                        appointmentDate(&offered, &date);
+                        appointmentTime(&offered, &time);
 
-                    printf("*** Appointment scheduled! ***\n\n");
+                        printf("%s %04d-%02d-%02d %02d:%02d", i ? "," : "", date.year,
+                               date.month, date.day, time.hour, time.min);
+                    }
+                    putchar('\n');
                 }
-            } while (!validTime);
-        }
-    }   
+                putchar('\n');
+            }
+            else if (insertAppointment(data, &temp) >= 0)
+            {
+                journalAppointment(data, &temp);
+                printf("*** Appointment scheduled! ***\n\n");
+            }
+            else
+            {
+                printf("ERROR: Appointment slots are full!\n\n");
+            }
+        } while (!validTime);
+    }
 }
 
 
-// Remove an appointment record from the appointment array
-void removeAppointment(struct Appointment appoints[], int maxAppoints,
-    struct Patient patients[], int maxPatients)
+// Remove an appointment record from the appointment table
+void removeAppointment(struct ClinicData* data)
 {
     int i, index, valid;
 
     char input;
 
-    struct Appointment temp = { 0 }, empty = { 0 };
+    struct Date date = { 0 };
+    struct Appointment temp = { 0 };
+    struct Appointment removed;
+    struct Patient patient;
 
     printf("Patient Number: ");
     temp.patientNumber = inputIntPositive();
 
-    index = findPatientIndexByPatientNum(temp.patientNumber, patients, maxPatients);
+    index = findPatientIndexByPatientNum(temp.patientNumber, data);
 
     if (index == -1)
     {
@@ -551,16 +828,22 @@ void removeAppointment(struct Appointment appoints[], int maxAppoints,
     }
     else
     {
-        inputYearMonthDay(&temp.date);
+        inputYearMonthDay(&date);
+        temp.key = appointmentDayKey(&date);
         putchar('\n');
 
         valid = 0;
 
-        for (i = 0; i < maxAppoints; i++)
+        // The date's appointments are contiguous, starting at its first slot
+        i = findAppointmentIndex(data, &temp);
+
+        while (i != -1 &&
+               appointmentKeyAt(data, i) >> KEY_DATE_SHIFT == temp.key >> KEY_DATE_SHIFT)
         {
-            if (temp.patientNumber == appoints[i].patientNumber && compareDate(&temp.date, &appoints[i].date) == 0)
+            if (temp.patientNumber == appointmentPatientAt(data, i))
             {
-                displayPatientData(&patients[index], FMT_FORM);
+                readPatient(data, index, &patient);
+                displayPatientData(data, &patient, FMT_FORM);
                 printf("Are you sure you want to remove this appointment (y,n): ");
 
                 input = inputCharOption("yn");
@@ -569,9 +852,9 @@ void removeAppointment(struct Appointment appoints[], int maxAppoints,
 
                 if (input == 'y')
                 {
-                    appoints[i] = empty;
-
-                    sortAppointments(appoints, maxAppoints);
+                    readAppointment(data, i, &removed);
+                    journalAppointmentRemoval(data, &removed);
+                    i = deleteAppointment(data, i);
 
                     putchar('\n');
                     printf("Appointment record has been removed!\n\n");
@@ -579,8 +862,13 @@ void removeAppointment(struct Appointment appoints[], int maxAppoints,
                 else
                 {
                     printf("Operation aborted.\n\n");
+                    i = nextAppointmentIndex(data, i);
                 }
             }
+            else
+            {
+                i = nextAppointmentIndex(data, i);
+            }
         }
 
         if (!valid)
@@ -596,20 +884,23 @@ void removeAppointment(struct Appointment appoints[], int maxAppoints,
 //////////////////////////////////////
 
 // Search and display patient record by patient number (form)
-void searchPatientByPatientNumber(const struct Patient patient[], int max)
+void searchPatientByPatientNumber(const struct ClinicData* data)
 {
     int num, found;
 
+    struct Patient patient;
+
     printf("Search by patient number: ");
 
     num = inputIntPositive();
     putchar('\n');
 
-    found = findPatientIndexByPatientNum(num, patient, max);
+    found = findPatientIndexByPatientNum(num, data);
 
     if (found > -1 && num > 0)
     {
-        displayPatientData(&patient[found], FMT_FORM);
+        readPatient(data, found, &patient);
+        displayPatientData(data, &patient, FMT_FORM);
     }
     else
     {
@@ -619,26 +910,38 @@ void searchPatientByPatientNumber(const struct Patient patient[], int max)
 }
 
 // Search and display patient records by phone number (tabular)
-void searchPatientByPhoneNumber(const struct Patient patient[], int max)
+void searchPatientByPhoneNumber(const struct ClinicData* data)
 {
     int i, found;
 
+    long long key;
+
     char num[PHONE_LEN + 1] = { 0 };
 
+    struct Patient patient;
+
     printf("Search by phone number: ");
 
     inputCString(num, PHONE_LEN, PHONE_LEN);
     putchar('\n');
 
-    displayPatientTableHeader();
+    openReport(&screen, stdout);
+
+    renderPatientTableHeader(&screen);
 
     found = 0;
+    key = phoneKey(num);
 
-    for (i = 0; i < max; i++)
+    // Walk only the patients filed under this number (in slot order); a
+    // typed number that is not all digits has a key no stored phone has
+    for (i = findPhoneSlot(&data->phoneIndex, key); i != -1;
+         i = nextPhoneSlot(&data->phoneIndex, i))
     {
-        if (strcmp(patient[i].phone.number, num) == 0)
+        readPatient(data, i, &patient);
+
+        if (phoneNumberKey(&patient.phone) == key)
         {
-            displayPatientData(&patient[i], FMT_TABLE);
+            renderPatientData(&screen, data, &patient, FMT_TABLE);
 
             found++;
         }
@@ -646,88 +949,254 @@ void searchPatientByPhoneNumber(const struct Patient patient[], int max)
 
     if (!found)
     {
-        putchar('\n');
-        printf("*** No records found ***\n");
+        reportText(&screen, "\n*** No records found ***\n");
     }
-    putchar('\n');
+    reportChar(&screen, '\n');
+
+    flushReport(&screen);
 }
 
 // Get the next highest patient number
-int nextPatientNumber(const struct Patient patient[], int max)
+int nextPatientNumber(struct ClinicData* data)
 {
-    int i, highest;
+    return highestPatientNumber(data) + 1;
+}
 
-    highest = 0;
+// Find the patient table slot by patient number (returns -1 if not found)
+int findPatientIndexByPatientNum(int patientNumber,
+    const struct ClinicData* data)
+{
+    int index;
 
-    for (i = 0; i < max; i++)
-    {
-        if (patient[i].patientNumber > highest)
-        {
-            highest = patient[i].patientNumber;
-        }
-    }
+    unsigned long long start = statStart(STAT_FIND_PATIENT);
+
+    index = findPatientSlot(&data->patientIndex, patientNumber);
+
+    finishStat(STAT_FIND_PATIENT, start, index != -1);
 
-    return highest + 1;
+    return index;
 }
 
-// Find the patient array index by patient number (returns -1 if not found)
-int findPatientIndexByPatientNum(int patientNumber,
-    const struct Patient patient[], int max)
+// qsort callback ordering appointments by date and time
+static int compareAppointments(const void* apt1, const void* apt2)
 {
-    int i, index;
+    return compareDateTime(apt1, apt2);
+}
 
-    index = -1;
+// Store a new patient in an allocated slot, filing it in the patient
+// number and phone indexes and the journal (returns 0 and frees the slot
+// if out of memory)
+int storeNewPatient(struct ClinicData* data, int index, const struct PatientEntry* entry)
+{
+    int result;
+
+    struct Patient patient = { 0 };
+
+    traceBegin(__func__);
+
+    // The slot only holds a patient once the name is stored
+    result = packPatient(data, entry, &patient) &&
+             insertPatientSlot(&data->patientIndex, patient.patientNumber, index) &&
+             insertPhoneSlot(&data->phoneIndex, phoneNumberKey(&patient.phone), index);
 
-    for (i = 0; i < max && index == -1; i++)
+    if (result)
     {
-        if (patient[i].patientNumber == patientNumber)
-        {
-            index = i;
-        }
+        writePatient(data, index, &patient);
+        notePatientNumber(data, patient.patientNumber);
+        journalPatient(data, &patient);
+    }
+    else
+    {
+        removePatientSlot(&data->patientIndex, entry->patientNumber);
+        clearPatientSlot(data, index);
     }
 
-    return index;
+    traceEnd(__func__);
+
+    return result;
 }
 
-// Sort appointments by date lowest to highest
-void sortAppointments(struct Appointment appoint[], int max)
+// Remove the patient in a slot from the table, its indexes and the journal
+void deletePatient(struct ClinicData* data, int index)
 {
-    int i, j, minIdx;
+    struct Patient patient;
 
-    struct Appointment temp = { 0 };
+    traceBegin(__func__);
 
-    if (appoint != NULL)
-    {
-        for (i = 0; i < max; i++)
-        {
-            minIdx = i;
+    readPatient(data, index, &patient);
 
-            for (j = i + 1; j < max; j++)
-            {
-                if (compareDateTime(&appoint[j], &appoint[minIdx]) < 0)
-                {
-                    minIdx = j;
-                }
-            }
+    removePatientSlot(&data->patientIndex, patient.patientNumber);
+    removePhoneSlot(&data->phoneIndex, phoneNumberKey(&patient.phone), index);
+    clearPatientSlot(data, index);
+    journalPatientRemoval(data, patient.patientNumber);
 
-            if (minIdx != i)
-            {
-                temp = appoint[i];
-                appoint[i] = appoint[minIdx];
-                appoint[minIdx] = temp;
-            }
-        }
-    }
+    traceEnd(__func__);
 }
 
-// Compares two dates and return 0 if the same, -1 if apt1 < apt2 and 1 if apt1 > apt2
-int compareDate(const struct Date* dt1, const struct Date* dt2)
+// Sort appointments by date lowest to highest
+void sortAppointments(struct Appointment appoint[], int max)
 {
-    int result = 0;
+    unsigned long long start = statStart(STAT_SORT_APPOINTMENTS);
 
-    int date1, date2;
+    traceBegin(__func__);
 
-    if (dt1 != NULL && dt2 != NULL)
+    if (appoint != NULL && max > 1)
+    {
+        qsort(appoint, max, sizeof(struct Appointment), compareAppointments);
+    }
+
+    traceEnd(__func__);
+
+    finishStat(STAT_SORT_APPOINTMENTS, start, max);
+}
+
+// Insert an appointment at its sorted position and count it in the day
+// index (returns its position or -1 if out of memory)
+int insertAppointment(struct ClinicData* data, const struct Appointment* appoint)
+{
+    int pos = -1, day, slot, taken;
+
+    traceBegin(__func__);
+
+    day = (int)(appoint->key >> KEY_DATE_SHIFT);
+    slot = (int)(appoint->key & KEY_SLOT_MASK);
+    taken = findDaySlot(&data->dayIndex, day, slot);
+
+    if (addDayCount(&data->dayIndex, day, slot))
+    {
+        pos = storeAppointment(data, appoint);
+
+        if (pos == -1)
+        {
+            removeDayCount(&data->dayIndex, day);
+
+            if (!taken)
+            {
+                clearDaySlot(&data->dayIndex, day, slot);
+            }
+        }
+    }
+
+    traceEnd(__func__);
+
+    return pos;
+}
+
+// Delete the appointment at a position and uncount it from the day index
+// (returns the position of the appointment that followed it or -1)
+int deleteAppointment(struct ClinicData* data, int pos)
+{
+    int same;
+
+    struct Appointment removed = { 0 };
+
+    traceBegin(__func__);
+
+    removed.key = appointmentKeyAt(data, pos);
+    removeDayCount(&data->dayIndex, (int)(removed.key >> KEY_DATE_SHIFT));
+
+    pos = eraseAppointment(data, pos);
+
+    // Imported data can book a slot twice; it is free once the last goes
+    same = findAppointmentIndex(data, &removed);
+
+    if (same == -1 || appointmentKeyAt(data, same) != removed.key)
+    {
+        clearDaySlot(&data->dayIndex, (int)(removed.key >> KEY_DATE_SHIFT),
+                     (int)(removed.key & KEY_SLOT_MASK));
+    }
+
+    traceEnd(__func__);
+
+    return pos;
+}
+
+// Find the appointment with the same patient, date and time (returns -1 if
+// there is none)
+int findExactAppointment(const struct ClinicData* data, const struct Appointment* appoint)
+{
+    int pos, found = -1;
+
+    for (pos = findAppointmentIndex(data, appoint);
+         pos != -1 && found == -1 && appointmentKeyAt(data, pos) == appoint->key;
+         pos = nextAppointmentIndex(data, pos))
+    {
+        if (appointmentPatientAt(data, pos) == appoint->patientNumber)
+        {
+            found = pos;
+        }
+    }
+
+    return found;
+}
+
+// Check the day index for a booking at an appointment key's date and time
+// (returns 1 if the slot is taken)
+int isSlotTaken(const struct ClinicData* data, unsigned int key)
+{
+    int taken;
+
+    unsigned long long start = statStart(STAT_SLOT_CHECK);
+
+    // One bit of the day's slot bitmap
+    taken = findDaySlot(&data->dayIndex, (int)(key >> KEY_DATE_SHIFT),
+                        (int)(key & KEY_SLOT_MASK));
+
+    finishStat(STAT_SLOT_CHECK, start, taken);
+
+    return taken;
+}
+
+// Fill "keys" with the first "max" free appointment slots at or after the
+// key "from" and on or before day "lastDay" (-1 for no limit)
+// (returns # of slots found)
+int findFreeSlots(const struct ClinicData* data, unsigned int from, int lastDay,
+                  unsigned int keys[], int max)
+{
+    int day, slot, found = 0;
+
+    struct Date last = { LAST_YEAR, DEC, 31 };
+
+    traceBegin(__func__);
+
+    if (lastDay == -1 || lastDay > dateToDayNumber(&last))
+    {
+        lastDay = dateToDayNumber(&last);
+    }
+
+    day = (int)(from >> KEY_DATE_SHIFT);
+    slot = (int)(from & KEY_SLOT_MASK);
+
+    // A full day costs one index probe and one word test
+    while (day <= lastDay && found < max)
+    {
+        slot = findDayFreeSlot(&data->dayIndex, day, slot, APPOINT_SLOTS);
+
+        if (slot == -1)
+        {
+            day++;
+            slot = 0;
+        }
+        else
+        {
+            keys[found++] = (unsigned int)day << KEY_DATE_SHIFT | (unsigned int)slot;
+            slot++;
+        }
+    }
+
+    traceEnd(__func__);
+
+    return found;
+}
+
+// Compares two dates and return 0 if the same, -1 if apt1 < apt2 and 1 if apt1 > apt2
+int compareDate(const struct Date* dt1, const struct Date* dt2)
+{
+    int result = 0;
+
+    int date1, date2;
+
+    if (dt1 != NULL && dt2 != NULL)
     {
         date1 = dt1->year * 10000 + dt1->month * 100 + dt1->day;
         date2 = dt2->year * 10000 + dt2->month * 100 + dt2->day;
@@ -748,51 +1217,216 @@ int compareDate(const struct Date* dt1, const struct Date* dt2)
     return result;
 }
 
+// Convert a date to a day number (days since 1970-01-01, negative before)
+int dateToDayNumber(const struct Date* date)
+{
+    int year, month, era, yearOfEra, dayOfYear, dayOfEra;
+
+    // Shift the year to start in March so the leap day is the last day
+    year = date->year - (date->month <= 2);
+    month = date->month;
+    era = (year >= 0 ? year : year - 399) / 400;
+    yearOfEra = year - era * 400;
+    dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + date->day - 1;
+    dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// Convert a day number (days since 1970-01-01) back to a date
+void dayNumberToDate(int dayNumber, struct Date* date)
+{
+    int days, era, dayOfEra, yearOfEra, dayOfYear, month;
+
+    // The inverse of dateToDayNumber, with years starting in March
+    days = dayNumber + 719468;
+    era = (days >= 0 ? days : days - 146096) / 146097;
+    dayOfEra = days - era * 146097;
+    yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    month = (5 * dayOfYear + 2) / 153;
+
+    date->day = dayOfYear - (153 * month + 2) / 5 + 1;
+    date->month = month < 10 ? month + 3 : month - 9;
+    date->year = yearOfEra + era * 400 + (date->month <= 2);
+}
+
+// Number of days in a month of a year
+int daysInMonth(int year, int month)
+{
+    int days = 31;
+
+    if (month == 2)
+    {
+        days = (year % 4 == 0 && year % 100 != 0) || (year % 400 == 0) ? 29 : 28;
+    }
+    else if (month == 4 || month == 6 || month == 9 || month == 11)
+    {
+        days = 30;
+    }
+
+    return days;
+}
+
+// Pack a date (FIRST_YEAR to LAST_YEAR) and a slot time into an appointment key
+unsigned int appointmentKey(const struct Date* date, const struct Time* time)
+{
+    int slot = (time->hour * 60 + time->min - (FIRST_HOUR * 60 + FIRST_MIN)) / APPOINT_LENGTH;
+
+    return appointmentDayKey(date) | (unsigned int)slot;
+}
+
+// Key of the first slot on a date (FIRST_YEAR to LAST_YEAR)
+unsigned int appointmentDayKey(const struct Date* date)
+{
+    return (unsigned int)dateToDayNumber(date) << KEY_DATE_SHIFT;
+}
+
+// Unpack the date of an appointment
+void appointmentDate(const struct Appointment* appoint, struct Date* date)
+{
+    dayNumberToDate((int)(appoint->key >> KEY_DATE_SHIFT), date);
+}
+
+// Unpack the time of an appointment
+void appointmentTime(const struct Appointment* appoint, struct Time* time)
+{
+    int minutes = FIRST_HOUR * 60 + FIRST_MIN +
+                  (int)(appoint->key & KEY_SLOT_MASK) * APPOINT_LENGTH;
+
+    time->hour = minutes / 60;
+    time->min = minutes % 60;
+}
+
 // Compares two appointments and return 0 if the same, -1 if apt1 < apt2 and 1 if apt1 > apt2
+// (by their ordering keys)
 int compareDateTime(const struct Appointment* apt1, const struct Appointment* apt2)
 {
     int result = 0;
 
-    int date1, date2, time1, time2;
-
     if (apt1 != NULL && apt2 != NULL)
     {
-        date1 = apt1->date.year * 10000 + apt1->date.month * 100 + apt1->date.day;
-        date2 = apt2->date.year * 10000 + apt2->date.month * 100 + apt2->date.day;
-        time1 = apt1->time.hour * 60 + apt1->time.min;
-        time2 = apt2->time.hour * 60 + apt2->time.min;
+        result = (apt1->key > apt2->key) - (apt1->key < apt2->key);
+    }
 
-        if (!((date1 == date2) && (time1 == time2)))
+    return result;
+}
+
+
+// Pack a contact type and a number (empty or PHONE_LEN digits) into a phone
+// (returns 0 and leaves the phone alone if the number is not valid)
+int setPhone(struct Phone* phone, enum PhoneType type, const char* number)
+{
+    int i, result = 1;
+
+    long long key = 0;
+
+    for (i = 0; number[i] && result; i++)
+    {
+        if (number[i] >= '0' && number[i] <= '9')
         {
-            if (date1 < date2)
-            {
-                result = -1;
-            }
-            else if (date1 > date2)
-            {
-                result = 1;
-            }
-            else if (time1 < time2)
-            {
-                result = -1;
-            }
-            else
-            {
-                result = 1;
-            }
+            key = key * 10 + (number[i] - '0');
         }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    if (result && (i == 0 || i == PHONE_LEN))
+    {
+        // Offset by one like phoneKey so "0000000000" is not "no number"
+        key = i ? key + 1 : 0;
+        phone->packed = (unsigned long long)key << PHONE_TYPE_BITS | (unsigned int)type;
+    }
+    else
+    {
+        result = 0;
     }
 
     return result;
 }
 
+// Contact type of a phone
+enum PhoneType phoneType(const struct Phone* phone)
+{
+    return (enum PhoneType)(phone->packed & ((1u << PHONE_TYPE_BITS) - 1));
+}
+
+// Description of a phone's contact type ("CELL", "HOME", "WORK" or "TBD")
+const char* phoneDescription(const struct Phone* phone)
+{
+    return phoneDescriptions[phoneType(phone)];
+}
+
+// Contact type with a description (returns -1 if there is none)
+int phoneTypeByDescription(const char* description)
+{
+    int i, type = -1;
+
+    for (i = PHONE_CELL; i <= PHONE_TBD && type == -1; i++)
+    {
+        if (strcmp(phoneDescriptions[i], description) == 0)
+        {
+            type = i;
+        }
+    }
+
+    return type;
+}
+
+// Spell out a phone's number into PHONE_LEN + 1 chars ("" for no number)
+void phoneNumber(const struct Phone* phone, char* number)
+{
+    int i;
+
+    long long key = phoneNumberKey(phone);
+
+    if (key)
+    {
+        // Digits from the right, keeping leading zeros
+        for (i = PHONE_LEN - 1, key--; i >= 0; i--, key /= 10)
+        {
+            number[i] = (char)('0' + key % 10);
+        }
+        number[PHONE_LEN] = '\0';
+    }
+    else
+    {
+        number[0] = '\0';
+    }
+}
+
+// Index key of a phone's number (the same as phoneKey of its digits)
+long long phoneNumberKey(const struct Phone* phone)
+{
+    return (long long)(phone->packed >> PHONE_TYPE_BITS);
+}
+
+// Store a patient entry's fields in a patient record, interning the name
+// (returns 0 if out of memory)
+int packPatient(struct ClinicData* data, const struct PatientEntry* entry,
+                struct Patient* patient)
+{
+    unsigned int ref = internName(data, entry->name);
+
+    if (ref)
+    {
+        patient->patientNumber = entry->patientNumber;
+        patient->name = ref;
+        patient->phone = entry->phone;
+    }
+
+    return ref != 0;
+}
+
 
 //////////////////////////////////////
 // USER INPUT FUNCTIONS
 //////////////////////////////////////
 
 // Get user input for a new patient record
-void inputPatient(struct Patient* patient)
+void inputPatient(struct PatientEntry* patient)
 {
     printf("Patient Data Input\n"
         "------------------\n"
@@ -810,6 +1444,8 @@ void inputPhoneData(struct Phone* phone)
 {
     int input;
 
+    char number[PHONE_LEN + 1] = { 0 };
+
     printf("Phone Information\n"
         "-----------------\n"
         "How will the patient like to be contacted?\n"
@@ -819,73 +1455,46 @@ void inputPhoneData(struct Phone* phone)
         "4. TBD\n"
         "Selection: ");
 
+    // The menu lists the contact types in enum PhoneType order
     input = inputIntRange(1, 4);
-
-    switch (input)
-    {
-    case 1:
-        strcpy(phone->description, "CELL");
-        break;
-    case 2:
-        strcpy(phone->description, "HOME");
-        break;
-    case 3:
-        strcpy(phone->description, "WORK");
-        break;
-    case 4:
-        strcpy(phone->description, "TBD");
-        break;
-    }
+    setPhone(phone, (enum PhoneType)(input - 1), "");
     putchar('\n');
 
     if (input != 4)
     {
         printf("Contact: %s\n"
-            "Number : ", phone->description);
+            "Number : ", phoneDescription(phone));
 
-        inputCString(phone->number, PHONE_LEN, PHONE_LEN);
+        // Only digits can be packed into the phone
+        inputCString(number, PHONE_LEN, PHONE_LEN);
+
+        while (!setPhone(phone, phoneType(phone), number))
+        {
+            printf("ERROR: Phone number must be all digits: ");
+            inputCString(number, PHONE_LEN, PHONE_LEN);
+        }
         putchar('\n');
     }
-    else
-    {
-        strcpy(phone->number, "\0");
-    }
 }
 
 // Get a user input for a year, month and day
 void inputYearMonthDay(struct Date* date)
 {
+    int days;
+
     if (date != NULL)
     {
+        // Appointment keys only hold the years a 16-bit day number covers
         printf("Year        : ");
-        date->year = inputIntPositive();
+        date->year = inputIntRange(FIRST_YEAR, LAST_YEAR);
 
         printf("Month (%d-%d): ", JAN, DEC);
         date->month = inputIntRange(JAN, DEC);
 
-        if (date->month == 2)
-        {
-            if ((date->year % 4 == 0 && date->year % 100 != 0) || (date->year % 400 == 0))
-            {
-                printf("Day (1-29)  : ");
-                date->day = inputIntRange(1, 29);
-            }
-            else
-            {
-                printf("Day (1-28)  : ");
-                date->day = inputIntRange(1, 28);
-            }
-        }
-        else if (date->month == 4 || date->month == 6 || date->month == 9 || date->month == 11)
-        {
-            printf("Day (1-30)  : ");
-            date->day = inputIntRange(1, 30);
-        }
-        else
-        {
-            printf("Day (1-31)  : ");
-            date->day = inputIntRange(1, 31);
-        }
+        days = daysInMonth(date->year, date->month);
+
+        printf("Day (1-%d)  : ", days);
+        date->day = inputIntRange(1, days);
     }
 }
 
@@ -922,62 +1531,251 @@ void inputHourMin(struct Time* time)
 // FILE FUNCTIONS
 //////////////////////////////////////
 
-// Import patient data from file into a Patient array (returns # of records read)
-int importPatients(const char* datafile, struct Patient patients[], int max)
+// Import callback: add one patient to the table and indexes (returns 0 if
+// out of memory)
+static int storeImportedPatient(void* context, const void* record)
+{
+    int slot, result = 1;
+
+    struct Patient patient;
+
+    struct ClinicData* data = context;
+    const struct PatientEntry* entry = record;
+
+    if (entry->patientNumber)
+    {
+        slot = allocPatientSlot(data);
+
+        if (slot == -1 || !packPatient(data, entry, &patient))
+        {
+            if (slot != -1)
+            {
+                clearPatientSlot(data, slot);
+            }
+
+            fprintf(stderr, "ERROR: Out of memory, patient import stopped!\n");
+            result = 0;
+        }
+        else
+        {
+            writePatient(data, slot, &patient);
+            notePatientNumber(data, entry->patientNumber);
+
+            // The first record wins when a patient number appears more than once
+            if (findPatientSlot(&data->patientIndex, entry->patientNumber) == -1)
+            {
+                insertPatientSlot(&data->patientIndex, entry->patientNumber, slot);
+            }
+            insertPhoneSlot(&data->phoneIndex, phoneNumberKey(&entry->phone), slot);
+        }
+    }
+
+    return result;
+}
+
+// Import patient data from file into the patient table and rebuild the
+// patient number and phone indexes (returns # of records read)
+int importPatients(const char* datafile, struct ClinicData* data)
+{
+    int before = data->patients.liveCount;
+
+    unsigned long long start = statStart(STAT_IMPORT_PATIENTS);
+
+    traceBegin(__func__);
+
+    freePatientIndex(&data->patientIndex);
+    freePhoneIndex(&data->phoneIndex);
+
+    importRecords(datafile, sizeof(struct PatientEntry), parsePatientLine,
+                  storeImportedPatient, data);
+
+    traceEnd(__func__);
+
+    finishStat(STAT_IMPORT_PATIENTS, start, data->patients.liveCount - before);
+
+    return data->patients.liveCount - before;
+}
+
+// Import callback: append one appointment to the scratch array (returns 0
+// if out of memory)
+static int storeImportedAppointment(void* context, const void* record)
+{
+    int size, result = 1;
+
+    struct AppointmentImport* scratch = context;
+    struct Appointment* grown;
+    const struct Appointment* appoint = record;
+
+    if (appoint->patientNumber)
+    {
+        if (scratch->count == scratch->max)
+        {
+            size = scratch->max ? scratch->max * 2 : 64;
+            grown = realloc(scratch->appoints, size * sizeof(struct Appointment));
+
+            if (grown != NULL)
+            {
+                scratch->appoints = grown;
+                scratch->max = size;
+            }
+            else
+            {
+                fprintf(stderr, "ERROR: Out of memory, appointment import stopped!\n");
+                result = 0;
+            }
+        }
+
+        if (result)
+        {
+            scratch->appoints[scratch->count++] = *appoint;
+        }
+    }
+
+    return result;
+}
+
+// Import appointment data from file into the appointment table, keeping
+// only real records, sorting them once and rebuilding the day index
+// (returns # of records read)
+int importAppointments(const char* datafile, struct ClinicData* data)
+{
+    int i, num;
+
+    unsigned int key;
+
+    unsigned long long start = statStart(STAT_IMPORT_APPOINTMENTS);
+
+    struct AppointmentImport scratch = { 0 };
+
+    traceBegin(__func__);
+
+    // The file is read into a scratch array so it can be sorted once and
+    // bulk loaded into the table
+    importRecords(datafile, sizeof(struct Appointment), parseAppointmentLine,
+                  storeImportedAppointment, &scratch);
+
+    num = scratch.count;
+
+    sortAppointments(scratch.appoints, num);
+
+    if (!loadAppointments(data, scratch.appoints, num))
+    {
+        fprintf(stderr, "ERROR: Out of memory, appointment import incomplete!\n");
+        num = data->appointments.count;
+    }
+
+    freeDayIndex(&data->dayIndex);
+
+    for (i = firstAppointmentIndex(data); i != -1; i = nextAppointmentIndex(data, i))
+    {
+        key = appointmentKeyAt(data, i);
+        addDayCount(&data->dayIndex, (int)(key >> KEY_DATE_SHIFT), (int)(key & KEY_SLOT_MASK));
+    }
+
+    free(scratch.appoints);
+
+    traceEnd(__func__);
+
+    finishStat(STAT_IMPORT_APPOINTMENTS, start, num);
+
+    return num;
+}
+
+// Write every patient to a data file in the import format
+// (returns # of records written or -1 if the file could not be written)
+int exportPatients(const char* datafile, const struct ClinicData* data)
 {
     int i, num = 0;
 
-    FILE* fp = NULL;
-    fp = fopen(datafile, "r");
+    char number[PHONE_LEN + 1];
+
+    struct Patient patient;
+
+    FILE* fp = fopen(datafile, "wb");
+
+    traceBegin(__func__);
 
     if (fp != NULL)
     {
-        for (i = 0; i < max && fscanf(fp, "%d", &patients[i].patientNumber) == 1; i++)
+        for (i = nextPatientSlot(data, 0); i != -1 && num != -1;
+             i = nextPatientSlot(data, i + 1))
         {
-            fscanf(fp, "|%[^|]|%[^|]|%[^\n]",
-                patients[i].name, patients[i].phone.description, patients[i].phone.number);
+            readPatient(data, i, &patient);
+            phoneNumber(&patient.phone, number);
 
-            if (patients[i].patientNumber)
+            if (fprintf(fp, "%d|%s|%s|%s\n", patient.patientNumber,
+                        patientName(data, &patient), phoneDescription(&patient.phone),
+                        number) < 0)
+            {
+                num = -1;
+            }
+            else
             {
                 num++;
             }
         }
 
-        fclose(fp);
-        fp = NULL;
+        if (fclose(fp) != 0)
+        {
+            num = -1;
+        }
+    }
+    else
+    {
+        num = -1;
     }
 
+    traceEnd(__func__);
+
     return num;
 }
 
-// Import appointment data from file into an Appointment array (returns # of records read)
-int importAppointments(const char* datafile, struct Appointment appoints[], int max)
+// Write every appointment to a data file in the import format, in date/time
+// order (returns # of records written or -1 if the file could not be written)
+int exportAppointments(const char* datafile, const struct ClinicData* data)
 {
     int i, num = 0;
 
-    FILE* fp = NULL;
-    fp = fopen(datafile, "r");
+    struct Appointment appoint;
+
+    struct Date date;
+    struct Time time;
+
+    FILE* fp = fopen(datafile, "wb");
+
+    traceBegin(__func__);
 
     if (fp != NULL)
     {
-        for (i = 0; i < max && fscanf(fp, "%d", &appoints[i].patientNumber) == 1; i++)
+        for (i = firstAppointmentIndex(data); i != -1 && num != -1;
+             i = nextAppointmentIndex(data, i))
         {
+            readAppointment(data, i, &appoint);
+            appointmentDate(&appoint, &date);
+            appointmentTime(&appoint, &time);
 
-            fscanf(fp, ",%d,%d,%d,%d,%d",
-                &appoints[i].date.year, &appoints[i].date.month, &appoints[i].date.day, 
-                &appoints[i].time.hour, &appoints[i].time.min);
-
-            if (appoints[i].patientNumber)
+            if (fprintf(fp, "%d,%d,%d,%d,%d,%d\n", appoint.patientNumber,
+                        date.year, date.month, date.day, time.hour, time.min) < 0)
+            {
+                num = -1;
+            }
+            else
             {
                 num++;
             }
         }
 
-        fclose(fp);
-        fp = NULL;
+        if (fclose(fp) != 0)
+        {
+            num = -1;
+        }
+    }
+    else
+    {
+        num = -1;
     }
 
-    sortAppointments(appoints, max);
+    traceEnd(__func__);
 
     return num;
 }
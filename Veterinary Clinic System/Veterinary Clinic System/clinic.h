@@ -1,6 +1,11 @@
 #ifndef CLINIC_H
 #define CLINIC_H
 
+#include "index.h"
+#include "journal.h"
+#include "report.h"
+#include "store.h"
+
 //////////////////////////////////////
 // Macros
 //////////////////////////////////////
@@ -14,6 +19,8 @@
 #define PHONE_DESC_LEN 4
 #define PHONE_LEN 10
 
+// Packed phones: bits of contact type below the number (see struct Phone)
+#define PHONE_TYPE_BITS 2
 
 // Additional macro's:
 #define JAN 1
@@ -28,19 +35,65 @@
 #define LAST_MIN 00
 #define APPOINT_LENGTH 30
 
+// Slots a clinic day offers, FIRST_HOUR:FIRST_MIN through LAST_HOUR:LAST_MIN
+#define APPOINT_SLOTS ((LAST_HOUR * 60 + LAST_MIN - (FIRST_HOUR * 60 + FIRST_MIN)) / \
+                       APPOINT_LENGTH + 1)
+
+// Free times offered when a requested slot is taken
+#define SUGGESTED_SLOTS 3
+
+// Main menu item (not listed) that shows the operation statistics and
+// writes out the trace being recorded
+#define STATS_MENU_ITEM 9
+
+// Appointment keys: the day number (days since 1970-01-01, 16 bits) above
+// the index of the APPOINT_LENGTH slot from FIRST_HOUR:FIRST_MIN (8 bits),
+// so keys order like dates and times; shifting by KEY_DATE_SHIFT leaves the day
+// and masking by KEY_SLOT_MASK the slot (below DAY_SLOTS)
+#define KEY_DATE_SHIFT 8
+#define KEY_SLOT_MASK ((1u << KEY_DATE_SHIFT) - 1)
+
+// Years a 16-bit day number covers in full
+#define FIRST_YEAR 1970
+#define LAST_YEAR 2148
+
 //////////////////////////////////////
 // Structures
 //////////////////////////////////////
 
+// Phone contact types (in the order of the contact menu)
+enum PhoneType
+{
+    PHONE_CELL,
+    PHONE_HOME,
+    PHONE_WORK,
+    PHONE_TBD
+};
+
 // Data type: Phone
+// Contact type and number packed into one integer: the number's index key
+// (see phoneKey: the digits plus one, 0 for no number) above
+// PHONE_TYPE_BITS bits of enum PhoneType; phoneDescription and phoneNumber
+// spell them out
 struct Phone
 {
-    char description[PHONE_DESC_LEN + 1];
-    char number[PHONE_LEN + 1];
+    unsigned long long packed;
 };
 
 // Data type: Patient 
+// 16 bytes: the name is a reference into the clinic's name arena, where
+// each distinct name is stored once (see patientName)
 struct Patient
+{
+    int patientNumber;
+    unsigned int name;
+    struct Phone phone;
+};
+
+// Data type: PatientEntry
+// A patient with the name spelled out, as typed in or read from a data
+// file or the journal; packPatient interns the name to store it
+struct PatientEntry
 {
     int patientNumber;
     char name[NAME_LEN + 1];
@@ -66,20 +119,27 @@ struct Date
 };
 
 // Data type: Appointment
+// Packed into 8 bytes; appointmentDate and appointmentTime unpack the key
 struct Appointment
 {
     int patientNumber;
-    struct Time time;
-    struct Date date;
+    unsigned int key;   // day number and slot (see appointmentKey)
 };
 
 // ClinicData type: Provided to student
+// Patients and appointments live in block-backed tables that grow on demand
+// (see store.h) and changes are logged to the journal when one is open
+// (see journal.h); a zeroed structure is a valid empty clinic
 struct ClinicData
 {
-    struct Patient* patients;
-    int maxPatient;
-    struct Appointment* appointments;
-    int maxAppointments;
+    struct BlockPool pool;
+    struct PatientTable patients;
+    struct AppointmentTable appointments;
+    struct NameArena names;
+    struct PatientIndex patientIndex;
+    struct PhoneIndex phoneIndex;
+    struct DayIndex dayIndex;
+    struct Journal journal;
 };
 
 
@@ -88,17 +148,42 @@ struct ClinicData
 // DISPLAY FUNCTIONS
 //////////////////////////////////////
 
+// Render the patient table header (table format)
+void renderPatientTableHeader(struct Report* report);
+
+// Render a single patient record in FMT_FORM | FMT_TABLE format
+void renderPatientData(struct Report* report, const struct ClinicData* data,
+                       const struct Patient* patient, int fmt);
+
+// Render appointment schedule headers (date-specific or all records)
+void renderScheduleTableHeader(struct Report* report, const struct Date* date, int isAllRecords);
+
+// Render a single appointment record with patient info. in tabular format
+void renderScheduleData(struct Report* report, const struct ClinicData* data,
+                        const struct Patient* patient, const struct Appointment* appoint,
+                        int includeDateField);
+
+// Render a run of appointments joined with their patient records (the
+// patient number index resolves each row, so the cost is linear in rows)
+void renderScheduleRange(struct Report* report, const struct ClinicData* data, int first,
+                         int count, int includeDateField);
+
+// Render the appointments at a list of positions joined with their
+// patient records
+void renderSchedulePositions(struct Report* report, const struct ClinicData* data,
+                             const int* positions, int count, int includeDateField);
+
 // Display's the patient table header (table format)
 void displayPatientTableHeader(void);
 
 // Displays a single patient record in FMT_FORM | FMT_TABLE format
-void displayPatientData(const struct Patient* patient, int fmt);
+void displayPatientData(const struct ClinicData* data, const struct Patient* patient, int fmt);
 
 // Display's appointment schedule headers (date-specific or all records)
 void displayScheduleTableHeader(const struct Date* date, int isAllRecords);
 
 // Display a single appointment record with patient info. in tabular format
-void displayScheduleData(const struct Patient* patient,
+void displayScheduleData(const struct ClinicData* data, const struct Patient* patient,
                          const struct Appointment* appoint,
                          int includeDateField);
 
@@ -111,28 +196,28 @@ void displayScheduleData(const struct Patient* patient,
 void menuMain(struct ClinicData* data);
 
 // Menu: Patient Management
-void menuPatient(struct Patient patient[], int max);
+void menuPatient(struct ClinicData* data);
 
-// Menu: Patient edit
-void menuPatientEdit(struct Patient* patient);
+// Menu: Patient edit (keeps the phone index current when the phone changes)
+void menuPatientEdit(struct ClinicData* data, int index);
 
 // Menu: Appointment Management
 void menuAppointment(struct ClinicData* data);
 
 // Display's all patient data in the FMT_FORM | FMT_TABLE format
-void displayAllPatients(const struct Patient patient[], int max, int fmt);
+void displayAllPatients(const struct ClinicData* data, int fmt);
 
 // Search for a patient record based on patient number or phone number
-void searchPatientData(const struct Patient patient[], int max);
+void searchPatientData(const struct ClinicData* data);
 
-// Add a new patient record to the patient array
-void addPatient(struct Patient patient[], int max);
+// Add a new patient record to the patient table
+void addPatient(struct ClinicData* data);
 
-// Edit a patient record from the patient array
-void editPatient(struct Patient patient[], int max);
+// Edit a patient record from the patient table
+void editPatient(struct ClinicData* data);
 
-// Remove a patient record from the patient array
-void removePatient(struct Patient patient[], int max);
+// Remove a patient record from the patient table
+void removePatient(struct ClinicData* data);
 
 // View ALL scheduled appointments
 void viewAllAppointments(struct ClinicData* data);
@@ -140,13 +225,11 @@ void viewAllAppointments(struct ClinicData* data);
 // View appointment schedule for the user input date
 void viewAppointmentSchedule(struct ClinicData* data);
 
-// Add an appointment record to the appointment array
-void addAppointment(struct Appointment appoints[], int maxAppoints,
-    struct Patient patients[], int maxPatients);
+// Add an appointment record to the appointment table
+void addAppointment(struct ClinicData* data);
 
-// Remove an appointment record from the appointment array
-void removeAppointment(struct Appointment appoints[], int maxAppoints,
-    struct Patient patients[], int maxPatients);
+// Remove an appointment record from the appointment table
+void removeAppointment(struct ClinicData* data);
 
 
 //////////////////////////////////////
@@ -154,34 +237,110 @@ void removeAppointment(struct Appointment appoints[], int maxAppoints,
 //////////////////////////////////////
 
 // Search and display patient record by patient number (form)
-void searchPatientByPatientNumber(const struct Patient patient[], int max);
+void searchPatientByPatientNumber(const struct ClinicData* data);
 
 // Search and display patient records by phone number (tabular)
-void searchPatientByPhoneNumber(const struct Patient patient[], int max);
+void searchPatientByPhoneNumber(const struct ClinicData* data);
 
 // Get the next highest patient number
-int nextPatientNumber(const struct Patient patient[], int max);
+int nextPatientNumber(struct ClinicData* data);
 
-// Find the patient array index by patient number (returns -1 if not found)
+// Find the patient table slot by patient number (returns -1 if not found)
 int findPatientIndexByPatientNum(int patientNumber,
-                                 const struct Patient patient[], int max);
+                                 const struct ClinicData* data);
+
+// Store a new patient in an allocated slot, filing it in the patient
+// number and phone indexes and the journal (returns 0 and frees the slot
+// if out of memory)
+int storeNewPatient(struct ClinicData* data, int index, const struct PatientEntry* entry);
+
+// Remove the patient in a slot from the table, its indexes and the journal
+void deletePatient(struct ClinicData* data, int index);
 
 // Sort appointments by date lowest to highest
 void sortAppointments(struct Appointment appoint[], int max);
 
+// Insert an appointment at its sorted position and count it in the day
+// index (returns its position or -1 if out of memory)
+int insertAppointment(struct ClinicData* data, const struct Appointment* appoint);
+
+// Delete the appointment at a position and uncount it from the day index
+// (returns the position of the appointment that followed it or -1)
+int deleteAppointment(struct ClinicData* data, int pos);
+
+// Find the appointment with the same patient, date and time (returns -1 if
+// there is none)
+int findExactAppointment(const struct ClinicData* data, const struct Appointment* appoint);
+
+// Check the day index for a booking at an appointment key's date and time
+// (returns 1 if the slot is taken)
+int isSlotTaken(const struct ClinicData* data, unsigned int key);
+
+// Fill "keys" with the first "max" free appointment slots at or after the
+// key "from" and on or before day "lastDay" (-1 for no limit)
+// (returns # of slots found)
+int findFreeSlots(const struct ClinicData* data, unsigned int from, int lastDay,
+                  unsigned int keys[], int max);
+
 // Compares two dates and return 0 if the same, -1 if apt1 < apt2 and 1 if apt1 > apt2
 int compareDate(const struct Date* dt1, const struct Date* dt2);
 
+// Convert a date to a day number (days since 1970-01-01, negative before)
+int dateToDayNumber(const struct Date* date);
+
+// Convert a day number (days since 1970-01-01) back to a date
+void dayNumberToDate(int dayNumber, struct Date* date);
+
+// Number of days in a month of a year
+int daysInMonth(int year, int month);
+
+// Pack a date (FIRST_YEAR to LAST_YEAR) and a slot time into an appointment key
+unsigned int appointmentKey(const struct Date* date, const struct Time* time);
+
+// Key of the first slot on a date (FIRST_YEAR to LAST_YEAR)
+unsigned int appointmentDayKey(const struct Date* date);
+
+// Unpack the date of an appointment
+void appointmentDate(const struct Appointment* appoint, struct Date* date);
+
+// Unpack the time of an appointment
+void appointmentTime(const struct Appointment* appoint, struct Time* time);
+
 // Compares two appointments and returns 0 if the same, -1 if apt1 < apt2 and 1 if apt1 > apt2
+// (by their ordering keys)
 int compareDateTime(const struct Appointment* apt1, const struct Appointment* apt2);
 
+// Pack a contact type and a number (empty or PHONE_LEN digits) into a phone
+// (returns 0 and leaves the phone alone if the number is not valid)
+int setPhone(struct Phone* phone, enum PhoneType type, const char* number);
+
+// Contact type of a phone
+enum PhoneType phoneType(const struct Phone* phone);
+
+// Description of a phone's contact type ("CELL", "HOME", "WORK" or "TBD")
+const char* phoneDescription(const struct Phone* phone);
+
+// Contact type with a description (returns -1 if there is none)
+int phoneTypeByDescription(const char* description);
+
+// Spell out a phone's number into PHONE_LEN + 1 chars ("" for no number)
+void phoneNumber(const struct Phone* phone, char* number);
+
+// Index key of a phone's number (the same as phoneKey of its digits)
+long long phoneNumberKey(const struct Phone* phone);
+
+// Store a patient entry's fields in a patient record, interning the name
+// (returns 0 if out of memory)
+int packPatient(struct ClinicData* data, const struct PatientEntry* entry,
+                struct Patient* patient);
+
 
 //////////////////////////////////////
 // USER INPUT FUNCTIONS
 //////////////////////////////////////
 
 // Get user input for a new patient record
-void inputPatient(struct Patient* patient);
+void inputPatient(struct PatientEntry* patient);
 
 // Get user input for phone contact information
 void inputPhoneData(struct Phone* phone);
@@ -196,10 +355,23 @@ void inputHourMin(struct Time* time);
 // FILE FUNCTIONS
 //////////////////////////////////////
 
-// Import patient data from file into a Patient array (returns # of records read)
-int importPatients(const char* datafile, struct Patient patients[], int max);
+// Import patient data from file into the patient table and rebuild the
+// patient number and phone indexes; the file is parsed in parallel and
+// malformed lines are reported on stderr and skipped (returns # of records read)
+int importPatients(const char* datafile, struct ClinicData* data);
+
+// Import appointment data from file into the appointment table, keeping
+// only real records, sorting them once and rebuilding the day index; the
+// file is parsed in parallel and malformed lines are reported on stderr
+// and skipped (returns # of records read)
+int importAppointments(const char* datafile, struct ClinicData* data);
+
+// Write every patient to a data file in the import format
+// (returns # of records written or -1 if the file could not be written)
+int exportPatients(const char* datafile, const struct ClinicData* data);
 
-// Import appointment data from file into an Appointment array (returns # of records read)
-int importAppointments(const char* datafile, struct Appointment appoints[], int max);
+// Write every appointment to a data file in the import format, in date/time
+// order (returns # of records written or -1 if the file could not be written)
+int exportAppointments(const char* datafile, const struct ClinicData* data);
 
 #endif // !CLINIC_H
\ No newline at end of file
@@ -1,11 +1,24 @@
 #define _CRT_SECURE_NO_WARNINGS
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include <string.h>
 
 #include "core.h"
 
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Stop the program when standard input has ended (every prompt would
+// fail and ask again forever)
+static void endOfInput(void)
+{
+    fprintf(stderr, "ERROR: Input ended before the session was exited!\n");
+    exit(EXIT_FAILURE);
+}
+
 //////////////////////////////////////
 // USER INTERFACE FUNCTIONS
 //////////////////////////////////////
@@ -13,10 +26,15 @@
 // Clear the standard input buffer
 void clearInputBuffer(void)
 {
+    int c;
+
     // Discard all remaining char's from the standard input buffer:
-    while (getchar() != '\n')
+    while ((c = getchar()) != '\n')
     {
-        ; // do nothing!
+        if (c == EOF)
+        {
+            endOfInput();
+        }
     }
 }
 
@@ -74,7 +92,10 @@ int inputInt(void)
     {
         valid = 1;
 
-        scanf("%d%c", &input, &newLine);
+        if (scanf("%d%c", &input, &newLine) == EOF || feof(stdin))
+        {
+            endOfInput();
+        }
 
         if (newLine != '\n')
         {
@@ -113,6 +134,13 @@ int inputIntPositive(void)
 
 // Ensures user input is within the provided range
 int inputIntRange(int start, int end)
+{
+    return inputIntRangeHidden(start, end, start);
+}
+
+// Ensures user input is within the provided range or is the hidden value
+// (which the error message does not mention)
+int inputIntRangeHidden(int start, int end, int hidden)
 {
     int input, valid;
 
@@ -122,7 +150,7 @@ int inputIntRange(int start, int end)
 
         input = inputInt();
 
-        if (input < start || input > end)
+        if ((input < start || input > end) && input != hidden)
         {
             printf("ERROR! Value must be between %d and %d inclusive: ", start, end);
 
@@ -147,7 +175,10 @@ char inputCharOption(const char* string)
         {
             found = 0;
 
-            scanf("%c%c", &input, &newLine);
+            if (scanf("%c%c", &input, &newLine) == EOF || feof(stdin))
+            {
+                endOfInput();
+            }
 
             if (newLine != '\n')
             {
@@ -195,7 +226,10 @@ void inputCString(char* string, int min, int max)
             valid = 1;
             length = 0;
 
-            scanf(fmt, input);
+            if (scanf(fmt, input) == EOF)
+            {
+                endOfInput();
+            }
             clearInputBuffer();
 
             length = strlen(input);
@@ -35,6 +35,10 @@ int inputIntPositive(void);
 // Ensures user input is within the provided range
 int inputIntRange(int start, int end);
 
+// Ensures user input is within the provided range or is the hidden value
+// (which the error message does not mention)
+int inputIntRangeHidden(int start, int end, int hidden);
+
 // Ensures an inputted character is found within the provided string
 char inputCharOption(const char* string);
 
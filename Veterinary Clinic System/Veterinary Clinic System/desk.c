@@ -0,0 +1,538 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <limits.h>
+#include <string.h>
+
+#include "desk.h"
+#include "trace.h"
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Lock of a day number
+static struct RwLock* dayLock(struct FrontDesk* desk, int day)
+{
+    return &desk->days[(unsigned int)day % DESK_DAY_SHARDS];
+}
+
+// Lock of an appointment block number
+static struct RwLock* blockLock(struct FrontDesk* desk, int block)
+{
+    return &desk->blocks[(unsigned int)block % DESK_BLOCK_SHARDS];
+}
+
+// Lock of a patient number (that of its patient index shard)
+static struct RwLock* patientLock(struct FrontDesk* desk, int patientNumber)
+{
+    return &desk->patients[patientIndexShard(patientNumber)];
+}
+
+// Fill "keys" with up to "max" free slots at or after the key "from",
+// holding each day's lock while its slots are read (returns # found)
+static int findDeskFreeSlots(struct FrontDesk* desk, unsigned int from, unsigned int keys[],
+                             int max)
+{
+    int day, lastDay, found = 0;
+
+    struct Date last = { LAST_YEAR, DEC, 31 };
+
+    struct RwLock* lock;
+
+    lastDay = dateToDayNumber(&last);
+
+    for (day = (int)(from >> KEY_DATE_SHIFT); day <= lastDay && found < max; day++)
+    {
+        lock = dayLock(desk, day);
+
+        readLock(lock);
+        found += findFreeSlots(desk->data, from, day, &keys[found], max - found);
+        readUnlock(lock);
+
+        from = (unsigned int)(day + 1) << KEY_DATE_SHIFT;
+    }
+
+    return found;
+}
+
+
+//////////////////////////////////////
+// FRONT DESK FUNCTIONS
+//////////////////////////////////////
+
+// Create the locks for working on a clinic from several threads; the
+// clinic must only be changed through the front desk until it is closed
+// (returns 0 if out of memory)
+int openFrontDesk(struct FrontDesk* desk, struct ClinicData* data)
+{
+    int i, result;
+
+    memset(desk, 0, sizeof(*desk));
+    desk->data = data;
+
+    result = initRwLock(&desk->store) && initMutex(&desk->records) &&
+             initMutex(&desk->append);
+
+    for (i = 0; i < DESK_DAY_SHARDS && result; i++)
+    {
+        result = initRwLock(&desk->days[i]);
+    }
+
+    for (i = 0; i < DESK_BLOCK_SHARDS && result; i++)
+    {
+        result = initRwLock(&desk->blocks[i]);
+    }
+
+    for (i = 0; i < DESK_PATIENT_SHARDS && result; i++)
+    {
+        result = initRwLock(&desk->patients[i]);
+    }
+
+    if (!result)
+    {
+        closeFrontDesk(desk);
+    }
+
+    return result;
+}
+
+// Release the locks (no thread may still be using them)
+void closeFrontDesk(struct FrontDesk* desk)
+{
+    int i;
+
+    freeRwLock(&desk->store);
+    freeMutex(&desk->records);
+    freeMutex(&desk->append);
+
+    for (i = 0; i < DESK_DAY_SHARDS; i++)
+    {
+        freeRwLock(&desk->days[i]);
+    }
+
+    for (i = 0; i < DESK_BLOCK_SHARDS; i++)
+    {
+        freeRwLock(&desk->blocks[i]);
+    }
+
+    for (i = 0; i < DESK_PATIENT_SHARDS; i++)
+    {
+        freeRwLock(&desk->patients[i]);
+    }
+}
+
+// Store a patient under the next patient number, which "entry" gets
+// (returns DESK_OK, DESK_FULL or DESK_NO_MEMORY)
+enum DeskResult deskAddPatient(struct FrontDesk* desk, struct PatientEntry* entry)
+{
+    int index = -1;
+    unsigned int name = 0;
+
+    enum DeskResult result = DESK_OK;
+
+    struct Patient patient = { 0 };
+
+    struct RwLock* lock;
+
+    // The number is taken before the slot, as addPatient does, and before
+    // its patient lock is known; reserving it keeps other desks off it
+    readLock(&desk->store);
+    lockMutex(&desk->records);
+    entry->patientNumber = reservePatientNumber(desk->data);
+    unlockMutex(&desk->records);
+    readUnlock(&desk->store);
+
+    lock = patientLock(desk, entry->patientNumber);
+
+    writeLock(lock);
+    readLock(&desk->store);
+
+    lockMutex(&desk->records);
+
+    if ((index = takePatientSlot(desk->data)) != -1 &&
+        (name = internNameInBlock(desk->data, entry->name)) == 0)
+    {
+        // The name needs a new arena block, so the slot is given back
+        // before "store" is let go and compaction can run
+        clearPatientSlot(desk->data, index);
+        index = -1;
+    }
+
+    unlockMutex(&desk->records);
+
+    if (name)
+    {
+        patient.patientNumber = entry->patientNumber;
+        patient.name = name;
+        patient.phone = entry->phone;
+
+        // The slot only holds a patient once it is in both indexes
+        if (!insertPatientSlot(&desk->data->patientIndex, patient.patientNumber, index))
+        {
+            result = DESK_NO_MEMORY;
+        }
+
+        lockMutex(&desk->records);
+
+        if (result == DESK_OK &&
+            insertPhoneSlot(&desk->data->phoneIndex, phoneNumberKey(&patient.phone), index))
+        {
+            writePatient(desk->data, index, &patient);
+        }
+        else
+        {
+            result = DESK_NO_MEMORY;
+            removePatientSlot(&desk->data->patientIndex, patient.patientNumber);
+            clearPatientSlot(desk->data, index);
+        }
+
+        settlePatientNumber(desk->data, patient.patientNumber, result == DESK_OK);
+        unlockMutex(&desk->records);
+
+        if (result == DESK_OK)
+        {
+            lockMutex(&desk->append);
+            journalPatient(desk->data, &patient);
+            unlockMutex(&desk->append);
+        }
+    }
+
+    readUnlock(&desk->store);
+
+    if (!name)
+    {
+        // The patient table or the name arena needs a new block, so "store"
+        // is held alone
+        writeLock(&desk->store);
+
+        if ((index = allocPatientSlot(desk->data)) == -1)
+        {
+            result = DESK_FULL;
+        }
+        else if (!storeNewPatient(desk->data, index, entry))
+        {
+            result = DESK_NO_MEMORY;
+        }
+
+        settlePatientNumber(desk->data, entry->patientNumber, result == DESK_OK);
+
+        writeUnlock(&desk->store);
+    }
+
+    writeUnlock(lock);
+
+    return result;
+}
+
+// Remove a patient (its appointments stay, as with the menu)
+// (returns DESK_OK or DESK_NOT_FOUND)
+enum DeskResult deskRemovePatient(struct FrontDesk* desk, int patientNumber)
+{
+    int index;
+
+    enum DeskResult result = DESK_NOT_FOUND;
+
+    struct Patient patient;
+
+    struct RwLock* lock = patientLock(desk, patientNumber);
+
+    writeLock(lock);
+    readLock(&desk->store);
+
+    if ((index = findPatientIndexByPatientNum(patientNumber, desk->data)) != -1)
+    {
+        readPatient(desk->data, index, &patient);
+        removePatientSlot(&desk->data->patientIndex, patientNumber);
+
+        lockMutex(&desk->records);
+        removePhoneSlot(&desk->data->phoneIndex, phoneNumberKey(&patient.phone), index);
+        clearPatientSlot(desk->data, index);
+        unlockMutex(&desk->records);
+
+        lockMutex(&desk->append);
+        journalPatientRemoval(desk->data, patientNumber);
+        desk->removed++;
+        unlockMutex(&desk->append);
+
+        result = DESK_OK;
+    }
+
+    readUnlock(&desk->store);
+    writeUnlock(lock);
+
+    return result;
+}
+
+// Copy a patient with its name spelled out (returns DESK_OK or
+// DESK_NOT_FOUND)
+enum DeskResult deskFindPatient(struct FrontDesk* desk, int patientNumber,
+                                struct PatientEntry* entry)
+{
+    int index;
+
+    enum DeskResult result = DESK_NOT_FOUND;
+
+    struct Patient patient;
+
+    struct RwLock* lock = patientLock(desk, patientNumber);
+
+    readLock(lock);
+    readLock(&desk->store);
+
+    if ((index = findPatientIndexByPatientNum(patientNumber, desk->data)) != -1)
+    {
+        // The name arena may grow once "store" is let go, so the name is
+        // copied out under it
+        readPatient(desk->data, index, &patient);
+
+        entry->patientNumber = patient.patientNumber;
+        entry->phone = patient.phone;
+        strncpy(entry->name, patientName(desk->data, &patient), NAME_LEN);
+        entry->name[NAME_LEN] = '\0';
+
+        result = DESK_OK;
+    }
+
+    readUnlock(&desk->store);
+    readUnlock(lock);
+
+    return result;
+}
+
+// Book a slot for a patient; when it is taken "keys" gets up to
+// SUGGESTED_SLOTS of the next free ones and "suggested" their number
+// (returns DESK_OK, DESK_NOT_FOUND, DESK_TAKEN or DESK_NO_MEMORY)
+enum DeskResult deskBook(struct FrontDesk* desk, const struct Appointment* appoint,
+                         unsigned int keys[], int* suggested)
+{
+    int block, found, pos = -1;
+
+    int day = (int)(appoint->key >> KEY_DATE_SHIFT);
+    int slot = (int)(appoint->key & KEY_SLOT_MASK);
+
+    enum DeskResult result = DESK_OK;
+
+    struct RwLock* lock = dayLock(desk, day);
+
+    *suggested = 0;
+
+    traceBegin(__func__);
+
+    // Holding the day's lock, no other booking or cancellation can change
+    // the day's slots between the check and the insert.  The patient is
+    // only locked for its lookup: as with the menu, removing a patient
+    // leaves its appointments, so a booking made as its patient is removed
+    // is one made just before.
+    writeLock(lock);
+    readLock(patientLock(desk, appoint->patientNumber));
+    readLock(&desk->store);
+
+    found = findPatientIndexByPatientNum(appoint->patientNumber, desk->data) != -1;
+
+    readUnlock(patientLock(desk, appoint->patientNumber));
+
+    if (!found)
+    {
+        result = DESK_NOT_FOUND;
+    }
+    else if (isSlotTaken(desk->data, appoint->key))
+    {
+        result = DESK_TAKEN;
+    }
+    else if ((block = findAppointmentBlock(desk->data, appoint, 1)) != -1)
+    {
+        writeLock(blockLock(desk, block));
+        pos = storeBlockAppointment(desk->data, block, appoint);
+        writeUnlock(blockLock(desk, block));
+
+        if (pos != -1 && !addDayCount(&desk->data->dayIndex, day, slot))
+        {
+            writeLock(blockLock(desk, block));
+            eraseBlockAppointment(desk->data, pos);
+            writeUnlock(blockLock(desk, block));
+
+            result = DESK_NO_MEMORY;
+        }
+        else if (pos != -1)
+        {
+            lockMutex(&desk->append);
+            desk->data->appointments.count++;
+            journalAppointment(desk->data, appoint);
+            unlockMutex(&desk->append);
+        }
+    }
+
+    readUnlock(&desk->store);
+
+    if (result == DESK_OK && pos == -1)
+    {
+        // The block is full or the appointment goes first in it, so the
+        // directory can change and "store" is held alone
+        writeLock(&desk->store);
+
+        if (insertAppointment(desk->data, appoint) < 0)
+        {
+            result = DESK_NO_MEMORY;
+        }
+        else
+        {
+            journalAppointment(desk->data, appoint);
+        }
+
+        writeUnlock(&desk->store);
+    }
+
+    writeUnlock(lock);
+
+    if (result == DESK_TAKEN)
+    {
+        *suggested = findDeskFreeSlots(desk, appoint->key, keys, SUGGESTED_SLOTS);
+    }
+
+    traceEnd(__func__);
+
+    return result;
+}
+
+// Remove a patient's appointment (returns DESK_OK or DESK_NOT_FOUND)
+enum DeskResult deskCancel(struct FrontDesk* desk, const struct Appointment* appoint)
+{
+    int block, pos, left = -1;
+
+    int day = (int)(appoint->key >> KEY_DATE_SHIFT);
+
+    enum DeskResult result = DESK_NOT_FOUND;
+
+    struct RwLock* lock = dayLock(desk, day);
+
+    traceBegin(__func__);
+
+    writeLock(lock);
+    readLock(&desk->store);
+
+    // Changes to other days move the day's appointments about inside their
+    // blocks, so each block is searched (and the appointment removed)
+    // holding its lock
+    for (block = findAppointmentBlock(desk->data, appoint, 0);
+         block != -1 && result == DESK_NOT_FOUND;
+         block = nextAppointmentBlock(desk->data, block, appoint->key))
+    {
+        writeLock(blockLock(desk, block));
+
+        if ((pos = findBlockAppointment(desk->data, block, appoint)) != -1)
+        {
+            left = eraseBlockAppointment(desk->data, pos);
+            result = DESK_OK;
+        }
+
+        writeUnlock(blockLock(desk, block));
+    }
+
+    if (left != -1)
+    {
+        removeDayCount(&desk->data->dayIndex, day);
+
+        // Imported data can book a slot twice; it is free once the last goes
+        if (!left)
+        {
+            clearDaySlot(&desk->data->dayIndex, day, (int)(appoint->key & KEY_SLOT_MASK));
+        }
+
+        lockMutex(&desk->append);
+        desk->data->appointments.count--;
+        desk->removed++;
+        journalAppointmentRemoval(desk->data, appoint);
+        unlockMutex(&desk->append);
+    }
+
+    readUnlock(&desk->store);
+
+    if (result == DESK_OK && left == -1)
+    {
+        // It is its block's first appointment, so the directory can change
+        // and "store" is held alone (the day's lock keeps it in place)
+        writeLock(&desk->store);
+
+        pos = findExactAppointment(desk->data, appoint);
+        journalAppointmentRemoval(desk->data, appoint);
+        deleteAppointment(desk->data, pos);
+        desk->removed++;
+
+        writeUnlock(&desk->store);
+    }
+
+    writeUnlock(lock);
+
+    traceEnd(__func__);
+
+    return result;
+}
+
+// Copy up to "max" of a day's appointments in time order (returns # of
+// appointments the day has, which can be more)
+int deskQueryDay(struct FrontDesk* desk, const struct Date* date,
+                 struct Appointment appoint[], int max)
+{
+    int block, count = 0, result;
+
+    int day = dateToDayNumber(date);
+
+    unsigned int high;
+
+    struct Appointment first = { 0 };
+
+    struct RwLock* lock = dayLock(desk, day);
+
+    first.key = appointmentDayKey(date);
+    high = first.key | KEY_SLOT_MASK;
+
+    // The day's lock held shared keeps its count and appointments as they
+    // are; each block's lock keeps changes to other days from moving them
+    // while they are copied
+    readLock(lock);
+    readLock(&desk->store);
+
+    result = findDayCount(&desk->data->dayIndex, day);
+
+    // The day's appointments are contiguous, starting at its first slot
+    for (block = findAppointmentBlock(desk->data, &first, 0);
+         block != -1 && count < max;
+         block = nextAppointmentBlock(desk->data, block, high))
+    {
+        readLock(blockLock(desk, block));
+        count += readBlockAppointments(desk->data, block, first.key, high, &appoint[count],
+                                       max - count);
+        readUnlock(blockLock(desk, block));
+    }
+
+    readUnlock(&desk->store);
+    readUnlock(lock);
+
+    return result;
+}
+
+// Compact what the removals since the last commit left behind, then
+// commit the changes made so far to the journal (and the clinic image)
+// (returns 0 if they could not be written)
+int deskCommit(struct FrontDesk* desk)
+{
+    int result, budget;
+
+    // One exclusive step per commit: the menus compact STORE_COMPACT_BUDGET
+    // records after each removal, so the removals since the last commit
+    // get that much in one go
+    writeLock(&desk->store);
+
+    budget = desk->removed < INT_MAX / STORE_COMPACT_BUDGET ?
+             desk->removed * STORE_COMPACT_BUDGET : INT_MAX;
+    compactClinicData(desk->data, budget);
+    desk->removed = 0;
+
+    result = commitJournal(desk->data);
+    result = syncClinicImage(desk->data) && result;
+
+    writeUnlock(&desk->store);
+
+    return result;
+}
@@ -0,0 +1,112 @@
+#ifndef DESK_H
+#define DESK_H
+
+#include "clinic.h"
+#include "thread.h"
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// Locks the days, appointment blocks and patient numbers are spread over
+// (days and blocks take the lock they equal modulo these, patient numbers
+// that of their patient index shard); a day's or patient number's lock
+// also covers its shard of the day or patient index
+#define DESK_DAY_SHARDS DAY_INDEX_SHARDS
+#define DESK_BLOCK_SHARDS 64
+#define DESK_PATIENT_SHARDS PATIENT_INDEX_SHARDS
+
+//////////////////////////////////////
+// Enumerations
+//////////////////////////////////////
+
+// Outcomes of the front desk operations
+enum DeskResult
+{
+    DESK_OK,
+    DESK_NOT_FOUND,     // no such patient (or appointment, for a cancel)
+    DESK_TAKEN,         // the slot is booked
+    DESK_FULL,          // the patient listing is full
+    DESK_NO_MEMORY
+};
+
+//////////////////////////////////////
+// Structures
+//////////////////////////////////////
+
+// Data type: FrontDesk
+// Locks that let several threads (front desk terminals) work on one clinic
+// at once.  Bookings and cancellations hold their day's lock alone, so the
+// day's slots cannot change between a check and the change it allows, and
+// day listings hold it shared.  A change that stays inside one appointment
+// block is made holding "store" shared and the block's lock alone, so
+// other days carry on in parallel; readers hold each block's lock shared
+// while they read it.  Patients are added and removed holding their
+// number's lock alone and "store" shared, so desks working on other
+// patient shards carry on; lookups hold the number's lock shared.
+// "records" covers the patient slots, the patient number count, the name
+// arena and the phone index, which every patient change touches but only
+// briefly.  "store" is held alone to split, empty or merge blocks or
+// change their first appointments, to add a block to the patient table or
+// name arena and by deskCommit.  "append" covers the journal buffer and
+// the counts changed alongside it.  Locks are taken in the order day
+// lock, patient lock, "store", block lock, "records", "append", holding
+// at most one of each.
+struct FrontDesk
+{
+    struct ClinicData* data;
+    struct RwLock store;
+    struct RwLock days[DESK_DAY_SHARDS];
+    struct RwLock blocks[DESK_BLOCK_SHARDS];
+    struct RwLock patients[DESK_PATIENT_SHARDS];
+    struct Mutex records;
+    struct Mutex append;
+    int removed;        // patients and appointments removed since the last commit
+};
+
+
+//////////////////////////////////////
+// FRONT DESK FUNCTIONS
+//////////////////////////////////////
+
+// Create the locks for working on a clinic from several threads; the
+// clinic must only be changed through the front desk until it is closed
+// (returns 0 if out of memory)
+int openFrontDesk(struct FrontDesk* desk, struct ClinicData* data);
+
+// Release the locks (no thread may still be using them)
+void closeFrontDesk(struct FrontDesk* desk);
+
+// Store a patient under the next patient number, which "entry" gets
+// (returns DESK_OK, DESK_FULL or DESK_NO_MEMORY)
+enum DeskResult deskAddPatient(struct FrontDesk* desk, struct PatientEntry* entry);
+
+// Remove a patient (its appointments stay, as with the menu)
+// (returns DESK_OK or DESK_NOT_FOUND)
+enum DeskResult deskRemovePatient(struct FrontDesk* desk, int patientNumber);
+
+// Copy a patient with its name spelled out (returns DESK_OK or
+// DESK_NOT_FOUND)
+enum DeskResult deskFindPatient(struct FrontDesk* desk, int patientNumber,
+                                struct PatientEntry* entry);
+
+// Book a slot for a patient; when it is taken "keys" gets up to
+// SUGGESTED_SLOTS of the next free ones and "suggested" their number
+// (returns DESK_OK, DESK_NOT_FOUND, DESK_TAKEN or DESK_NO_MEMORY)
+enum DeskResult deskBook(struct FrontDesk* desk, const struct Appointment* appoint,
+                         unsigned int keys[], int* suggested);
+
+// Remove a patient's appointment (returns DESK_OK or DESK_NOT_FOUND)
+enum DeskResult deskCancel(struct FrontDesk* desk, const struct Appointment* appoint);
+
+// Copy up to "max" of a day's appointments in time order (returns # of
+// appointments the day has, which can be more)
+int deskQueryDay(struct FrontDesk* desk, const struct Date* date,
+                 struct Appointment appoint[], int max);
+
+// Compact what the removals since the last commit left behind, then
+// commit the changes made so far to the journal (and the clinic image)
+// (returns 0 if they could not be written)
+int deskCommit(struct FrontDesk* desk);
+
+#endif // !DESK_H
@@ -0,0 +1,556 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "clinic.h"
+#include "import.h"
+#include "thread.h"
+#include "trace.h"
+
+// Data type: ImportError (a malformed line found by a worker)
+struct ImportError
+{
+    int line;               // line number within the chunk (from 1)
+    const char* message;
+};
+
+// Data type: ImportChunk
+// A line-aligned piece of a batch and the results of parsing it
+struct ImportChunk
+{
+    char* start;
+    int length;
+    int recordSize;
+    int (*parse)(const char* line, int length, void* record, const char** error);
+    char* records;          // parsed records in line order
+    int count;
+    int capacity;
+    struct ImportError* errors;
+    int errorCount;
+    int errorCapacity;
+    int lines;              // lines in the chunk
+    int failed;             // set if the worker ran out of memory
+};
+
+// Threads that parse data files (0: one per processor)
+static int importThreads = 0;
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Read an unsigned decimal number, advancing the cursor past it
+// (returns 0 if there are no digits or the value does not fit in an int)
+static int parseNumber(const char** cursor, const char* end, int* value)
+{
+    int digits = 0, result = 1;
+
+    const char* p = *cursor;
+
+    *value = 0;
+
+    while (p < end && *p >= '0' && *p <= '9' && result)
+    {
+        if (*value > (INT_MAX - (*p - '0')) / 10)
+        {
+            result = 0;
+        }
+        else
+        {
+            *value = *value * 10 + (*p - '0');
+            digits++;
+            p++;
+        }
+    }
+
+    *cursor = p;
+
+    return result && digits > 0;
+}
+
+// Copy the text up to the next '|' (or the end of the line) into a field,
+// advancing the cursor to the '|' (returns 0 if longer than "max")
+static int parseField(const char** cursor, const char* end, char* field, int max)
+{
+    int length;
+
+    const char* stop = memchr(*cursor, '|', end - *cursor);
+
+    if (stop == NULL)
+    {
+        stop = end;
+    }
+
+    length = (int)(stop - *cursor);
+
+    if (length <= max)
+    {
+        memcpy(field, *cursor, length);
+        field[length] = '\0';
+    }
+
+    *cursor = stop;
+
+    return length <= max;
+}
+
+// Skip an expected separator (returns 0 if the cursor is not on one)
+static int skipSeparator(const char** cursor, const char* end, char separator)
+{
+    int result = *cursor < end && **cursor == separator;
+
+    if (result)
+    {
+        (*cursor)++;
+    }
+
+    return result;
+}
+
+
+//////////////////////////////////////
+// CHUNK FUNCTIONS
+//////////////////////////////////////
+
+// Make room for one more item in a growable array (returns 0 if out of memory)
+static int reserveItem(void** items, int count, int* capacity, int itemSize)
+{
+    int size, result = 1;
+
+    void* grown;
+
+    if (count == *capacity)
+    {
+        size = *capacity ? *capacity * 2 : 256;
+        grown = realloc(*items, (size_t)size * itemSize);
+
+        if (grown != NULL)
+        {
+            *items = grown;
+            *capacity = size;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+// Worker: parse every line of a chunk into its record and error buffers
+static void parseChunk(void* arg)
+{
+    int length;
+
+    char* line;
+    char* stop;
+    char* end;
+    const char* error;
+
+    struct ImportChunk* chunk = arg;
+
+    traceBegin(__func__);
+
+    chunk->count = 0;
+    chunk->errorCount = 0;
+    chunk->lines = 0;
+    chunk->failed = 0;
+
+    end = chunk->start + chunk->length;
+
+    for (line = chunk->start; line < end && !chunk->failed; line = stop + 1)
+    {
+        stop = memchr(line, '\n', end - line);
+
+        if (stop == NULL)
+        {
+            stop = end;
+        }
+
+        length = (int)(stop - line);
+
+        if (length > 0 && line[length - 1] == '\r')
+        {
+            length--;
+        }
+
+        // Lines end in place: the byte is the chunk's own '\r' or '\n', or
+        // the spare byte after the data for a last line with no line end
+        line[length] = '\0';
+        chunk->lines++;
+
+        if (length)
+        {
+            if (!reserveItem((void**)&chunk->records, chunk->count, &chunk->capacity,
+                             chunk->recordSize))
+            {
+                chunk->failed = 1;
+            }
+            else if (chunk->parse(line, length, chunk->records +
+                                  (size_t)chunk->count * chunk->recordSize, &error))
+            {
+                chunk->count++;
+            }
+            else if (!reserveItem((void**)&chunk->errors, chunk->errorCount,
+                                  &chunk->errorCapacity, sizeof(struct ImportError)))
+            {
+                chunk->failed = 1;
+            }
+            else
+            {
+                chunk->errors[chunk->errorCount].line = chunk->lines;
+                chunk->errors[chunk->errorCount].message = error;
+                chunk->errorCount++;
+            }
+        }
+    }
+
+    traceEnd(__func__);
+}
+
+// Split the first "used" bytes of a batch into line-aligned chunks
+// (returns the number of chunks)
+static int splitBatch(char* buffer, int used, int threads, struct ImportChunk chunks[])
+{
+    int pos, end, target, count = 0;
+
+    char* lineEnd;
+
+    target = used / threads + 1;
+
+    if (target < IMPORT_CHUNK_MIN)
+    {
+        target = IMPORT_CHUNK_MIN;
+    }
+
+    for (pos = 0; pos < used; pos = end)
+    {
+        end = used;
+
+        if (used - pos > target && count + 1 < threads)
+        {
+            lineEnd = memchr(buffer + pos + target, '\n', used - pos - target);
+            end = lineEnd != NULL ? (int)(lineEnd - buffer) + 1 : used;
+        }
+
+        chunks[count].start = buffer + pos;
+        chunks[count].length = end - pos;
+        count++;
+    }
+
+    return count;
+}
+
+
+//////////////////////////////////////
+// IMPORT FUNCTIONS
+//////////////////////////////////////
+
+// Set the number of threads that parse data files (0: one per processor)
+void setImportThreads(int count)
+{
+    importThreads = count;
+}
+
+// Read a data file in batches split at line boundaries into chunks that
+// are parsed in parallel.  Well-formed records are handed to "store" and
+// malformed lines reported on stderr, both in file order, so the result
+// does not depend on the thread count.  The import stops early if "store"
+// returns 0.
+void importRecords(const char* datafile, int recordSize,
+                   int (*parse)(const char* line, int length, void* record,
+                                const char** error),
+                   int (*store)(void* context, const void* record), void* context)
+{
+    int i, j, threads, count, capacity, size = 0, used, read, lineBase = 0;
+    int eof = 0, stop = 0;
+
+    char* buffer;
+    char* grown;
+
+    FILE* fp;
+
+    struct ImportChunk chunks[IMPORT_MAX_THREADS] = { { 0 } };
+    struct Thread workers[IMPORT_MAX_THREADS];
+
+    traceBegin(__func__);
+
+    threads = importThreads > 0 ? importThreads : processorCount();
+
+    if (threads > IMPORT_MAX_THREADS)
+    {
+        threads = IMPORT_MAX_THREADS;
+    }
+
+    for (i = 0; i < threads; i++)
+    {
+        chunks[i].recordSize = recordSize;
+        chunks[i].parse = parse;
+    }
+
+    // Binary mode: line ends are handled here and no text translation is paid for
+    fp = fopen(datafile, "rb");
+
+    // One byte past the data is kept spare to terminate a last line with no line end
+    capacity = threads * IMPORT_CHUNK_SIZE + 1;
+    buffer = fp != NULL ? malloc(capacity) : NULL;
+
+    if (fp != NULL && buffer == NULL)
+    {
+        fprintf(stderr, "ERROR: Out of memory, %s not imported!\n", datafile);
+    }
+
+    while (buffer != NULL && !stop && !(eof && size == 0))
+    {
+        read = (int)fread(buffer + size, 1, capacity - 1 - size, fp);
+        eof = read < capacity - 1 - size;
+        size += read;
+
+        // A batch ends after its last line end; the partial line after it is
+        // carried over to the next batch
+        used = size;
+
+        while (!eof && used > 0 && buffer[used - 1] != '\n')
+        {
+            used--;
+        }
+
+        if (used == 0 && !eof)
+        {
+            // A single line longer than the buffer
+            grown = realloc(buffer, (size_t)capacity * 2 - 1);
+
+            if (grown != NULL)
+            {
+                buffer = grown;
+                capacity = capacity * 2 - 1;
+            }
+            else
+            {
+                fprintf(stderr, "ERROR: %s line %d: line too long to read\n", datafile,
+                        lineBase + 1);
+                stop = 1;
+            }
+        }
+        else
+        {
+            count = splitBatch(buffer, used, threads, chunks);
+
+            // The first chunk is parsed here; one that fails to get a thread is too
+            for (i = 1; i < count; i++)
+            {
+                if (!startThread(&workers[i], parseChunk, &chunks[i]))
+                {
+                    parseChunk(&chunks[i]);
+                }
+            }
+
+            parseChunk(&chunks[0]);
+
+            for (i = 1; i < count; i++)
+            {
+                joinThread(&workers[i]);
+            }
+
+            // Merge in file order
+            for (i = 0; i < count && !stop; i++)
+            {
+                for (j = 0; j < chunks[i].errorCount; j++)
+                {
+                    fprintf(stderr, "ERROR: %s line %d: %s\n", datafile,
+                            lineBase + chunks[i].errors[j].line, chunks[i].errors[j].message);
+                }
+
+                for (j = 0; j < chunks[i].count && !stop; j++)
+                {
+                    stop = !store(context, chunks[i].records + (size_t)j * recordSize);
+                }
+
+                if (chunks[i].failed && !stop)
+                {
+                    fprintf(stderr, "ERROR: Out of memory, %s import stopped!\n", datafile);
+                    stop = 1;
+                }
+
+                lineBase += chunks[i].lines;
+            }
+
+            memmove(buffer, buffer + used, size - used);
+            size -= used;
+        }
+    }
+
+    for (i = 0; i < threads; i++)
+    {
+        free(chunks[i].records);
+        free(chunks[i].errors);
+    }
+
+    free(buffer);
+
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+
+    traceEnd(__func__);
+}
+
+
+//////////////////////////////////////
+// RECORD PARSING FUNCTIONS
+//////////////////////////////////////
+
+// Parse a "number|name|description|phone" line into a struct PatientEntry;
+// the description must be a contact type and the phone empty or PHONE_LEN
+// digits (returns 0 and points "error" at the reason when the line is malformed)
+int parsePatientLine(const char* line, int length, void* record, const char** error)
+{
+    int type = -1;
+
+    struct PatientEntry* patient = record;
+
+    const char* cursor = line;
+    const char* end = line + length;
+
+    char description[PHONE_DESC_LEN + 1];
+    char number[PHONE_LEN + 1];
+
+    struct PatientEntry empty = { 0 };
+
+    *patient = empty;
+    *error = NULL;
+
+    if (!parseNumber(&cursor, end, &patient->patientNumber))
+    {
+        *error = "patient number is not a number";
+    }
+    else if (!skipSeparator(&cursor, end, '|'))
+    {
+        *error = "expected '|' after the patient number";
+    }
+    else if (!parseField(&cursor, end, patient->name, NAME_LEN))
+    {
+        *error = "name is too long";
+    }
+    else if (!patient->name[0])
+    {
+        *error = "name is missing";
+    }
+    else if (!skipSeparator(&cursor, end, '|'))
+    {
+        *error = "expected '|' after the name";
+    }
+    else if (!parseField(&cursor, end, description, PHONE_DESC_LEN))
+    {
+        *error = "phone description is too long";
+    }
+    else if (!description[0])
+    {
+        *error = "phone description is missing";
+    }
+    else if ((type = phoneTypeByDescription(description)) == -1)
+    {
+        *error = "phone description is not CELL, HOME, WORK or TBD";
+    }
+    else if (!skipSeparator(&cursor, end, '|'))
+    {
+        *error = "expected '|' after the phone description";
+    }
+    else if (!parseField(&cursor, end, number, PHONE_LEN))
+    {
+        *error = "phone number is too long";
+    }
+    else if (cursor != end)
+    {
+        *error = "too many fields";
+    }
+    else if (!setPhone(&patient->phone, (enum PhoneType)type, number))
+    {
+        *error = "phone number is not empty or 10 digits";
+    }
+
+    return *error == NULL;
+}
+
+// Parse a "number,year,month,day,hour,minute" line into a struct Appointment;
+// the year must be FIRST_YEAR to LAST_YEAR and the time an appointment slot
+// (returns 0 and points "error" at the reason when the line is malformed)
+int parseAppointmentLine(const char* line, int length, void* record, const char** error)
+{
+    int i, ok, minutes, patientNumber = 0;
+
+    struct Appointment* appoint = record;
+
+    struct Date date = { 0 };
+    struct Time time = { 0 };
+
+    int* fields[6];
+
+    const char* cursor = line;
+    const char* end = line + length;
+
+    struct Appointment empty = { 0 };
+
+    *appoint = empty;
+    *error = NULL;
+
+    fields[0] = &patientNumber;
+    fields[1] = &date.year;
+    fields[2] = &date.month;
+    fields[3] = &date.day;
+    fields[4] = &time.hour;
+    fields[5] = &time.min;
+
+    ok = 1;
+
+    for (i = 0; i < 6 && ok; i++)
+    {
+        ok = (i == 0 || skipSeparator(&cursor, end, ',')) &&
+             parseNumber(&cursor, end, fields[i]);
+    }
+
+    minutes = time.hour * 60 + time.min;
+
+    if (!ok || cursor != end)
+    {
+        *error = "expected six comma separated numbers";
+    }
+    else if (date.year < FIRST_YEAR || date.year > LAST_YEAR)
+    {
+        *error = "year is out of range";
+    }
+    else if (date.month < JAN || date.month > DEC)
+    {
+        *error = "month is out of range";
+    }
+    else if (date.day < 1 || date.day > daysInMonth(date.year, date.month))
+    {
+        *error = "day is out of range";
+    }
+    else if (time.hour > HOUR_MAX)
+    {
+        *error = "hour is out of range";
+    }
+    else if (time.min > MINUTE_MAX)
+    {
+        *error = "minute is out of range";
+    }
+    else if (minutes < FIRST_HOUR * 60 + FIRST_MIN || minutes > LAST_HOUR * 60 + LAST_MIN ||
+             (minutes - (FIRST_HOUR * 60 + FIRST_MIN)) % APPOINT_LENGTH != 0)
+    {
+        *error = "time is not an appointment slot";
+    }
+    else
+    {
+        appoint->patientNumber = patientNumber;
+        appoint->key = appointmentKey(&date, &time);
+    }
+
+    return *error == NULL;
+}
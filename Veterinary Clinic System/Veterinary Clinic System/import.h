@@ -0,0 +1,50 @@
+#ifndef IMPORT_H
+#define IMPORT_H
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// Bytes of a data file each worker thread parses per batch
+#define IMPORT_CHUNK_SIZE (4 * 1024 * 1024)
+
+// Smallest chunk worth handing to another thread
+#define IMPORT_CHUNK_MIN (64 * 1024)
+
+// Upper limit for the import thread count
+#define IMPORT_MAX_THREADS 64
+
+
+//////////////////////////////////////
+// IMPORT FUNCTIONS
+//////////////////////////////////////
+
+// Set the number of threads that parse data files (0: one per processor)
+void setImportThreads(int count);
+
+// Read a data file in batches split at line boundaries into chunks that
+// are parsed in parallel.  Well-formed records are handed to "store" and
+// malformed lines reported on stderr, both in file order, so the result
+// does not depend on the thread count.  The import stops early if "store"
+// returns 0.
+void importRecords(const char* datafile, int recordSize,
+                   int (*parse)(const char* line, int length, void* record,
+                                const char** error),
+                   int (*store)(void* context, const void* record), void* context);
+
+
+//////////////////////////////////////
+// RECORD PARSING FUNCTIONS
+//////////////////////////////////////
+
+// Parse a "number|name|description|phone" line into a struct PatientEntry;
+// the description must be a contact type and the phone empty or PHONE_LEN
+// digits (returns 0 and points "error" at the reason when the line is malformed)
+int parsePatientLine(const char* line, int length, void* record, const char** error);
+
+// Parse a "number,year,month,day,hour,minute" line into a struct Appointment;
+// the year must be FIRST_YEAR to LAST_YEAR and the time an appointment slot
+// (returns 0 and points "error" at the reason when the line is malformed)
+int parseAppointmentLine(const char* line, int length, void* record, const char** error);
+
+#endif // !IMPORT_H
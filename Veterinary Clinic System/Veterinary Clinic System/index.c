@@ -0,0 +1,801 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include <ctype.h>
+
+#include "index.h"
+#include "scan.h"
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Hash of an integer key (the mix spreads keys that share low bits)
+static unsigned int intHash(int key)
+{
+    unsigned int hash = (unsigned int)key;
+
+    hash ^= hash >> 16;
+    hash *= 0x45d9f3bu;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+// Home bucket for an integer key
+static int intBucket(int key, int capacity)
+{
+    return (int)(intHash(key) & (unsigned int)(capacity - 1));
+}
+
+// Home bucket for a phone key
+static int phoneBucket(long long key, int capacity)
+{
+    unsigned long long hash = (unsigned long long)key;
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+
+    return (int)(hash & (unsigned long long)(capacity - 1));
+}
+
+// Bucket holding a phone key (returns -1 if the key is not stored)
+static int findPhoneBucket(const struct PhoneIndex* index, long long key)
+{
+    int bucket, found = -1;
+
+    if (index->count && key)
+    {
+        bucket = phoneBucket(key, index->capacity);
+
+        while (index->keys[bucket] && found == -1)
+        {
+            if (index->keys[bucket] == key)
+            {
+                found = bucket;
+            }
+            bucket = (bucket + 1) & (index->capacity - 1);
+        }
+    }
+
+    return found;
+}
+
+// Re-allocate a shard's bucket arrays at a new capacity and re-insert its keys
+static int resizePatientShard(struct PatientShard* shard, int capacity)
+{
+    int i, bucket, result = 0;
+
+    int* keys = calloc(capacity, sizeof(int));
+    int* slots = malloc(capacity * sizeof(int));
+
+    if (keys != NULL && slots != NULL)
+    {
+        for (i = 0; i < shard->capacity; i++)
+        {
+            if (shard->keys[i])
+            {
+                bucket = intBucket(shard->keys[i], capacity);
+
+                while (keys[bucket])
+                {
+                    bucket = (bucket + 1) & (capacity - 1);
+                }
+                keys[bucket] = shard->keys[i];
+                slots[bucket] = shard->slots[i];
+            }
+        }
+
+        free(shard->keys);
+        free(shard->slots);
+
+        shard->keys = keys;
+        shard->slots = slots;
+        shard->capacity = capacity;
+
+        result = 1;
+    }
+    else
+    {
+        free(keys);
+        free(slots);
+    }
+
+    return result;
+}
+
+
+// Re-allocate the phone buckets at a new capacity and re-insert every key
+static int resizePhoneIndex(struct PhoneIndex* index, int capacity)
+{
+    int i, bucket, result = 0;
+
+    long long* keys = calloc(capacity, sizeof(long long));
+    int* heads = malloc(capacity * sizeof(int));
+
+    if (keys != NULL && heads != NULL)
+    {
+        for (i = 0; i < index->capacity; i++)
+        {
+            if (index->keys[i])
+            {
+                bucket = phoneBucket(index->keys[i], capacity);
+
+                while (keys[bucket])
+                {
+                    bucket = (bucket + 1) & (capacity - 1);
+                }
+                keys[bucket] = index->keys[i];
+                heads[bucket] = index->heads[i];
+            }
+        }
+
+        free(index->keys);
+        free(index->heads);
+
+        index->keys = keys;
+        index->heads = heads;
+        index->capacity = capacity;
+
+        result = 1;
+    }
+    else
+    {
+        free(keys);
+        free(heads);
+    }
+
+    return result;
+}
+
+// Make sure the chain array has an entry for a patient slot
+static int reservePhoneSlots(struct PhoneIndex* index, int slot)
+{
+    int i, size, result = 1;
+
+    int* next;
+
+    if (slot >= index->maxSlots)
+    {
+        size = index->maxSlots ? index->maxSlots : INDEX_MIN_CAPACITY;
+
+        while (size <= slot)
+        {
+            size *= 2;
+        }
+
+        next = realloc(index->next, size * sizeof(int));
+
+        if (next != NULL)
+        {
+            for (i = index->maxSlots; i < size; i++)
+            {
+                next[i] = -1;
+            }
+            index->next = next;
+            index->maxSlots = size;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+// Shard a day number belongs to
+static int dayShard(int day)
+{
+    return (int)((unsigned int)day % DAY_INDEX_SHARDS);
+}
+
+// Bucket holding a day (returns -1 if the day has no appointments)
+static int findDayBucket(const struct DayShard* shard, int day)
+{
+    int bucket, found = -1;
+
+    if (shard->count)
+    {
+        bucket = intBucket(day, shard->capacity);
+
+        while (shard->entries[bucket].count && found == -1)
+        {
+            if (shard->entries[bucket].day == day)
+            {
+                found = bucket;
+            }
+            bucket = (bucket + 1) & (shard->capacity - 1);
+        }
+    }
+
+    return found;
+}
+
+// Re-allocate a shard's buckets at a new capacity and re-insert its days
+static int resizeDayShard(struct DayShard* shard, int capacity)
+{
+    int i, bucket, result = 0;
+
+    struct DayEntry* entries = calloc(capacity, sizeof(struct DayEntry));
+
+    if (entries != NULL)
+    {
+        for (i = 0; i < shard->capacity; i++)
+        {
+            if (shard->entries[i].count)
+            {
+                bucket = intBucket(shard->entries[i].day, capacity);
+
+                while (entries[bucket].count)
+                {
+                    bucket = (bucket + 1) & (capacity - 1);
+                }
+                entries[bucket] = shard->entries[i];
+            }
+        }
+
+        free(shard->entries);
+
+        shard->entries = entries;
+        shard->capacity = capacity;
+
+        result = 1;
+    }
+
+    return result;
+}
+
+//////////////////////////////////////
+// PATIENT NUMBER INDEX FUNCTIONS
+//////////////////////////////////////
+
+// Shard of the index a patient number is filed in
+int patientIndexShard(int patientNumber)
+{
+    // The top bits, as the bucket in the shard's table comes from the low ones
+    return (int)(intHash(patientNumber) >> (32 - PATIENT_INDEX_SHARD_BITS));
+}
+
+// Release the memory held by the index and reset it to empty
+void freePatientIndex(struct PatientIndex* index)
+{
+    int i;
+
+    struct PatientIndex empty = { 0 };
+
+    if (index != NULL)
+    {
+        for (i = 0; i < PATIENT_INDEX_SHARDS; i++)
+        {
+            free(index->shards[i].keys);
+            free(index->shards[i].slots);
+        }
+
+        *index = empty;
+    }
+}
+
+// Find the patient array slot for a patient number (returns -1 if not found)
+int findPatientSlot(const struct PatientIndex* index, int patientNumber)
+{
+    int bucket, slot = -1;
+
+    const struct PatientShard* shard;
+
+    if (index != NULL && patientNumber)
+    {
+        shard = &index->shards[patientIndexShard(patientNumber)];
+
+        if (shard->count)
+        {
+            bucket = intBucket(patientNumber, shard->capacity);
+
+            while (shard->keys[bucket] && slot == -1)
+            {
+                if (shard->keys[bucket] == patientNumber)
+                {
+                    slot = shard->slots[bucket];
+                }
+                bucket = (bucket + 1) & (shard->capacity - 1);
+            }
+        }
+    }
+
+    return slot;
+}
+
+// Add or update the slot for a patient number (returns 0 if out of memory)
+int insertPatientSlot(struct PatientIndex* index, int patientNumber, int slot)
+{
+    int bucket, result = 1;
+
+    struct PatientShard* shard = &index->shards[patientIndexShard(patientNumber)];
+
+    // Keep the load factor at or below 1/2 so probe chains stay short
+    if ((shard->count + 1) * 2 > shard->capacity)
+    {
+        result = resizePatientShard(shard, shard->capacity ? shard->capacity * 2
+                                                           : INDEX_MIN_CAPACITY);
+    }
+
+    if (result && patientNumber)
+    {
+        bucket = intBucket(patientNumber, shard->capacity);
+
+        while (shard->keys[bucket] && shard->keys[bucket] != patientNumber)
+        {
+            bucket = (bucket + 1) & (shard->capacity - 1);
+        }
+
+        if (!shard->keys[bucket])
+        {
+            shard->keys[bucket] = patientNumber;
+            shard->count++;
+        }
+        shard->slots[bucket] = slot;
+    }
+
+    return result;
+}
+
+// Remove a patient number from the index
+void removePatientSlot(struct PatientIndex* index, int patientNumber)
+{
+    int bucket, next, home, found = 0;
+
+    struct PatientShard* shard = index != NULL ? &index->shards[patientIndexShard(patientNumber)]
+                                               : NULL;
+
+    if (shard != NULL && shard->count && patientNumber)
+    {
+        bucket = intBucket(patientNumber, shard->capacity);
+
+        while (shard->keys[bucket] && !found)
+        {
+            if (shard->keys[bucket] == patientNumber)
+            {
+                found = 1;
+            }
+            else
+            {
+                bucket = (bucket + 1) & (shard->capacity - 1);
+            }
+        }
+
+        if (found)
+        {
+            // Backward-shift deletion: pull later members of the probe chain
+            // into the hole so lookups never need tombstones
+            next = (bucket + 1) & (shard->capacity - 1);
+
+            while (shard->keys[next])
+            {
+                home = intBucket(shard->keys[next], shard->capacity);
+
+                if (((next - home) & (shard->capacity - 1)) >=
+                    ((next - bucket) & (shard->capacity - 1)))
+                {
+                    shard->keys[bucket] = shard->keys[next];
+                    shard->slots[bucket] = shard->slots[next];
+                    bucket = next;
+                }
+                next = (next + 1) & (shard->capacity - 1);
+            }
+
+            shard->keys[bucket] = 0;
+            shard->count--;
+        }
+    }
+}
+
+
+//////////////////////////////////////
+// PHONE NUMBER INDEX FUNCTIONS
+//////////////////////////////////////
+
+// Convert a phone number string to an index key (returns 0 for no number)
+long long phoneKey(const char* number)
+{
+    int i, digits = 1;
+
+    long long key = 0;
+
+    unsigned long long hash = 14695981039346656037ull;
+
+    if (number != NULL && number[0])
+    {
+        for (i = 0; number[i] && digits; i++)
+        {
+            if (isdigit((unsigned char)number[i]) && i < 18)
+            {
+                key = key * 10 + (number[i] - '0');
+            }
+            else
+            {
+                digits = 0;
+            }
+        }
+
+        if (digits)
+        {
+            // Offset by one so "0000000000" does not collide with "no number"
+            key++;
+        }
+        else
+        {
+            // Anything else is hashed into the negative half of the key space;
+            // callers compare the stored strings to weed out collisions
+            for (i = 0; number[i]; i++)
+            {
+                hash = (hash ^ (unsigned char)number[i]) * 1099511628211ull;
+            }
+            key = (long long)(hash | 0x8000000000000000ull);
+        }
+    }
+
+    return key;
+}
+
+// Release the memory held by the index and reset it to empty
+void freePhoneIndex(struct PhoneIndex* index)
+{
+    struct PhoneIndex empty = { 0 };
+
+    if (index != NULL)
+    {
+        free(index->keys);
+        free(index->heads);
+        free(index->next);
+
+        *index = empty;
+    }
+}
+
+// Find the first patient slot with a phone key (returns -1 if not found)
+int findPhoneSlot(const struct PhoneIndex* index, long long key)
+{
+    int bucket, slot = -1;
+
+    if (index != NULL)
+    {
+        bucket = findPhoneBucket(index, key);
+
+        if (bucket != -1)
+        {
+            slot = index->heads[bucket];
+        }
+    }
+
+    return slot;
+}
+
+// Find the next patient slot sharing the same phone key (returns -1 at the end)
+int nextPhoneSlot(const struct PhoneIndex* index, int slot)
+{
+    int next = -1;
+
+    if (index != NULL && slot >= 0 && slot < index->maxSlots)
+    {
+        next = index->next[slot];
+    }
+
+    return next;
+}
+
+// Add a patient slot under a phone key (returns 0 if out of memory)
+int insertPhoneSlot(struct PhoneIndex* index, long long key, int slot)
+{
+    int bucket, prev, result = 1;
+
+    if (key && slot >= 0)
+    {
+        result = reservePhoneSlots(index, slot);
+
+        if (result && (index->count + 1) * 2 > index->capacity)
+        {
+            result = resizePhoneIndex(index, index->capacity ? index->capacity * 2
+                                                             : INDEX_MIN_CAPACITY);
+        }
+
+        if (result)
+        {
+            bucket = phoneBucket(key, index->capacity);
+
+            while (index->keys[bucket] && index->keys[bucket] != key)
+            {
+                bucket = (bucket + 1) & (index->capacity - 1);
+            }
+
+            if (!index->keys[bucket])
+            {
+                index->keys[bucket] = key;
+                index->heads[bucket] = slot;
+                index->next[slot] = -1;
+                index->count++;
+            }
+            else if (slot < index->heads[bucket])
+            {
+                index->next[slot] = index->heads[bucket];
+                index->heads[bucket] = slot;
+            }
+            else
+            {
+                // Keep the chain in slot order so results list like a scan
+                prev = index->heads[bucket];
+
+                while (index->next[prev] != -1 && index->next[prev] < slot)
+                {
+                    prev = index->next[prev];
+                }
+
+                if (prev != slot && index->next[prev] != slot)
+                {
+                    index->next[slot] = index->next[prev];
+                    index->next[prev] = slot;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+// Remove a patient slot from under a phone key
+void removePhoneSlot(struct PhoneIndex* index, long long key, int slot)
+{
+    int bucket, next, home, prev;
+
+    bucket = index != NULL ? findPhoneBucket(index, key) : -1;
+
+    if (bucket != -1 && slot >= 0 && slot < index->maxSlots)
+    {
+        if (index->heads[bucket] == slot)
+        {
+            index->heads[bucket] = index->next[slot];
+        }
+        else
+        {
+            prev = index->heads[bucket];
+
+            while (prev != -1 && index->next[prev] != slot)
+            {
+                prev = index->next[prev];
+            }
+
+            if (prev != -1)
+            {
+                index->next[prev] = index->next[slot];
+            }
+        }
+        index->next[slot] = -1;
+
+        if (index->heads[bucket] == -1)
+        {
+            // Last slot for this number: drop the key (backward-shift deletion)
+            next = (bucket + 1) & (index->capacity - 1);
+
+            while (index->keys[next])
+            {
+                home = phoneBucket(index->keys[next], index->capacity);
+
+                if (((next - home) & (index->capacity - 1)) >=
+                    ((next - bucket) & (index->capacity - 1)))
+                {
+                    index->keys[bucket] = index->keys[next];
+                    index->heads[bucket] = index->heads[next];
+                    bucket = next;
+                }
+                next = (next + 1) & (index->capacity - 1);
+            }
+
+            index->keys[bucket] = 0;
+            index->count--;
+        }
+    }
+}
+
+
+//////////////////////////////////////
+// DAY INDEX FUNCTIONS
+//////////////////////////////////////
+
+// Release the memory held by the index and reset it to empty
+void freeDayIndex(struct DayIndex* index)
+{
+    int i;
+
+    struct DayIndex empty = { 0 };
+
+    if (index != NULL)
+    {
+        for (i = 0; i < DAY_INDEX_SHARDS; i++)
+        {
+            free(index->shards[i].entries);
+        }
+
+        *index = empty;
+    }
+}
+
+// Number of appointments booked on a day
+int findDayCount(const struct DayIndex* index, int day)
+{
+    int bucket, count = 0;
+
+    const struct DayShard* shard;
+
+    if (index != NULL)
+    {
+        shard = &index->shards[dayShard(day)];
+        bucket = findDayBucket(shard, day);
+
+        if (bucket != -1)
+        {
+            count = shard->entries[bucket].count;
+        }
+    }
+
+    return count;
+}
+
+// Whether a slot of a day is taken (returns 1 if taken)
+int findDaySlot(const struct DayIndex* index, int day, int slot)
+{
+    int bucket, taken = 0;
+
+    const struct DayShard* shard;
+
+    if (index != NULL)
+    {
+        shard = &index->shards[dayShard(day)];
+        bucket = findDayBucket(shard, day);
+
+        if (bucket != -1)
+        {
+            taken = (int)(shard->entries[bucket].slots[slot / 64] >> (slot % 64) & 1);
+        }
+    }
+
+    return taken;
+}
+
+// First free slot of a day from "from" up to (not including) "end"
+// (returns -1 if every one is taken)
+int findDayFreeSlot(const struct DayIndex* index, int day, int from, int end)
+{
+    int bucket, word, found = -1;
+
+    unsigned long long free;
+
+    const struct DayShard* shard = index != NULL ? &index->shards[dayShard(day)] : NULL;
+
+    bucket = shard != NULL ? findDayBucket(shard, day) : -1;
+
+    if (bucket == -1)
+    {
+        // A day with no appointments is free throughout
+        found = from < end ? from : -1;
+    }
+    else
+    {
+        // One word holds 64 slots: its free bits below "end" and from
+        // "from" give the answer, or show the whole word taken
+        for (word = from / 64; word * 64 < end && found == -1; word++)
+        {
+            free = ~shard->entries[bucket].slots[word];
+
+            if (word == from / 64)
+            {
+                free &= ~0ull << (from % 64);
+            }
+            if (end - word * 64 < 64)
+            {
+                free &= (1ull << (end - word * 64)) - 1;
+            }
+
+            if (free)
+            {
+                found = word * 64 + lowestBit(free);
+            }
+        }
+    }
+
+    return found;
+}
+
+// Count one more appointment on a day and mark its slot taken
+// (returns 0 if out of memory)
+int addDayCount(struct DayIndex* index, int day, int slot)
+{
+    int bucket, result = 1;
+
+    struct DayEntry empty = { 0 };
+    struct DayShard* shard = &index->shards[dayShard(day)];
+
+    bucket = findDayBucket(shard, day);
+
+    if (bucket != -1)
+    {
+        shard->entries[bucket].count++;
+    }
+    else
+    {
+        if ((shard->count + 1) * 2 > shard->capacity)
+        {
+            result = resizeDayShard(shard, shard->capacity ? shard->capacity * 2
+                                                           : INDEX_MIN_CAPACITY);
+        }
+
+        if (result)
+        {
+            bucket = intBucket(day, shard->capacity);
+
+            while (shard->entries[bucket].count)
+            {
+                bucket = (bucket + 1) & (shard->capacity - 1);
+            }
+
+            // A bucket emptied by a removal still holds its old bitmap
+            shard->entries[bucket] = empty;
+            shard->entries[bucket].day = day;
+            shard->entries[bucket].count = 1;
+            shard->count++;
+        }
+    }
+
+    if (result)
+    {
+        shard->entries[bucket].slots[slot / 64] |= 1ull << (slot % 64);
+    }
+
+    return result;
+}
+
+// Count one less appointment on a day, dropping the day when it empties;
+// its slot stays taken (see clearDaySlot)
+void removeDayCount(struct DayIndex* index, int day)
+{
+    int bucket, next, home;
+
+    struct DayShard* shard = index != NULL ? &index->shards[dayShard(day)] : NULL;
+
+    bucket = shard != NULL ? findDayBucket(shard, day) : -1;
+
+    if (bucket != -1 && --shard->entries[bucket].count == 0)
+    {
+        // Backward-shift deletion, as for the other indexes
+        next = (bucket + 1) & (shard->capacity - 1);
+
+        while (shard->entries[next].count)
+        {
+            home = intBucket(shard->entries[next].day, shard->capacity);
+
+            if (((next - home) & (shard->capacity - 1)) >=
+                ((next - bucket) & (shard->capacity - 1)))
+            {
+                shard->entries[bucket] = shard->entries[next];
+                bucket = next;
+            }
+            next = (next + 1) & (shard->capacity - 1);
+        }
+
+        shard->entries[bucket].count = 0;
+        shard->count--;
+    }
+}
+
+// Mark a slot of a day free once no appointment is left in it
+void clearDaySlot(struct DayIndex* index, int day, int slot)
+{
+    struct DayShard* shard = index != NULL ? &index->shards[dayShard(day)] : NULL;
+
+    int bucket = shard != NULL ? findDayBucket(shard, day) : -1;
+
+    if (bucket != -1)
+    {
+        shard->entries[bucket].slots[slot / 64] &= ~(1ull << (slot % 64));
+    }
+}
@@ -0,0 +1,166 @@
+#ifndef INDEX_H
+#define INDEX_H
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// Smallest table allocated by the first insert (must be a power of 2)
+#define INDEX_MIN_CAPACITY 64
+
+// Tables the patient numbers are spread over by their hash (the top
+// PATIENT_INDEX_SHARD_BITS bits of it)
+#define PATIENT_INDEX_SHARD_BITS 6
+#define PATIENT_INDEX_SHARDS (1 << PATIENT_INDEX_SHARD_BITS)
+
+// Slot numbers a day can hold: every value of the 8 slot bits of an
+// appointment key, whatever the clinic hours are
+#define DAY_SLOTS 256
+
+// Tables the days are spread over (a day number goes to the one it equals
+// modulo this)
+#define DAY_INDEX_SHARDS 64
+
+//////////////////////////////////////
+// Structures
+//////////////////////////////////////
+
+// Data type: PatientShard (hash table of the patient numbers of one shard)
+struct PatientShard
+{
+    int* keys;      // patient numbers (0 marks an empty bucket)
+    int* slots;     // patient array slot for the matching key
+    int capacity;   // number of buckets (power of 2)
+    int count;      // number of keys stored
+};
+
+// Data type: PatientIndex
+// Open addressing (linear probing) hash tables that map a patient number
+// to the slot the record occupies in the patient array.  Each shard is a
+// table of its own, so adding or removing a number (which moves entries
+// around its table) only touches numbers of the same shard.  A zeroed
+// structure is a valid empty index.
+struct PatientIndex
+{
+    struct PatientShard shards[PATIENT_INDEX_SHARDS];
+};
+
+// Data type: PhoneIndex
+// Multi-valued index from a phone number to every patient slot that shares
+// it.  The hash table holds the first slot for each number and the "next"
+// array chains the remaining slots in ascending slot order, so a lookup
+// costs one probe plus one step per matching patient.  A zeroed structure
+// is a valid empty index.
+struct PhoneIndex
+{
+    long long* keys;    // phone number keys (0 marks an empty bucket)
+    int* heads;         // lowest patient slot with the matching key
+    int capacity;       // number of buckets (power of 2)
+    int count;          // number of distinct keys stored
+    int* next;          // next slot with the same key (-1 ends the chain)
+    int maxSlots;       // number of entries allocated in "next"
+};
+
+// Data type: DayEntry (one calendar day with at least one appointment)
+struct DayEntry
+{
+    int day;            // day number (days since 1970-01-01)
+    int count;          // appointments booked on the day (0 marks an empty bucket)
+    unsigned long long slots[DAY_SLOTS / 64];   // bit set for each slot taken
+};
+
+// Data type: DayShard (hash table of the days of one shard)
+struct DayShard
+{
+    struct DayEntry* entries;
+    int capacity;       // number of buckets (power of 2)
+    int count;          // number of days stored
+};
+
+// Data type: DayIndex
+// Hash tables of the days that have appointments.  Because appointments
+// are kept sorted, a day's records are one contiguous run: the entry gives
+// the run length and a binary search gives its start.  The entry's bitmap
+// answers whether a slot is taken with one bit test.  Each shard is a
+// table of its own, so adding or dropping a day (which moves entries
+// around its table) only touches days of the same shard.  A zeroed
+// structure is a valid empty index.
+struct DayIndex
+{
+    struct DayShard shards[DAY_INDEX_SHARDS];
+};
+
+
+//////////////////////////////////////
+// PATIENT NUMBER INDEX FUNCTIONS
+//////////////////////////////////////
+
+// Shard of the index a patient number is filed in
+int patientIndexShard(int patientNumber);
+
+// Release the memory held by the index and reset it to empty
+void freePatientIndex(struct PatientIndex* index);
+
+// Find the patient array slot for a patient number (returns -1 if not found)
+int findPatientSlot(const struct PatientIndex* index, int patientNumber);
+
+// Add or update the slot for a patient number (returns 0 if out of memory)
+int insertPatientSlot(struct PatientIndex* index, int patientNumber, int slot);
+
+// Remove a patient number from the index
+void removePatientSlot(struct PatientIndex* index, int patientNumber);
+
+
+//////////////////////////////////////
+// PHONE NUMBER INDEX FUNCTIONS
+//////////////////////////////////////
+
+// Convert a phone number string to an index key (returns 0 for no number)
+long long phoneKey(const char* number);
+
+// Release the memory held by the index and reset it to empty
+void freePhoneIndex(struct PhoneIndex* index);
+
+// Find the first patient slot with a phone key (returns -1 if not found)
+int findPhoneSlot(const struct PhoneIndex* index, long long key);
+
+// Find the next patient slot sharing the same phone key (returns -1 at the end)
+int nextPhoneSlot(const struct PhoneIndex* index, int slot);
+
+// Add a patient slot under a phone key (returns 0 if out of memory)
+int insertPhoneSlot(struct PhoneIndex* index, long long key, int slot);
+
+// Remove a patient slot from under a phone key
+void removePhoneSlot(struct PhoneIndex* index, long long key, int slot);
+
+
+
+//////////////////////////////////////
+// DAY INDEX FUNCTIONS
+//////////////////////////////////////
+
+// Release the memory held by the index and reset it to empty
+void freeDayIndex(struct DayIndex* index);
+
+// Number of appointments booked on a day
+int findDayCount(const struct DayIndex* index, int day);
+
+// Whether a slot of a day is taken (returns 1 if taken)
+int findDaySlot(const struct DayIndex* index, int day, int slot);
+
+// First free slot of a day from "from" up to (not including) "end"
+// (returns -1 if every one is taken)
+int findDayFreeSlot(const struct DayIndex* index, int day, int from, int end);
+
+// Count one more appointment on a day and mark its slot taken
+// (returns 0 if out of memory)
+int addDayCount(struct DayIndex* index, int day, int slot);
+
+// Count one less appointment on a day, dropping the day when it empties;
+// its slot stays taken (see clearDaySlot)
+void removeDayCount(struct DayIndex* index, int day);
+
+// Mark a slot of a day free once no appointment is left in it
+void clearDaySlot(struct DayIndex* index, int day, int slot);
+
+#endif // !INDEX_H
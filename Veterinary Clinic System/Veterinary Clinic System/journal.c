@@ -0,0 +1,573 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "clinic.h"
+#include "import.h"
+#include "journal.h"
+#include "trace.h"
+
+// Longest record line ("P|" + patient line + "#" + checksum + "\n")
+#define JOURNAL_LINE_LEN 128
+
+// Data type: JournalRecord (one parsed journal line)
+struct JournalRecord
+{
+    char op;                    // 'P', 'X', 'A' or 'R'
+    struct PatientEntry patient;    // 'P' record, or the number of an 'X' record
+    struct Appointment appoint; // 'A' and 'R' records
+};
+
+// Data type: JournalReplay (state of openJournal's replay)
+struct JournalReplay
+{
+    struct ClinicData* data;
+    int count;
+};
+
+// When committed records are forced to disk
+static int journalSync = JOURNAL_SYNC_COMMIT;
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Checksum of a record's text (32-bit FNV-1a)
+static unsigned int recordChecksum(const char* text, int length)
+{
+    int i;
+
+    unsigned int hash = 2166136261u;
+
+    for (i = 0; i < length; i++)
+    {
+        hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+// Force the written part of a file to disk (returns 0 if it failed)
+static int syncFile(FILE* fp)
+{
+#ifdef _WIN32
+    return _commit(_fileno(fp)) == 0;
+#else
+    return fsync(fileno(fp)) == 0;
+#endif
+}
+
+// Force a closed file to disk (returns 0 if it failed)
+static int syncPath(const char* path)
+{
+    int result = 0;
+
+    FILE* fp = fopen(path, "ab");
+
+    if (fp != NULL)
+    {
+        result = syncFile(fp);
+        fclose(fp);
+    }
+
+    return result;
+}
+
+// Put a file in place of another in one step (returns 0 if it failed)
+static int replaceFile(const char* from, const char* to)
+{
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(from, to) == 0;
+#endif
+}
+
+// Last byte of a file (returns '\n' for an empty or missing file)
+static int lastFileByte(const char* path)
+{
+    int last = '\n';
+
+    FILE* fp = fopen(path, "rb");
+
+    if (fp != NULL)
+    {
+        if (fseek(fp, -1, SEEK_END) == 0)
+        {
+            last = fgetc(fp);
+        }
+        fclose(fp);
+    }
+
+    return last;
+}
+
+// Write the gathered records to the journal file (returns 0 if it failed)
+static int writeJournalBuffer(struct Journal* journal)
+{
+    if (journal->used && !journal->failed)
+    {
+        if (fwrite(journal->buffer, 1, journal->used, journal->fp) != (size_t)journal->used ||
+            fflush(journal->fp) != 0)
+        {
+            fprintf(stderr, "ERROR: %s could not be written, changes are not being saved!\n",
+                    journal->journalFile);
+            journal->failed = 1;
+        }
+        else
+        {
+            journal->size += journal->used;
+        }
+    }
+
+    journal->used = 0;
+
+    return !journal->failed;
+}
+
+// Add a record to the journal buffer, writing the buffer out first if the
+// record does not fit
+static void appendRecord(struct Journal* journal, char op, const char* payload)
+{
+    int length;
+
+    char line[JOURNAL_LINE_LEN];
+
+    if (journal->fp != NULL)
+    {
+        length = sprintf(line, "%c|%s", op, payload);
+        length += sprintf(line + length, "#%08x\n", recordChecksum(line, length));
+
+        if (journal->used + length > JOURNAL_BUFFER_SIZE)
+        {
+            writeJournalBuffer(journal);
+        }
+
+        memcpy(journal->buffer + journal->used, line, length);
+        journal->used += length;
+    }
+}
+
+
+//////////////////////////////////////
+// REPLAY FUNCTIONS
+//////////////////////////////////////
+
+// Parse a journal line into a struct JournalRecord
+// (returns 0 and points "error" at the reason when the line is malformed)
+static int parseJournalLine(const char* line, int length, void* record, const char** error)
+{
+    int i, hashAt, number;
+
+    unsigned int checksum = 0;
+
+    struct JournalRecord* entry = record;
+
+    const char* payload = line + 2;
+
+    *error = NULL;
+
+    // The checksum follows the last '#'; a record cut short loses it
+    for (hashAt = length - 1; hashAt >= 0 && line[hashAt] != '#'; hashAt--)
+    {
+        ;
+    }
+
+    if (hashAt < 2 || line[1] != '|' || length - hashAt - 1 != 8)
+    {
+        *error = "journal record is incomplete";
+    }
+    else
+    {
+        for (i = hashAt + 1; i < length && *error == NULL; i++)
+        {
+            if (line[i] >= '0' && line[i] <= '9')
+            {
+                checksum = checksum * 16 + (line[i] - '0');
+            }
+            else if (line[i] >= 'a' && line[i] <= 'f')
+            {
+                checksum = checksum * 16 + (line[i] - 'a' + 10);
+            }
+            else
+            {
+                *error = "journal checksum is not hexadecimal";
+            }
+        }
+
+        if (*error == NULL && checksum != recordChecksum(line, hashAt))
+        {
+            *error = "journal checksum does not match";
+        }
+    }
+
+    if (*error == NULL)
+    {
+        entry->op = line[0];
+        length = hashAt - 2;
+
+        switch (entry->op)
+        {
+        case 'P':
+            parsePatientLine(payload, length, &entry->patient, error);
+            break;
+        case 'X':
+            for (i = 0, number = 0; i < length && i < 9 && payload[i] >= '0' &&
+                 payload[i] <= '9'; i++)
+            {
+                number = number * 10 + (payload[i] - '0');
+            }
+
+            if (i == 0 || i != length)
+            {
+                *error = "patient number is not a number";
+            }
+            entry->patient.patientNumber = number;
+            break;
+        case 'A':
+        case 'R':
+            parseAppointmentLine(payload, length, &entry->appoint, error);
+            break;
+        default:
+            *error = "unknown journal record";
+            break;
+        }
+    }
+
+    return *error == NULL;
+}
+
+// Import callback: apply one journal record to the tables and indexes
+// (returns 0 if out of memory)
+static int applyJournalRecord(void* context, const void* record)
+{
+    int slot, pos, result = 1;
+
+    struct JournalReplay* replay = context;
+    struct ClinicData* data = replay->data;
+    struct Patient patient;
+    struct Patient packed = { 0 };
+
+    const struct JournalRecord* entry = record;
+
+    switch (entry->op)
+    {
+    case 'P':
+        slot = findPatientSlot(&data->patientIndex, entry->patient.patientNumber);
+
+        if (!packPatient(data, &entry->patient, &packed))
+        {
+            result = 0;
+        }
+        else if (slot != -1)
+        {
+            readPatient(data, slot, &patient);
+            removePhoneSlot(&data->phoneIndex, phoneNumberKey(&patient.phone), slot);
+            writePatient(data, slot, &packed);
+            result = insertPhoneSlot(&data->phoneIndex, phoneNumberKey(&packed.phone), slot);
+        }
+        else if ((slot = allocPatientSlot(data)) != -1)
+        {
+            writePatient(data, slot, &packed);
+            notePatientNumber(data, packed.patientNumber);
+
+            result = insertPatientSlot(&data->patientIndex, packed.patientNumber, slot) &&
+                     insertPhoneSlot(&data->phoneIndex, phoneNumberKey(&packed.phone), slot);
+        }
+        else
+        {
+            result = 0;
+        }
+        break;
+    case 'X':
+        slot = findPatientSlot(&data->patientIndex, entry->patient.patientNumber);
+
+        if (slot != -1)
+        {
+            readPatient(data, slot, &patient);
+            removePatientSlot(&data->patientIndex, entry->patient.patientNumber);
+            removePhoneSlot(&data->phoneIndex, phoneNumberKey(&patient.phone), slot);
+            clearPatientSlot(data, slot);
+        }
+        break;
+    case 'A':
+        if (findExactAppointment(data, &entry->appoint) == -1)
+        {
+            result = insertAppointment(data, &entry->appoint) != -1;
+        }
+        break;
+    case 'R':
+        pos = findExactAppointment(data, &entry->appoint);
+
+        if (pos != -1)
+        {
+            deleteAppointment(data, pos);
+        }
+        break;
+    }
+
+    if (result)
+    {
+        replay->count++;
+    }
+    else
+    {
+        fprintf(stderr, "ERROR: Out of memory, journal replay stopped!\n");
+    }
+
+    return result;
+}
+
+
+//////////////////////////////////////
+// JOURNAL FUNCTIONS
+//////////////////////////////////////
+
+// Set when committed records are forced to disk (JOURNAL_SYNC_...)
+void setJournalSync(int policy)
+{
+    journalSync = policy;
+}
+
+// Replay the journal into the imported data and open it to record further
+// changes; a checkpoint rewrites the two data files (returns # of records
+// replayed or -1 if the journal could not be opened)
+int openJournal(struct ClinicData* data, const char* journalFile,
+                const char* patientFile, const char* appointFile)
+{
+    struct Journal* journal = &data->journal;
+    struct Journal empty = { 0 };
+    struct JournalReplay replay = { 0 };
+
+    traceBegin(__func__);
+
+    replay.data = data;
+
+    importRecords(journalFile, sizeof(struct JournalRecord), parseJournalLine,
+                  applyJournalRecord, &replay);
+
+    *journal = empty;
+    journal->journalFile = journalFile;
+    journal->patientFile = patientFile;
+    journal->appointFile = appointFile;
+    journal->lastSync = time(NULL);
+
+    // A record cut short by a crash is ended so the next one starts on its own line
+    if (lastFileByte(journalFile) != '\n')
+    {
+        journal->used = 1;
+    }
+
+    journal->buffer = malloc(JOURNAL_BUFFER_SIZE);
+    journal->fp = journal->buffer != NULL ? fopen(journalFile, "ab") : NULL;
+
+    if (journal->fp != NULL)
+    {
+        journal->buffer[0] = '\n';
+
+        fseek(journal->fp, 0, SEEK_END);
+        journal->size = ftell(journal->fp);
+    }
+    else
+    {
+        free(journal->buffer);
+        *journal = empty;
+        replay.count = -1;
+    }
+
+    traceEnd(__func__);
+
+    return replay.count;
+}
+
+// Commit, checkpoint and close the journal
+void closeJournal(struct ClinicData* data)
+{
+    struct Journal* journal = &data->journal;
+    struct Journal empty = { 0 };
+
+    traceBegin(__func__);
+
+    if (journal->fp != NULL)
+    {
+        commitJournal(data);
+        checkpointJournal(data);
+
+        if (journal->fp != NULL)
+        {
+            fclose(journal->fp);
+        }
+        free(journal->buffer);
+    }
+
+    traceEnd(__func__);
+
+    *journal = empty;
+}
+
+// Write the records gathered since the last commit in one append, forcing
+// them to disk as the sync policy asks (returns 0 if the write failed)
+int commitJournal(struct ClinicData* data)
+{
+    int pending;
+
+    time_t now;
+
+    struct Journal* journal = &data->journal;
+
+    traceBegin(__func__);
+
+    if (journal->fp != NULL)
+    {
+        pending = journal->used > 0;
+
+        if (writeJournalBuffer(journal) && pending && journalSync != JOURNAL_SYNC_NONE)
+        {
+            now = time(NULL);
+
+            if (journalSync == JOURNAL_SYNC_COMMIT ||
+                difftime(now, journal->lastSync) >= JOURNAL_SYNC_SECONDS)
+            {
+                if (!syncFile(journal->fp))
+                {
+                    fprintf(stderr, "ERROR: %s could not be synced to disk!\n",
+                            journal->journalFile);
+                }
+                journal->lastSync = now;
+            }
+        }
+
+        if (journal->size > JOURNAL_CHECKPOINT_SIZE)
+        {
+            checkpointJournal(data);
+        }
+    }
+
+    traceEnd(__func__);
+
+    return !journal->failed;
+}
+
+// Rewrite the data files from the tables and empty the journal
+// (returns 0 if a file could not be written)
+int checkpointJournal(struct ClinicData* data)
+{
+    int result = 1;
+
+    char patientTemp[FILENAME_MAX];
+    char appointTemp[FILENAME_MAX];
+
+    struct Journal* journal = &data->journal;
+
+    traceBegin(__func__);
+
+    if (journal->fp != NULL)
+    {
+        writeJournalBuffer(journal);
+
+        sprintf(patientTemp, "%.*s.tmp", FILENAME_MAX - 5, journal->patientFile);
+        sprintf(appointTemp, "%.*s.tmp", FILENAME_MAX - 5, journal->appointFile);
+
+        // Until both data files are on disk the journal still holds the
+        // changes, and replaying them over the new files changes nothing
+        result = exportPatients(patientTemp, data) != -1 && syncPath(patientTemp) &&
+                 exportAppointments(appointTemp, data) != -1 && syncPath(appointTemp) &&
+                 replaceFile(patientTemp, journal->patientFile) &&
+                 replaceFile(appointTemp, journal->appointFile);
+
+        if (result)
+        {
+            fclose(journal->fp);
+            journal->fp = fopen(journal->journalFile, "wb");
+            journal->size = 0;
+
+            if (journal->fp == NULL)
+            {
+                fprintf(stderr, "ERROR: %s could not be reopened, changes are not being saved!\n",
+                        journal->journalFile);
+                free(journal->buffer);
+                journal->buffer = NULL;
+                journal->used = 0;
+            }
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Checkpoint failed, the data files were not updated!\n");
+            remove(patientTemp);
+            remove(appointTemp);
+        }
+    }
+
+    traceEnd(__func__);
+
+    return result;
+}
+
+// Record a new or edited patient
+void journalPatient(struct ClinicData* data, const struct Patient* patient)
+{
+    char payload[JOURNAL_LINE_LEN];
+    char number[PHONE_LEN + 1];
+
+    phoneNumber(&patient->phone, number);
+
+    sprintf(payload, "%d|%s|%s|%s", patient->patientNumber, patientName(data, patient),
+            phoneDescription(&patient->phone), number);
+
+    appendRecord(&data->journal, 'P', payload);
+}
+
+// Record a removed patient
+void journalPatientRemoval(struct ClinicData* data, int patientNumber)
+{
+    char payload[JOURNAL_LINE_LEN];
+
+    sprintf(payload, "%d", patientNumber);
+
+    appendRecord(&data->journal, 'X', payload);
+}
+
+// Record a new appointment
+void journalAppointment(struct ClinicData* data, const struct Appointment* appoint)
+{
+    char payload[JOURNAL_LINE_LEN];
+
+    struct Date date;
+    struct Time time;
+
+    appointmentDate(appoint, &date);
+    appointmentTime(appoint, &time);
+
+    sprintf(payload, "%d,%d,%d,%d,%d,%d", appoint->patientNumber, date.year, date.month,
+            date.day, time.hour, time.min);
+
+    appendRecord(&data->journal, 'A', payload);
+}
+
+// Record a removed appointment
+void journalAppointmentRemoval(struct ClinicData* data, const struct Appointment* appoint)
+{
+    char payload[JOURNAL_LINE_LEN];
+
+    struct Date date;
+    struct Time time;
+
+    appointmentDate(appoint, &date);
+    appointmentTime(appoint, &time);
+
+    sprintf(payload, "%d,%d,%d,%d,%d,%d", appoint->patientNumber, date.year, date.month,
+            date.day, time.hour, time.min);
+
+    appendRecord(&data->journal, 'R', payload);
+}
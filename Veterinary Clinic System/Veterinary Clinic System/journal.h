@@ -0,0 +1,90 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdio.h>
+#include <time.h>
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// When committed records are forced to disk
+#define JOURNAL_SYNC_NONE 0         // left to the operating system
+#define JOURNAL_SYNC_COMMIT 1       // on every commit
+#define JOURNAL_SYNC_INTERVAL 2     // at most once every JOURNAL_SYNC_SECONDS
+
+#define JOURNAL_SYNC_SECONDS 1
+
+// Records are gathered in memory and written by one append per commit
+#define JOURNAL_BUFFER_SIZE (64 * 1024)
+
+// A commit that leaves the journal larger than this checkpoints it
+#define JOURNAL_CHECKPOINT_SIZE (16 * 1024 * 1024)
+
+//////////////////////////////////////
+// Structures
+//////////////////////////////////////
+
+struct ClinicData;
+struct Patient;
+struct Appointment;
+
+// Data type: Journal
+// Append-only log of the changes made since the data files were last
+// written.  Every change adds one text record ("P" patient stored, "X"
+// patient removed, "A" appointment added, "R" appointment removed) ending
+// in a checksum.  Replaying a record sets the final state of its patient
+// or appointment, so records already in the data files can be replayed
+// again safely.  A zeroed structure is a closed journal that ignores
+// every change.
+struct Journal
+{
+    FILE* fp;
+    const char* journalFile;
+    const char* patientFile;    // data files a checkpoint rewrites
+    const char* appointFile;
+    char* buffer;               // records not yet committed
+    int used;
+    long long size;             // bytes in the journal file
+    time_t lastSync;
+    int failed;                 // set once a write has failed
+};
+
+
+//////////////////////////////////////
+// JOURNAL FUNCTIONS
+//////////////////////////////////////
+
+// Set when committed records are forced to disk (JOURNAL_SYNC_...)
+void setJournalSync(int policy);
+
+// Replay the journal into the imported data and open it to record further
+// changes; a checkpoint rewrites the two data files (returns # of records
+// replayed or -1 if the journal could not be opened)
+int openJournal(struct ClinicData* data, const char* journalFile,
+                const char* patientFile, const char* appointFile);
+
+// Commit, checkpoint and close the journal
+void closeJournal(struct ClinicData* data);
+
+// Write the records gathered since the last commit in one append, forcing
+// them to disk as the sync policy asks (returns 0 if the write failed)
+int commitJournal(struct ClinicData* data);
+
+// Rewrite the data files from the tables and empty the journal
+// (returns 0 if a file could not be written)
+int checkpointJournal(struct ClinicData* data);
+
+// Record a new or edited patient
+void journalPatient(struct ClinicData* data, const struct Patient* patient);
+
+// Record a removed patient
+void journalPatientRemoval(struct ClinicData* data, int patientNumber);
+
+// Record a new appointment
+void journalAppointment(struct ClinicData* data, const struct Appointment* appoint);
+
+// Record a removed appointment
+void journalAppointmentRemoval(struct ClinicData* data, const struct Appointment* appoint);
+
+#endif // !JOURNAL_H
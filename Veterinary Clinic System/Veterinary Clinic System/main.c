@@ -1,23 +1,274 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "batch.h"
 #include "clinic.h"
+#include "desk.h"
+#include "import.h"
+#include "replay.h"
+#include "stats.h"
+#include "trace.h"
 
-#define MAX_PETS 20
-#define MAX_APPOINTMENTS 50
-
-int main(void)
+int main(int argc, char* argv[])
 {
-    struct Patient pets[MAX_PETS] = { {0} };
-    struct Appointment appoints[MAX_APPOINTMENTS] = { {0} };
-    struct ClinicData data = { pets, MAX_PETS, appoints, MAX_APPOINTMENTS };
+    struct ClinicData data = { 0 };
+
+    struct FrontDesk desk;
+
+    int patientCount, appointmentCount, journalCount, batchCount, failed, difference;
+
+    int imageState = -1;
+
+    int status = 0;
+
+    FILE* out = stdout;
+
+    const char* threads = getenv("CLINIC_IMPORT_THREADS");
+    const char* sync = getenv("CLINIC_JOURNAL_SYNC");
+    const char* image = getenv("CLINIC_IMAGE");
+    const char* layout = getenv("CLINIC_STORE_LAYOUT");
+    const char* record = getenv("CLINIC_RECORD");
+    const char* statsFile = getenv("CLINIC_STATS_FILE");
+    const char* traceFile = getenv("CLINIC_TRACE_FILE");
+    const char* traceSeconds = getenv("CLINIC_TRACE_SECONDS");
+    const char* command = argc > 1 ? argv[1] : "";
+
+    // A replay does not open the journal, so the data files keep none of
+    // its changes (a mapped image does keep them: replay on a copy)
+    int replay = strcmp(command, "--replay") == 0 && argc > 3;
+
+    // Threads that parse the data files (unset or 0: one per processor)
+    if (threads != NULL)
+    {
+        setImportThreads(atoi(threads));
+    }
+
+    // When journal commits are forced to disk (0: never, 1: every commit,
+    // 2: at most once a second; unset: every commit)
+    if (sync != NULL)
+    {
+        setJournalSync(atoi(sync));
+    }
+
+    // With CLINIC_TRACE_FILE set the start and end of each operation are
+    // recorded, and the events of the last CLINIC_TRACE_SECONDS seconds
+    // (unset: as many as the rings hold) are written to that file in the
+    // Chrome trace format on exit and by main menu item STATS_MENU_ITEM
+    if (traceFile != NULL &&
+        !startTrace(traceFile, traceSeconds != NULL ? atof(traceSeconds) : 0.0))
+    {
+        printf("WARNING: Tracing is not compiled in!\n");
+    }
+
+    // How new table blocks lay out their records ("columns": one array per
+    // field for faster whole-table scans; unset: one record after another)
+    if (layout != NULL && strcmp(layout, "columns") == 0)
+    {
+        setStoreLayout(STORE_COLUMNS);
+    }
+
+    // With CLINIC_IMAGE set the tables live in that memory-mapped file;
+    // "--import-text" rebuilds it from the data files and "--export-text"
+    // writes the data files from it
+    if (image != NULL)
+    {
+        if (strcmp(command, "--import-text") == 0)
+        {
+            remove(image);
+        }
+
+        imageState = openClinicImage(&data, image);
+
+        if (imageState == -1)
+        {
+            return 1;
+        }
+    }
+
+    if (imageState == 1)
+    {
+        printf("Mapped %d patient records...\n", data.patients.liveCount);
+        printf("Mapped %d appointment records...\n", data.appointments.count);
+    }
+    else
+    {
+        patientCount = importPatients("patientData.txt", &data);
+        appointmentCount = importAppointments("appointmentData.txt", &data);
+
+        printf("Imported %d patient records...\n", patientCount);
+        printf("Imported %d appointment records...\n", appointmentCount);
+    }
+
+    if (imageState == -1 && !replay)
+    {
+        // Changes made since the data files were last written are replayed
+        // from the journal, which then records this session's changes
+        journalCount = openJournal(&data, "clinicJournal.txt", "patientData.txt",
+                                   "appointmentData.txt");
+
+        if (journalCount > 0)
+        {
+            printf("Replayed %d journal records...\n", journalCount);
+        }
+        else if (journalCount == -1)
+        {
+            printf("WARNING: The journal could not be opened, changes will not be saved!\n");
+        }
+    }
+    putchar('\n');
+
+    if (image != NULL && strcmp(command, "--export-text") == 0)
+    {
+        if (exportPatients("patientData.txt", &data) == -1 ||
+            exportAppointments("appointmentData.txt", &data) == -1)
+        {
+            printf("ERROR: The data files could not be written!\n");
+        }
+    }
+    else if (!command[0])
+    {
+        // With CLINIC_RECORD set everything typed is also written to that
+        // session file, for "--replay"
+        if (record != NULL && !recordInput(record))
+        {
+            printf("WARNING: The session could not be recorded!\n\n");
+        }
+
+        menuMain(&data);
+    }
+    else if (replay)
+    {
+        // "--replay <session> <transcript> [golden]" runs the menus on a
+        // recorded session at full speed, writing the screen to the
+        // transcript, then times each menu action and compares the
+        // transcript with the golden one (a transcript of an earlier replay)
+        if (freopen(argv[2], "r", stdin) == NULL)
+        {
+            printf("ERROR: The session file %s could not be opened!\n", argv[2]);
+            status = 1;
+        }
+        else if (freopen(argv[3], "w", stdout) == NULL)
+        {
+            fprintf(stderr, "ERROR: The transcript file %s could not be opened!\n", argv[3]);
+            status = 1;
+        }
+        else
+        {
+            menuMain(&data);
+            fflush(stdout);
+
+            reportActions(stderr);
+
+            if (argc > 4)
+            {
+                difference = compareTranscripts(argv[3], argv[4], stderr);
+
+                if (difference == -1)
+                {
+                    fprintf(stderr, "ERROR: The golden transcript %s could not be read!\n",
+                            argv[4]);
+                }
+                else if (!difference)
+                {
+                    fprintf(stderr, "Transcript matches %s\n", argv[4]);
+                }
+
+                status = difference != 0;
+            }
+        }
+    }
+    else if (strcmp(command, "--batch") == 0 && argc > 2)
+    {
+        // "--batch <command file or -> [result file]" runs commands without
+        // the menus, one result line each (to stdout unless a file is named)
+        if (argc > 3 && (out = fopen(argv[3], "w")) == NULL)
+        {
+            printf("ERROR: The result file %s could not be opened!\n", argv[3]);
+            status = 1;
+        }
+        else if (!openFrontDesk(&desk, &data))
+        {
+            printf("ERROR: Out of memory!\n");
+            status = 1;
+        }
+        else
+        {
+            if ((batchCount = runBatch(&desk, argv[2], out, &failed)) == -1)
+            {
+                printf("ERROR: The command file %s could not be opened!\n", argv[2]);
+                status = 1;
+            }
+            else
+            {
+                printf("Ran %d batch commands (%d failed)...\n", batchCount, failed);
+                status = failed != 0;
+            }
+
+            closeFrontDesk(&desk);
+        }
+
+        if (out != NULL && out != stdout)
+        {
+            fclose(out);
+        }
+    }
+    else if (strcmp(command, "--desks") == 0 && argc > 2)
+    {
+        // "--desks <command file>..." runs several command files at once,
+        // each on its own thread as if at its own front desk, writing the
+        // results of each to <command file>.results
+        if (!openFrontDesk(&desk, &data))
+        {
+            printf("ERROR: Out of memory!\n");
+            status = 1;
+        }
+        else
+        {
+            if ((batchCount = runBatchDesks(&desk, argv + 2, argc - 2, &failed)) == -1)
+            {
+                printf("ERROR: A command file or its result file could not be opened!\n");
+                status = 1;
+            }
+            else
+            {
+                printf("Ran %d batch commands at %d desks (%d failed)...\n", batchCount,
+                       argc - 2, failed);
+                status = failed != 0;
+            }
+
+            closeFrontDesk(&desk);
+        }
+    }
+    else if (image == NULL &&
+             (strcmp(command, "--import-text") == 0 || strcmp(command, "--export-text") == 0))
+    {
+        printf("ERROR: %s needs CLINIC_IMAGE to name the image\n", command);
+        status = 1;
+    }
+    else if (strcmp(command, "--import-text") != 0)
+    {
+        printf("ERROR: Unknown command %s\n", command);
+        status = 1;
+    }
+
+    // With CLINIC_STATS_FILE set the operation statistics (main menu item
+    // STATS_MENU_ITEM) are also written to that file on exit
+    if (statsFile != NULL && !writeStats(statsFile))
+    {
+        fprintf(stderr, "WARNING: The statistics could not be written to %s!\n", statsFile);
+    }
+
+    // Writes the data files and empties the journal
+    closeJournal(&data);
 
-    int patientCount = importPatients("patientData.txt", pets, MAX_PETS);
-    int appointmentCount = importAppointments("appointmentData.txt", appoints, MAX_APPOINTMENTS);
+    if (traceFile != NULL && flushTrace() == -1)
+    {
+        fprintf(stderr, "WARNING: The trace could not be written to %s!\n", traceFile);
+    }
 
-    printf("Imported %d patient records...\n", patientCount);
-    printf("Imported %d appointment records...\n\n", appointmentCount);
+    // A mapped clinic is written back to its image
+    freeClinicData(&data);
 
-    menuMain(&data);
-    
-    return 0;
-}
\ No newline at end of file
+    return status;
+}
@@ -0,0 +1,164 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200809L
+#define _FILE_OFFSET_BITS 64
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapfile.h"
+
+
+//////////////////////////////////////
+// MAPPED FILE FUNCTIONS
+//////////////////////////////////////
+
+// Open a file for mapping, creating it empty if missing (returns 0 if it failed)
+int openMappedFile(struct MappedFile* file, const char* path)
+{
+#ifdef _WIN32
+    LARGE_INTEGER size;
+
+    HANDLE handle = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                                OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    file->handle = NULL;
+
+    if (handle != INVALID_HANDLE_VALUE)
+    {
+        if (GetFileSizeEx(handle, &size))
+        {
+            file->handle = handle;
+            file->size = size.QuadPart;
+        }
+        else
+        {
+            CloseHandle(handle);
+        }
+    }
+#else
+    struct stat info;
+
+    int* fd = malloc(sizeof(int));
+
+    file->handle = NULL;
+
+    if (fd != NULL)
+    {
+        *fd = open(path, O_RDWR | O_CREAT, 0644);
+
+        if (*fd != -1 && fstat(*fd, &info) == 0)
+        {
+            file->handle = fd;
+            file->size = info.st_size;
+        }
+        else
+        {
+            if (*fd != -1)
+            {
+                close(*fd);
+            }
+            free(fd);
+        }
+    }
+#endif
+
+    return file->handle != NULL;
+}
+
+// Grow or shrink the file (returns 0 if it failed)
+int resizeMappedFile(struct MappedFile* file, long long size)
+{
+    int result;
+
+#ifdef _WIN32
+    LARGE_INTEGER position;
+
+    position.QuadPart = size;
+    result = SetFilePointerEx(file->handle, position, NULL, FILE_BEGIN) &&
+             SetEndOfFile(file->handle);
+#else
+    result = ftruncate(*(int*)file->handle, (off_t)size) == 0;
+#endif
+
+    if (result)
+    {
+        file->size = size;
+    }
+
+    return result;
+}
+
+// Map a range of the file for reading and writing (returns NULL if it failed)
+void* mapFileRange(struct MappedFile* file, long long offset, size_t length)
+{
+    void* address = NULL;
+
+#ifdef _WIN32
+    // The view keeps the mapping alive once its handle is closed
+    HANDLE mapping = CreateFileMappingA(file->handle, NULL, PAGE_READWRITE, 0, 0, NULL);
+
+    if (mapping != NULL)
+    {
+        address = MapViewOfFile(mapping, FILE_MAP_WRITE, (DWORD)(offset >> 32),
+                                (DWORD)(offset & 0xffffffff), length);
+        CloseHandle(mapping);
+    }
+#else
+    address = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, *(int*)file->handle,
+                   (off_t)offset);
+
+    if (address == MAP_FAILED)
+    {
+        address = NULL;
+    }
+#endif
+
+    return address;
+}
+
+// Unmap a range returned by mapFileRange
+void unmapFileRange(void* address, size_t length)
+{
+#ifdef _WIN32
+    (void)length;
+    UnmapViewOfFile(address);
+#else
+    munmap(address, length);
+#endif
+}
+
+// Write a mapped range back to the file and wait for it to reach the disk
+// (returns 0 if it failed)
+int syncFileRange(struct MappedFile* file, void* address, size_t length)
+{
+#ifdef _WIN32
+    return FlushViewOfFile(address, length) && FlushFileBuffers(file->handle);
+#else
+    (void)file;
+    return msync(address, length, MS_SYNC) == 0;
+#endif
+}
+
+// Close the file (every range must be unmapped first)
+void closeMappedFile(struct MappedFile* file)
+{
+    if (file->handle != NULL)
+    {
+#ifdef _WIN32
+        CloseHandle(file->handle);
+#else
+        close(*(int*)file->handle);
+        free(file->handle);
+#endif
+        file->handle = NULL;
+        file->size = 0;
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stddef.h>
+
+//////////////////////////////////////
+// Structures
+//////////////////////////////////////
+
+// Data type: MappedFile
+// A file opened for shared read/write mapping; Windows file mappings under
+// MSVC and POSIX mmap elsewhere.  Mapped ranges must start at a multiple of
+// 64 KB.  A zeroed structure is a closed file.
+struct MappedFile
+{
+    void* handle;       // platform file handle (owned by mapfile.c)
+    long long size;     // current file size in bytes
+};
+
+
+//////////////////////////////////////
+// MAPPED FILE FUNCTIONS
+//////////////////////////////////////
+
+// Open a file for mapping, creating it empty if missing (returns 0 if it failed)
+int openMappedFile(struct MappedFile* file, const char* path);
+
+// Grow or shrink the file (returns 0 if it failed)
+int resizeMappedFile(struct MappedFile* file, long long size);
+
+// Map a range of the file for reading and writing (returns NULL if it failed)
+void* mapFileRange(struct MappedFile* file, long long offset, size_t length);
+
+// Unmap a range returned by mapFileRange
+void unmapFileRange(void* address, size_t length);
+
+// Write a mapped range back to the file and wait for it to reach the disk
+// (returns 0 if it failed)
+int syncFileRange(struct MappedFile* file, void* address, size_t length);
+
+// Close the file (every range must be unmapped first)
+void closeMappedFile(struct MappedFile* file);
+
+#endif // !MAPFILE_H
@@ -0,0 +1,257 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#define pipe(fds) _pipe(fds, REPLAY_PIPE_SIZE, _O_BINARY)
+#define dup _dup
+#define dup2 _dup2
+#define read _read
+#define write _write
+#define close _close
+#else
+#include <unistd.h>
+#endif
+
+#include "replay.h"
+#include "thread.h"
+
+// Data type: ActionTiming (the runs of one menu action)
+struct ActionTiming
+{
+    long long count;
+    long long totalNs;
+    long long maxNs;
+};
+
+// Data type: InputTee
+// Standard input as typed (a duplicate of the original descriptor), the
+// pipe the program now reads as standard input and the session file
+struct InputTee
+{
+    int from;
+    int to;
+    FILE* record;
+};
+
+// Function names of the menu actions (enum MenuAction)
+static const char* const actionNames[] =
+{
+    "displayAllPatients", "searchPatientByPatientNumber", "searchPatientByPhoneNumber",
+    "addPatient", "editPatient", "removePatient", "viewAllAppointments",
+    "viewAppointmentSchedule", "addAppointment", "removeAppointment"
+};
+
+static struct ActionTiming timings[ACTION_COUNT];
+
+static struct InputTee tee;
+static struct Thread teeThread;
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Thread: copy standard input to the session file and the pipe until it
+// ends, then close the pipe so the program sees the end of its input
+static void copyInput(void* arg)
+{
+    int length, written, done;
+
+    char buffer[REPLAY_PIPE_SIZE];
+
+    struct InputTee* input = arg;
+
+    while ((length = (int)read(input->from, buffer, sizeof(buffer))) > 0)
+    {
+        fwrite(buffer, 1, length, input->record);
+        fflush(input->record);
+
+        for (done = 0; done < length; done += written)
+        {
+            if ((written = (int)write(input->to, buffer + done, length - done)) <= 0)
+            {
+                written = length - done;
+            }
+        }
+    }
+
+    fclose(input->record);
+    close(input->to);
+}
+
+// Read the next line of a transcript, without its newline, into "line"
+// (returns 0 at the end of the file)
+static int readTranscriptLine(FILE* fp, char* line)
+{
+    int c, length = 0;
+
+    while ((c = fgetc(fp)) != EOF && c != '\n')
+    {
+        if (length < REPLAY_LINE_LEN)
+        {
+            line[length++] = (char)c;
+        }
+    }
+    line[length] = '\0';
+
+    return c != EOF || length > 0;
+}
+
+
+//////////////////////////////////////
+// ACTION TIMING FUNCTIONS
+//////////////////////////////////////
+
+// Current time in nanoseconds, to start timing an action
+long long actionClock(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Count an action that started at "start" (an actionClock time)
+void finishAction(enum MenuAction action, long long start)
+{
+    long long elapsed = actionClock() - start;
+
+    struct ActionTiming* timing = &timings[action];
+
+    timing->count++;
+    timing->totalNs += elapsed;
+
+    if (elapsed > timing->maxNs)
+    {
+        timing->maxNs = elapsed;
+    }
+}
+
+// Write the count, mean, slowest and total time of every action run
+void reportActions(FILE* fp)
+{
+    int i;
+
+    fprintf(fp, "Action                       Count     Mean (us)   Max (us)    Total (ms)\n"
+                "---------------------------- --------- ----------- ----------- -----------\n");
+
+    for (i = 0; i < ACTION_COUNT; i++)
+    {
+        if (timings[i].count)
+        {
+            fprintf(fp, "%-28s %9lld %11.1f %11.1f %11.2f\n", actionNames[i], timings[i].count,
+                    timings[i].totalNs / 1e3 / timings[i].count, timings[i].maxNs / 1e3,
+                    timings[i].totalNs / 1e6);
+        }
+    }
+}
+
+
+//////////////////////////////////////
+// SESSION FUNCTIONS
+//////////////////////////////////////
+
+// Copy everything typed on standard input to a session file as the
+// program reads it, so the session can be replayed later by feeding the
+// file to the menus (returns 0 if the input could not be redirected)
+int recordInput(const char* sessionFile)
+{
+    int fds[2], result = 0;
+
+    tee.record = fopen(sessionFile, "w");
+
+    if (tee.record != NULL && pipe(fds) == 0)
+    {
+        tee.from = dup(0);
+        tee.to = fds[1];
+
+        // Standard input becomes the pipe; nothing has been read from it
+        // yet, so no typed input is left behind in its buffer
+        if (tee.from != -1 && dup2(fds[0], 0) != -1)
+        {
+            result = startThread(&teeThread, copyInput, &tee);
+
+            if (!result)
+            {
+                dup2(tee.from, 0);
+            }
+        }
+
+        close(fds[0]);
+
+        if (!result)
+        {
+            close(fds[1]);
+
+            if (tee.from != -1)
+            {
+                close(tee.from);
+            }
+        }
+    }
+
+    if (!result && tee.record != NULL)
+    {
+        fclose(tee.record);
+    }
+
+    return result;
+}
+
+// Compare a replay's transcript with a golden one, writing the first
+// difference to "out" (returns 0 if they are the same, the line number of
+// the first difference or -1 if a file could not be read)
+int compareTranscripts(const char* transcriptFile, const char* goldenFile, FILE* out)
+{
+    int more, goldenMore, line = 0, result = -1;
+
+    char text[REPLAY_LINE_LEN + 1];
+    char golden[REPLAY_LINE_LEN + 1];
+
+    FILE* fp = fopen(transcriptFile, "r");
+    FILE* goldenFp = fopen(goldenFile, "r");
+
+    if (fp != NULL && goldenFp != NULL)
+    {
+        result = 0;
+
+        do
+        {
+            line++;
+            more = readTranscriptLine(fp, text);
+            goldenMore = readTranscriptLine(goldenFp, golden);
+
+            if (more != goldenMore || strcmp(text, golden) != 0)
+            {
+                result = line;
+            }
+        } while (more && goldenMore && !result);
+
+        if (result)
+        {
+            fprintf(out, "Transcript differs from %s at line %d:\n"
+                         "  expected: %s\n"
+                         "  replayed: %s\n", goldenFile, result,
+                    goldenMore ? golden : "<end of transcript>",
+                    more ? text : "<end of transcript>");
+        }
+    }
+
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+    if (goldenFp != NULL)
+    {
+        fclose(goldenFp);
+    }
+
+    return result;
+}
@@ -0,0 +1,65 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdio.h>
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// Bytes of input copied to the session file at a time
+#define REPLAY_PIPE_SIZE 4096
+
+// Longest transcript line shown when a replay differs from its golden one
+#define REPLAY_LINE_LEN 256
+
+//////////////////////////////////////
+// Enumerations
+//////////////////////////////////////
+
+// Menu actions that are timed (named after the functions the menus call)
+enum MenuAction
+{
+    ACTION_VIEW_PATIENTS,
+    ACTION_SEARCH_BY_NUMBER,
+    ACTION_SEARCH_BY_PHONE,
+    ACTION_ADD_PATIENT,
+    ACTION_EDIT_PATIENT,
+    ACTION_REMOVE_PATIENT,
+    ACTION_VIEW_APPOINTMENTS,
+    ACTION_VIEW_SCHEDULE,
+    ACTION_ADD_APPOINTMENT,
+    ACTION_REMOVE_APPOINTMENT,
+    ACTION_COUNT
+};
+
+
+//////////////////////////////////////
+// ACTION TIMING FUNCTIONS
+//////////////////////////////////////
+
+// Current time in nanoseconds, to start timing an action
+long long actionClock(void);
+
+// Count an action that started at "start" (an actionClock time)
+void finishAction(enum MenuAction action, long long start);
+
+// Write the count, mean, slowest and total time of every action run
+void reportActions(FILE* fp);
+
+
+//////////////////////////////////////
+// SESSION FUNCTIONS
+//////////////////////////////////////
+
+// Copy everything typed on standard input to a session file as the
+// program reads it, so the session can be replayed later by feeding the
+// file to the menus (returns 0 if the input could not be redirected)
+int recordInput(const char* sessionFile);
+
+// Compare a replay's transcript with a golden one, writing the first
+// difference to "out" (returns 0 if they are the same, the line number of
+// the first difference or -1 if a file could not be read)
+int compareTranscripts(const char* transcriptFile, const char* goldenFile, FILE* out);
+
+#endif // !REPLAY_H
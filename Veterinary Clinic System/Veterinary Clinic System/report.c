@@ -0,0 +1,125 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <string.h>
+
+#include "report.h"
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Make room for "length" more bytes, writing the buffer out if needed
+static void reserveReport(struct Report* report, int length)
+{
+    if (report->used + length > REPORT_BUFFER_SIZE)
+    {
+        flushReport(report);
+    }
+}
+
+
+//////////////////////////////////////
+// REPORT FUNCTIONS
+//////////////////////////////////////
+
+// Start an empty report written to a file
+void openReport(struct Report* report, FILE* fp)
+{
+    report->fp = fp;
+    report->used = 0;
+    report->failed = 0;
+}
+
+// Write the buffered text to the file (returns 0 if a write has failed
+// since the report was opened)
+int flushReport(struct Report* report)
+{
+    if (report->used &&
+        fwrite(report->buffer, 1, report->used, report->fp) != (size_t)report->used)
+    {
+        report->failed = 1;
+    }
+    report->used = 0;
+
+    return !report->failed;
+}
+
+// Add a string
+void reportText(struct Report* report, const char* text)
+{
+    int length = (int)strlen(text);
+
+    reserveReport(report, length);
+
+    // Text longer than the whole buffer goes straight to the file
+    if (length > REPORT_BUFFER_SIZE)
+    {
+        if (fwrite(text, 1, length, report->fp) != (size_t)length)
+        {
+            report->failed = 1;
+        }
+    }
+    else
+    {
+        memcpy(report->buffer + report->used, text, length);
+        report->used += length;
+    }
+}
+
+// Add one character
+void reportChar(struct Report* report, char c)
+{
+    reserveReport(report, 1);
+
+    report->buffer[report->used++] = c;
+}
+
+// Add a number zero-padded to at least "width" characters (as "%0*d")
+void reportNumber(struct Report* report, int value, int width)
+{
+    int length = 0, negative = value < 0;
+
+    char digits[16];
+
+    // Digits are produced backwards; the unsigned value covers INT_MIN
+    unsigned int rest = negative ? 0u - (unsigned int)value : (unsigned int)value;
+
+    do
+    {
+        digits[length++] = (char)('0' + rest % 10);
+        rest /= 10;
+    } while (rest);
+
+    // The sign counts towards the width, as with printf
+    while (length + negative < width && length < (int)sizeof(digits))
+    {
+        digits[length++] = '0';
+    }
+
+    reserveReport(report, length + negative);
+
+    if (negative)
+    {
+        report->buffer[report->used++] = '-';
+    }
+
+    while (length)
+    {
+        report->buffer[report->used++] = digits[--length];
+    }
+}
+
+// Add a string space-padded on the right to at least "width" characters
+// (as "%-*s")
+void reportPadded(struct Report* report, const char* text, int width)
+{
+    int length = (int)strlen(text);
+
+    reportText(report, text);
+
+    for (; length < width; length++)
+    {
+        reportChar(report, ' ');
+    }
+}
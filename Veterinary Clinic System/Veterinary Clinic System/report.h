@@ -0,0 +1,54 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// Bytes gathered before a report is written out
+#define REPORT_BUFFER_SIZE (32 * 1024)
+
+//////////////////////////////////////
+// Structures
+//////////////////////////////////////
+
+// Data type: Report
+// Text output formatted into a buffer and written to its file in large
+// blocks.  Anything else written to the file must wait for flushReport,
+// or the two will be out of order.
+struct Report
+{
+    FILE* fp;
+    int used;
+    int failed;                 // set once a write has failed
+    char buffer[REPORT_BUFFER_SIZE];
+};
+
+
+//////////////////////////////////////
+// REPORT FUNCTIONS
+//////////////////////////////////////
+
+// Start an empty report written to a file
+void openReport(struct Report* report, FILE* fp);
+
+// Write the buffered text to the file (returns 0 if a write has failed
+// since the report was opened)
+int flushReport(struct Report* report);
+
+// Add a string
+void reportText(struct Report* report, const char* text);
+
+// Add one character
+void reportChar(struct Report* report, char c);
+
+// Add a number zero-padded to at least "width" characters (as "%0*d")
+void reportNumber(struct Report* report, int value, int width);
+
+// Add a string space-padded on the right to at least "width" characters
+// (as "%-*s")
+void reportPadded(struct Report* report, const char* text, int width);
+
+#endif // !REPORT_H
@@ -0,0 +1,396 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <string.h>
+
+// The vector kernels are compiled for x86 only; each is called only once
+// the processor has been found to support its instruction set
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define SCAN_X86
+#define SCAN_SSE2_FUNCTION
+#define SCAN_AVX2_FUNCTION
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SCAN_X86
+#define SCAN_SSE2_FUNCTION __attribute__((target("sse2")))
+#define SCAN_AVX2_FUNCTION __attribute__((target("avx2")))
+#endif
+
+#include "scan.h"
+
+// Instruction set the kernels use (-1 until first detected)
+static int activeLevel = -1;
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Best instruction set this processor and operating system support
+static int detectScanLevel(void)
+{
+    int level = SCAN_SCALAR;
+
+#if defined(SCAN_X86) && defined(_MSC_VER)
+    int info[4], maxLeaf;
+
+    __cpuid(info, 0);
+    maxLeaf = info[0];
+
+    __cpuid(info, 1);
+
+    if (info[3] & (1 << 26))
+    {
+        level = SCAN_SSE2;
+    }
+
+    // AVX2 also needs the operating system to save the 256-bit registers
+    if (maxLeaf >= 7 && (info[2] & (1 << 27)) && (info[2] & (1 << 28)) &&
+        (_xgetbv(0) & 6) == 6)
+    {
+        __cpuidex(info, 7, 0);
+
+        if (info[1] & (1 << 5))
+        {
+            level = SCAN_AVX2;
+        }
+    }
+#elif defined(SCAN_X86)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+    {
+        level = SCAN_AVX2;
+    }
+    else if (__builtin_cpu_supports("sse2"))
+    {
+        level = SCAN_SSE2;
+    }
+#endif
+
+    return level;
+}
+
+// Number of bits set in a word
+static int bitCount(unsigned long long word)
+{
+    word = word - ((word >> 1) & 0x5555555555555555ull);
+    word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+
+    return (int)((word * 0x0101010101010101ull) >> 56);
+}
+
+// Number of bits set in the selection bitmap of "count" values
+static int bitmapCount(const unsigned long long* bitmap, int count)
+{
+    int i, selected = 0;
+
+    for (i = 0; i < SCAN_BITMAP_WORDS(count); i++)
+    {
+        selected += bitCount(bitmap[i]);
+    }
+
+    return selected;
+}
+
+
+//////////////////////////////////////
+// SCAN KERNELS
+//////////////////////////////////////
+
+// Each kernel tests values[from] onwards as "value - low <= span", one
+// unsigned comparison for the whole range, and ORs the results into the
+// bitmap.  A vector kernel stops before a partial step and returns where
+// it stopped; the scalar kernel finishes the tail.
+
+// Plain C kernel for 32-bit values (each word is gathered in a local, as
+// the bitmap could alias the values for all the compiler knows)
+static void selectRange32Scalar(const unsigned int* values, int from, int count,
+                                unsigned int low, unsigned int span,
+                                unsigned long long* bitmap)
+{
+    int i;
+
+    unsigned long long word = 0;
+
+    for (i = from; i < count; i++)
+    {
+        word |= (unsigned long long)(values[i] - low <= span) << (i % 64);
+
+        if (i % 64 == 63 || i == count - 1)
+        {
+            bitmap[i / 64] |= word;
+            word = 0;
+        }
+    }
+}
+
+// Plain C kernel for 64-bit values
+static void selectRange64Scalar(const unsigned long long* values, int from, int count,
+                                unsigned long long low, unsigned long long span,
+                                unsigned long long* bitmap)
+{
+    int i;
+
+    unsigned long long word = 0;
+
+    for (i = from; i < count; i++)
+    {
+        word |= (unsigned long long)(values[i] - low <= span) << (i % 64);
+
+        if (i % 64 == 63 || i == count - 1)
+        {
+            bitmap[i / 64] |= word;
+            word = 0;
+        }
+    }
+}
+
+#ifdef SCAN_X86
+
+// SSE2 kernel for 32-bit values; SSE2 has only signed comparisons, so both
+// sides are biased by 2^31 first
+SCAN_SSE2_FUNCTION
+static int selectRange32Sse2(const unsigned int* values, int count, unsigned int low,
+                             unsigned int span, unsigned long long* bitmap)
+{
+    int i, outside;
+
+    unsigned long long word = 0;
+
+    const __m128i bias = _mm_set1_epi32((int)0x80000000u);
+    const __m128i lowest = _mm_set1_epi32((int)low);
+    const __m128i limit = _mm_xor_si128(_mm_set1_epi32((int)span), bias);
+
+    __m128i offset;
+
+    for (i = 0; i + 4 <= count; i += 4)
+    {
+        offset = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(values + i)), lowest);
+        outside = _mm_movemask_ps(_mm_castsi128_ps(
+                      _mm_cmpgt_epi32(_mm_xor_si128(offset, bias), limit)));
+
+        word |= (unsigned long long)(~outside & 0xf) << (i % 64);
+
+        if (i % 64 == 60)
+        {
+            bitmap[i / 64] = word;
+            word = 0;
+        }
+    }
+
+    if (i % 64)
+    {
+        bitmap[i / 64] = word;
+    }
+
+    return i;
+}
+
+// AVX2 kernel for 32-bit values
+SCAN_AVX2_FUNCTION
+static int selectRange32Avx2(const unsigned int* values, int count, unsigned int low,
+                             unsigned int span, unsigned long long* bitmap)
+{
+    int i, outside;
+
+    unsigned long long word = 0;
+
+    const __m256i bias = _mm256_set1_epi32((int)0x80000000u);
+    const __m256i lowest = _mm256_set1_epi32((int)low);
+    const __m256i limit = _mm256_xor_si256(_mm256_set1_epi32((int)span), bias);
+
+    __m256i offset;
+
+    for (i = 0; i + 8 <= count; i += 8)
+    {
+        offset = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(values + i)), lowest);
+        outside = _mm256_movemask_ps(_mm256_castsi256_ps(
+                      _mm256_cmpgt_epi32(_mm256_xor_si256(offset, bias), limit)));
+
+        word |= (unsigned long long)(~outside & 0xff) << (i % 64);
+
+        if (i % 64 == 56)
+        {
+            bitmap[i / 64] = word;
+            word = 0;
+        }
+    }
+
+    if (i % 64)
+    {
+        bitmap[i / 64] = word;
+    }
+
+    // Leave the SSE registers clean for code compiled without AVX
+    _mm256_zeroupper();
+
+    return i;
+}
+
+// AVX2 kernel for 64-bit values (SSE2 has no 64-bit comparison)
+SCAN_AVX2_FUNCTION
+static int selectRange64Avx2(const unsigned long long* values, int count,
+                             unsigned long long low, unsigned long long span,
+                             unsigned long long* bitmap)
+{
+    int i, outside;
+
+    unsigned long long word = 0;
+
+    const __m256i bias = _mm256_set1_epi64x((long long)0x8000000000000000ull);
+    const __m256i lowest = _mm256_set1_epi64x((long long)low);
+    const __m256i limit = _mm256_xor_si256(_mm256_set1_epi64x((long long)span), bias);
+
+    __m256i offset;
+
+    for (i = 0; i + 4 <= count; i += 4)
+    {
+        offset = _mm256_sub_epi64(_mm256_loadu_si256((const __m256i*)(values + i)), lowest);
+        outside = _mm256_movemask_pd(_mm256_castsi256_pd(
+                      _mm256_cmpgt_epi64(_mm256_xor_si256(offset, bias), limit)));
+
+        word |= (unsigned long long)(~outside & 0xf) << (i % 64);
+
+        if (i % 64 == 60)
+        {
+            bitmap[i / 64] = word;
+            word = 0;
+        }
+    }
+
+    if (i % 64)
+    {
+        bitmap[i / 64] = word;
+    }
+
+    _mm256_zeroupper();
+
+    return i;
+}
+
+#endif
+
+
+//////////////////////////////////////
+// SCAN FUNCTIONS
+//////////////////////////////////////
+
+// Instruction set the kernels use (the best this processor supports,
+// detected on first use, unless lowered by setScanLevel)
+int scanLevel(void)
+{
+    if (activeLevel == -1)
+    {
+        activeLevel = detectScanLevel();
+    }
+
+    return activeLevel;
+}
+
+// Use at most the given instruction set (SCAN_...); a level the processor
+// lacks falls back to the best one it has
+void setScanLevel(int level)
+{
+    int best = detectScanLevel();
+
+    activeLevel = level < best ? level : best;
+}
+
+// Set bit i of "bitmap" for every values[i] from "low" to "high" and clear
+// the rest of its SCAN_BITMAP_WORDS(count) words (returns # of values selected)
+int selectRange32(const unsigned int* values, int count, unsigned int low, unsigned int high,
+                  unsigned long long* bitmap)
+{
+    int done = 0, result = 0;
+
+    memset(bitmap, 0, SCAN_BITMAP_WORDS(count) * sizeof(unsigned long long));
+
+    if (low <= high)
+    {
+#ifdef SCAN_X86
+        if (scanLevel() == SCAN_AVX2)
+        {
+            done = selectRange32Avx2(values, count, low, high - low, bitmap);
+        }
+        else if (scanLevel() == SCAN_SSE2)
+        {
+            done = selectRange32Sse2(values, count, low, high - low, bitmap);
+        }
+#endif
+        selectRange32Scalar(values, done, count, low, high - low, bitmap);
+
+        result = bitmapCount(bitmap, count);
+    }
+
+    return result;
+}
+
+// Set bit i of "bitmap" for every values[i] from "low" to "high" and clear
+// the rest of its SCAN_BITMAP_WORDS(count) words (returns # of values selected)
+int selectRange64(const unsigned long long* values, int count, unsigned long long low,
+                  unsigned long long high, unsigned long long* bitmap)
+{
+    int done = 0, result = 0;
+
+    memset(bitmap, 0, SCAN_BITMAP_WORDS(count) * sizeof(unsigned long long));
+
+    if (low <= high)
+    {
+#ifdef SCAN_X86
+        if (scanLevel() == SCAN_AVX2)
+        {
+            done = selectRange64Avx2(values, count, low, high - low, bitmap);
+        }
+#endif
+        selectRange64Scalar(values, done, count, low, high - low, bitmap);
+
+        result = bitmapCount(bitmap, count);
+    }
+
+    return result;
+}
+
+// Index of the lowest bit set in a non-zero word
+int lowestBit(unsigned long long word)
+{
+    int bit;
+
+#if defined(__GNUC__)
+    bit = __builtin_ctzll(word);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+
+    _BitScanForward64(&index, word);
+    bit = (int)index;
+#else
+    for (bit = 0; !(word & 1); bit++)
+    {
+        word >>= 1;
+    }
+#endif
+
+    return bit;
+}
+
+// Fill "positions" with up to "max" of "base" + i for the bits i set in
+// the first "count" bits of a bitmap (returns # of positions filled)
+int bitmapPositions(const unsigned long long* bitmap, int count, int base,
+                    int* positions, int max)
+{
+    int i, filled = 0;
+
+    unsigned long long word;
+
+    for (i = 0; i < SCAN_BITMAP_WORDS(count) && filled < max; i++)
+    {
+        for (word = bitmap[i]; word && filled < max; word &= word - 1)
+        {
+            positions[filled++] = base + i * 64 + lowestBit(word);
+        }
+    }
+
+    return filled;
+}
@@ -0,0 +1,47 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// Instruction sets the scan kernels can use, from the least capable
+#define SCAN_SCALAR 0       // plain C (any processor)
+#define SCAN_SSE2 1         // 4 32-bit values per step (every x64 processor)
+#define SCAN_AVX2 2         // 8 32-bit or 4 64-bit values per step
+
+// Words a selection bitmap needs for "count" values
+#define SCAN_BITMAP_WORDS(count) (((count) + 63) / 64)
+
+
+//////////////////////////////////////
+// SCAN FUNCTIONS
+//////////////////////////////////////
+
+// Instruction set the kernels use (the best this processor supports,
+// detected on first use, unless lowered by setScanLevel)
+int scanLevel(void);
+
+// Use at most the given instruction set (SCAN_...); a level the processor
+// lacks falls back to the best one it has
+void setScanLevel(int level);
+
+// Set bit i of "bitmap" for every values[i] from "low" to "high" and clear
+// the rest of its SCAN_BITMAP_WORDS(count) words (returns # of values selected)
+int selectRange32(const unsigned int* values, int count, unsigned int low, unsigned int high,
+                  unsigned long long* bitmap);
+
+// Set bit i of "bitmap" for every values[i] from "low" to "high" and clear
+// the rest of its SCAN_BITMAP_WORDS(count) words (returns # of values selected)
+int selectRange64(const unsigned long long* values, int count, unsigned long long low,
+                  unsigned long long high, unsigned long long* bitmap);
+
+// Index of the lowest bit set in a non-zero word
+int lowestBit(unsigned long long word);
+
+// Fill "positions" with up to "max" of "base" + i for the bits i set in
+// the first "count" bits of a bitmap (returns # of positions filled)
+int bitmapPositions(const unsigned long long* bitmap, int count, int base,
+                    int* positions, int max);
+
+#endif // !SCAN_H
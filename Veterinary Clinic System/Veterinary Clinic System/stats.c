@@ -0,0 +1,385 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Calls are timed with the processor's time stamp counter where there is
+// one (it reads in a few cycles) and with the wall clock elsewhere
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define STATS_TSC
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define STATS_TSC
+#endif
+
+#include "stats.h"
+#include "thread.h"
+
+// Ticks and wall clock time the tick rate is measured from
+static unsigned long long firstTicks;
+static long long firstNs;
+
+
+//////////////////////////////////////
+// CLOCK FUNCTIONS
+//////////////////////////////////////
+
+// Current wall clock time in nanoseconds
+static long long wallClockNs(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Current time in ticks: the processor's time stamp counter, or the wall
+// clock in nanoseconds where there is none (never 0)
+unsigned long long statTicks(void)
+{
+#ifdef STATS_TSC
+    return __rdtsc();
+#else
+    return (unsigned long long)wallClockNs();
+#endif
+}
+
+// Note the time the tick rate is measured from (only the first call counts)
+void startStatClock(void)
+{
+    if (!firstTicks)
+    {
+        firstTicks = statTicks();
+        firstNs = wallClockNs();
+    }
+}
+
+// Nanoseconds per tick, measured since startStatClock (waits until
+// STATS_CALIBRATE_NS have gone by)
+double statNsPerTick(void)
+{
+    unsigned long long ticks;
+
+    long long ns;
+
+    startStatClock();
+
+    do
+    {
+        ticks = statTicks();
+        ns = wallClockNs();
+    } while (ns - firstNs < STATS_CALIBRATE_NS);
+
+    return ticks > firstTicks ? (double)(ns - firstNs) / (double)(ticks - firstTicks) : 1.0;
+}
+
+
+#ifdef CLINIC_STATS
+
+// Data type: OperationStats (the calls of one operation; durations in ticks)
+struct OperationStats
+{
+    unsigned long long calls;
+    unsigned long long rows;
+    unsigned long long timed;
+    unsigned long long totalTicks;
+    unsigned long long maxTicks;
+    unsigned long long histogram[STATS_BUCKETS];
+};
+
+// Function names of the operations (enum StatOperation)
+static const char* const operationNames[] =
+{
+    "importPatients", "importAppointments", "sortAppointments",
+    "findPatientIndexByPatientNum", "viewAllAppointments", "viewAppointmentSchedule",
+    "isSlotTaken"
+};
+
+// One call in this many (a power of two) is timed, so the lookups that
+// take tens of nanoseconds are not slowed down by reading the clock (which
+// can take twenty under a hypervisor)
+static const unsigned long long samplePeriods[] = { 1, 1, 1, 256, 1, 1, 256 };
+
+// Data type: ThreadStats
+// Counters for every operation, owned by one thread at a time (claimed
+// with claimFlag); reportStats adds up all of them
+struct ThreadStats
+{
+    volatile long owned;
+    struct OperationStats* operations;  // STAT_COUNT of them
+};
+
+static struct ThreadStats threadStats[STATS_THREADS];
+
+static THREAD_LOCAL struct ThreadStats* ownStats;
+
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Claim free counters for this thread, allocating them the first time
+// (returns NULL if every set is taken or out of memory)
+static struct ThreadStats* claimStats(void)
+{
+    int i;
+
+    struct ThreadStats* stats = NULL;
+
+    for (i = 0; i < STATS_THREADS && stats == NULL; i++)
+    {
+        if (!flagTaken(&threadStats[i].owned) && claimFlag(&threadStats[i].owned))
+        {
+            stats = &threadStats[i];
+
+            if (stats->operations == NULL &&
+                (stats->operations = calloc(STAT_COUNT, sizeof(struct OperationStats))) == NULL)
+            {
+                releaseFlag(&stats->owned);
+                stats = NULL;
+            }
+        }
+    }
+
+    ownStats = stats;
+
+    return stats;
+}
+
+// Add one thread's counters of an operation to the totals
+static void addStats(struct OperationStats* total, const struct OperationStats* stats)
+{
+    int i;
+
+    total->calls += stats->calls;
+    total->rows += stats->rows;
+    total->timed += stats->timed;
+    total->totalTicks += stats->totalTicks;
+
+    if (stats->maxTicks > total->maxTicks)
+    {
+        total->maxTicks = stats->maxTicks;
+    }
+
+    for (i = 0; i < STATS_BUCKETS; i++)
+    {
+        total->histogram[i] += stats->histogram[i];
+    }
+}
+
+// Index of the highest bit set in a non-zero word
+static int highestBit(unsigned long long word)
+{
+    int bit;
+
+#if defined(__GNUC__)
+    bit = 63 - __builtin_clzll(word);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+
+    _BitScanReverse64(&index, word);
+    bit = (int)index;
+#else
+    for (bit = 0; word >>= 1; bit++)
+    {
+    }
+#endif
+
+    return bit;
+}
+
+// Histogram bucket of a duration: its highest bit picks the power of two
+// and the STATS_SUB_BITS bits below it the bucket within it
+static int bucketOf(unsigned long long ticks)
+{
+    int shift, bucket = (int)ticks;
+
+    if (ticks >= STATS_SUB_BUCKETS)
+    {
+        shift = highestBit(ticks) - STATS_SUB_BITS;
+        bucket = (shift + 1) * STATS_SUB_BUCKETS +
+                 (int)((ticks >> shift) & (STATS_SUB_BUCKETS - 1));
+    }
+
+    return bucket;
+}
+
+// Middle of the durations a bucket holds
+static double bucketMiddle(int bucket)
+{
+    int shift = bucket / STATS_SUB_BUCKETS - 1;
+
+    double result = bucket;
+
+    if (shift >= 0)
+    {
+        result = (double)((unsigned long long)(STATS_SUB_BUCKETS + bucket % STATS_SUB_BUCKETS)
+                          << shift) + ((1ULL << shift) - 1) / 2.0;
+    }
+
+    return result;
+}
+
+// Duration in ticks "percent" percent of the timed calls took at most
+// (the middle of its bucket, never above the slowest call)
+static double percentileTicks(const struct OperationStats* stats, int percent)
+{
+    int bucket = -1;
+
+    unsigned long long seen = 0;
+    unsigned long long rank = (stats->timed * percent + 99) / 100;
+
+    double result;
+
+    while (seen < rank)
+    {
+        seen += stats->histogram[++bucket];
+    }
+
+    result = bucket < 0 ? 0.0 : bucketMiddle(bucket);
+
+    return result < stats->maxTicks ? result : (double)stats->maxTicks;
+}
+
+
+//////////////////////////////////////
+// STATISTICS FUNCTIONS
+//////////////////////////////////////
+
+// Start a call of an operation (returns the time stamp to pass to
+// finishStat, 0 if this call is not timed)
+unsigned long long statStart(enum StatOperation op)
+{
+    unsigned long long start = 0;
+
+    struct ThreadStats* own = ownStats != NULL ? ownStats : claimStats();
+
+    if (own != NULL && !(own->operations[op].calls & (samplePeriods[op] - 1)))
+    {
+        start = statTicks();
+    }
+
+    return start;
+}
+
+// Count a call of an operation and the rows it went through, timing it if
+// statStart stamped its start
+void finishStat(enum StatOperation op, unsigned long long start, long long rows)
+{
+    unsigned long long now, elapsed;
+
+    struct OperationStats* stats;
+    struct ThreadStats* own = ownStats != NULL ? ownStats : claimStats();
+
+    if (own != NULL)
+    {
+        stats = &own->operations[op];
+        stats->calls++;
+        stats->rows += rows;
+
+        if (start)
+        {
+            now = statTicks();
+            elapsed = now > start ? now - start : 0;
+
+            stats->timed++;
+            stats->totalTicks += elapsed;
+            stats->histogram[bucketOf(elapsed)]++;
+
+            if (elapsed > stats->maxTicks)
+            {
+                stats->maxTicks = elapsed;
+            }
+
+            startStatClock();
+        }
+    }
+}
+
+// Give this thread's counters back for another thread to count with
+// (called by a thread as it finishes; its counts stay in the totals)
+void releaseThreadStats(void)
+{
+    if (ownStats != NULL)
+    {
+        releaseFlag(&ownStats->owned);
+        ownStats = NULL;
+    }
+}
+
+// Write the calls, rows and latency percentiles of every operation called
+// (by every thread; calls still under way in other threads may be missed)
+void reportStats(FILE* fp)
+{
+    int i, j, shown = 0;
+
+    double us = statNsPerTick() / 1e3;
+
+    struct OperationStats total;
+
+    const struct OperationStats* stats = &total;
+
+    fprintf(fp, "Operation                    Calls      Rows       Mean (us) p50 (us)  "
+                "p90 (us)  p99 (us)  Max (us)\n"
+                "---------------------------- ---------- ---------- --------- --------- "
+                "--------- --------- ---------\n");
+
+    for (i = 0; i < STAT_COUNT; i++)
+    {
+        memset(&total, 0, sizeof(total));
+
+        for (j = 0; j < STATS_THREADS; j++)
+        {
+            if (threadStats[j].operations != NULL)
+            {
+                addStats(&total, &threadStats[j].operations[i]);
+            }
+        }
+
+        if (stats->calls)
+        {
+            fprintf(fp, "%-28s %10llu %10llu %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+                    operationNames[i], stats->calls, stats->rows,
+                    stats->timed ? stats->totalTicks * us / stats->timed : 0.0,
+                    percentileTicks(stats, 50) * us, percentileTicks(stats, 90) * us,
+                    percentileTicks(stats, 99) * us, stats->maxTicks * us);
+            shown++;
+        }
+    }
+
+    if (!shown)
+    {
+        fprintf(fp, "(no operations called yet)\n");
+    }
+}
+
+#else
+
+// Write a note that the statistics were compiled out
+void reportStats(FILE* fp)
+{
+    fprintf(fp, "Operation statistics are not compiled in (built with CLINIC_NO_STATS)\n");
+}
+
+#endif
+
+// Write the statistics to a file (returns 0 if it could not be written)
+int writeStats(const char* statsFile)
+{
+    int result = 0;
+
+    FILE* fp = fopen(statsFile, "w");
+
+    if (fp != NULL)
+    {
+        reportStats(fp);
+        result = fclose(fp) == 0;
+    }
+
+    return result;
+}
@@ -0,0 +1,101 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// The operations are instrumented unless CLINIC_NO_STATS is defined, which
+// turns statStart and finishStat into nothing
+#ifndef CLINIC_NO_STATS
+#define CLINIC_STATS
+#endif
+
+// Latency histograms (HDR style): durations below STATS_SUB_BUCKETS ticks
+// have a bucket each, and every power of two above splits into
+// STATS_SUB_BUCKETS buckets, so a bucket is within 1/STATS_SUB_BUCKETS of
+// the durations it holds
+#define STATS_SUB_BITS 3
+#define STATS_SUB_BUCKETS (1 << STATS_SUB_BITS)
+#define STATS_BUCKETS ((64 - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS)
+
+// Shortest stretch of wall clock time ticks are converted over (10 ms)
+#define STATS_CALIBRATE_NS 10000000LL
+
+// Threads that can count calls at once (a finished thread's counters are
+// reused, and kept in the totals)
+#define STATS_THREADS 64
+
+//////////////////////////////////////
+// Enumerations
+//////////////////////////////////////
+
+// Instrumented operations (named after their functions); the rows counted
+// are the records imported, sorted or listed, the patients found by a
+// lookup and the slots found taken by a conflict check.  Each thread
+// counts its calls in counters of its own, so counting takes no lock
+enum StatOperation
+{
+    STAT_IMPORT_PATIENTS,
+    STAT_IMPORT_APPOINTMENTS,
+    STAT_SORT_APPOINTMENTS,
+    STAT_FIND_PATIENT,
+    STAT_VIEW_APPOINTMENTS,
+    STAT_VIEW_SCHEDULE,
+    STAT_SLOT_CHECK,
+    STAT_COUNT
+};
+
+
+//////////////////////////////////////
+// CLOCK FUNCTIONS
+//////////////////////////////////////
+
+// Current time in ticks: the processor's time stamp counter, or the wall
+// clock in nanoseconds where there is none (never 0)
+unsigned long long statTicks(void);
+
+// Note the time the tick rate is measured from (only the first call counts)
+void startStatClock(void);
+
+// Nanoseconds per tick, measured since startStatClock (waits until
+// STATS_CALIBRATE_NS have gone by)
+double statNsPerTick(void);
+
+
+//////////////////////////////////////
+// STATISTICS FUNCTIONS
+//////////////////////////////////////
+
+#ifdef CLINIC_STATS
+
+// Start a call of an operation (returns the time stamp to pass to
+// finishStat, 0 if this call is not timed)
+unsigned long long statStart(enum StatOperation op);
+
+// Count a call of an operation and the rows it went through, timing it if
+// statStart stamped its start
+void finishStat(enum StatOperation op, unsigned long long start, long long rows);
+
+// Give this thread's counters back for another thread to count with
+// (called by a thread as it finishes; its counts stay in the totals)
+void releaseThreadStats(void);
+
+#else
+
+#define statStart(op) 0ULL
+#define finishStat(op, start, rows) ((void)(start))
+#define releaseThreadStats() ((void)0)
+
+#endif
+
+// Write the calls, rows and latency percentiles of every operation called
+// (by every thread; calls still under way in other threads may be missed)
+void reportStats(FILE* fp);
+
+// Write the statistics to a file (returns 0 if it could not be written)
+int writeStats(const char* statsFile);
+
+#endif // !STATS_H
@@ -0,0 +1,2052 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clinic.h"
+#include "scan.h"
+#include "store.h"
+#include "trace.h"
+
+// Records that fit in one block
+#define PATIENT_BLOCK_LEN ((int)((STORE_BLOCK_SIZE - sizeof(int)) / sizeof(struct Patient)))
+#define APPOINT_BLOCK_LEN ((int)((STORE_BLOCK_SIZE - 2 * sizeof(int)) / sizeof(struct Appointment)))
+#define NAME_BLOCK_BYTES ((int)(STORE_BLOCK_SIZE - sizeof(int)))
+
+// Bulk loads leave room in each block so early inserts do not split at once
+#define APPOINT_LOAD_LEN (APPOINT_BLOCK_LEN - APPOINT_BLOCK_LEN / 8)
+
+// A patient compaction pass starts once this many slots are empty and they
+// make up more than 1/4 of the table
+#define COMPACT_MIN_HOLES 64
+
+// Bytes of a pool segment (a multiple of the 64 KB mapping granularity)
+#define SEGMENT_BYTES ((long long)STORE_SEGMENT_BLOCKS * STORE_BLOCK_SIZE)
+
+// First bytes of a clinic image file (no terminator is stored)
+#define IMAGE_MAGIC "VETCLINI"
+
+// Record layout of clinics created from now on
+static int storeLayout = STORE_ROWS;
+
+// Data type: PatientColumns (the slots of a patient block field by field)
+struct PatientColumns
+{
+    unsigned long long phones[PATIENT_BLOCK_LEN];
+    int numbers[PATIENT_BLOCK_LEN];
+    unsigned int names[PATIENT_BLOCK_LEN];
+};
+
+// Data type: PatientBlock (one run of patient slots in the pool's layout)
+struct PatientBlock
+{
+    union
+    {
+        struct Patient rows[PATIENT_BLOCK_LEN];
+        struct PatientColumns columns;
+    } slots;
+    int next;           // next block of the table (-1 if last)
+};
+
+// Data type: NameBlock (one run of the name arena; the bytes after the
+// last name are zero)
+struct NameBlock
+{
+    char text[NAME_BLOCK_BYTES];
+    int next;           // next block of the arena (-1 if last)
+};
+
+// Data type: AppointmentColumns (the records of an appointment block field
+// by field)
+struct AppointmentColumns
+{
+    unsigned int keys[APPOINT_BLOCK_LEN];
+    int patientNumbers[APPOINT_BLOCK_LEN];
+};
+
+// Data type: AppointmentBlock (one link in the sorted appointment chain, in
+// the pool's layout)
+struct AppointmentBlock
+{
+    int count;          // records in use
+    int next;           // next block number in date/time order (-1 if last)
+    union
+    {
+        struct Appointment rows[APPOINT_BLOCK_LEN];
+        struct AppointmentColumns columns;
+    } records;
+};
+
+// Data type: ImageHeader
+// Start of a clinic image file.  The tables are found by following the
+// block links from the first block of each; everything else (counts,
+// indexes, free slots) is rebuilt from the records when the image is opened.
+struct ImageHeader
+{
+    char magic[8];          // IMAGE_MAGIC
+    int version;            // STORE_IMAGE_VERSION
+    int blockSize;          // layout the image was written with
+    int patientSize;
+    int appointSize;
+    int layout;             // STORE_ROWS or STORE_COLUMNS
+    int open;               // set while a program has the image mapped
+    int blockCount;         // pool state
+    int freeList;
+    int patientFirst;       // first patient block (-1 if none)
+    int slotCount;
+    int appointFirst;       // first appointment block (-1 if none)
+    int nameFirst;          // first name block (-1 if none)
+    unsigned int checksum;  // of every field above
+};
+
+
+//////////////////////////////////////
+// BLOCK POOL FUNCTIONS
+//////////////////////////////////////
+
+// Address of a block
+static void* blockAt(const struct BlockPool* pool, int block)
+{
+    return pool->segments[block / STORE_SEGMENT_BLOCKS] +
+           (size_t)(block % STORE_SEGMENT_BLOCKS) * STORE_BLOCK_SIZE;
+}
+
+// Hand out a zeroed block (returns its number or -1 if out of memory)
+static int allocBlock(struct BlockPool* pool)
+{
+    int block = -1;
+
+    char** segments;
+
+    if (pool->freeList)
+    {
+        block = pool->freeList - 1;
+        memcpy(&pool->freeList, blockAt(pool, block), sizeof(int));
+    }
+    else
+    {
+        if (pool->blockCount == pool->segmentCount * STORE_SEGMENT_BLOCKS)
+        {
+            segments = realloc(pool->segments, (pool->segmentCount + 1) * sizeof(char*));
+
+            if (segments != NULL)
+            {
+                pool->segments = segments;
+                pool->segments[pool->segmentCount] = NULL;
+
+                // A mapped pool already has the layout of its image
+                if (pool->segmentCount == 0 && pool->imageHeader == NULL)
+                {
+                    pool->layout = storeLayout;
+                }
+
+                if (pool->imageHeader == NULL)
+                {
+                    pool->segments[pool->segmentCount] = malloc((size_t)SEGMENT_BYTES);
+                }
+                else if (resizeMappedFile(&pool->image, STORE_IMAGE_HEADER_SIZE +
+                                          (pool->segmentCount + 1) * SEGMENT_BYTES))
+                {
+                    pool->segments[pool->segmentCount] =
+                        mapFileRange(&pool->image, STORE_IMAGE_HEADER_SIZE +
+                                     pool->segmentCount * SEGMENT_BYTES, (size_t)SEGMENT_BYTES);
+                }
+
+                if (pool->segments[pool->segmentCount] != NULL)
+                {
+                    pool->segmentCount++;
+                }
+            }
+        }
+
+        if (pool->blockCount < pool->segmentCount * STORE_SEGMENT_BLOCKS)
+        {
+            block = pool->blockCount++;
+        }
+    }
+
+    if (block != -1)
+    {
+        memset(blockAt(pool, block), 0, STORE_BLOCK_SIZE);
+    }
+
+    return block;
+}
+
+// Return a block to the pool for re-use
+static void recycleBlock(struct BlockPool* pool, int block)
+{
+    memcpy(blockAt(pool, block), &pool->freeList, sizeof(int));
+    pool->freeList = block + 1;
+}
+
+// Release every segment of the pool, unmapping and closing its image
+static void freeBlockPool(struct BlockPool* pool)
+{
+    int i;
+
+    struct BlockPool empty = { 0 };
+
+    for (i = 0; i < pool->segmentCount; i++)
+    {
+        if (pool->imageHeader == NULL)
+        {
+            free(pool->segments[i]);
+        }
+        else
+        {
+            unmapFileRange(pool->segments[i], (size_t)SEGMENT_BYTES);
+        }
+    }
+    free(pool->segments);
+
+    if (pool->imageHeader != NULL)
+    {
+        unmapFileRange(pool->imageHeader, STORE_IMAGE_HEADER_SIZE);
+    }
+    closeMappedFile(&pool->image);
+
+    *pool = empty;
+}
+
+
+//////////////////////////////////////
+// RECORD LAYOUT HELPERS
+//////////////////////////////////////
+
+// Copy a patient out of a block
+static void getBlockPatient(const struct BlockPool* pool, const struct PatientBlock* block,
+                            int offset, struct Patient* patient)
+{
+    if (pool->layout == STORE_COLUMNS)
+    {
+        patient->patientNumber = block->slots.columns.numbers[offset];
+        patient->name = block->slots.columns.names[offset];
+        patient->phone.packed = block->slots.columns.phones[offset];
+    }
+    else
+    {
+        *patient = block->slots.rows[offset];
+    }
+}
+
+// Store a patient in a block
+static void putBlockPatient(const struct BlockPool* pool, struct PatientBlock* block,
+                            int offset, const struct Patient* patient)
+{
+    if (pool->layout == STORE_COLUMNS)
+    {
+        block->slots.columns.numbers[offset] = patient->patientNumber;
+        block->slots.columns.names[offset] = patient->name;
+        block->slots.columns.phones[offset] = patient->phone.packed;
+    }
+    else
+    {
+        block->slots.rows[offset] = *patient;
+    }
+}
+
+// Ordering key of an appointment in a block
+static unsigned int blockKey(const struct BlockPool* pool, const struct AppointmentBlock* block,
+                             int offset)
+{
+    return pool->layout == STORE_COLUMNS ? block->records.columns.keys[offset] :
+                                           block->records.rows[offset].key;
+}
+
+// Copy an appointment out of a block
+static void getBlockAppointment(const struct BlockPool* pool,
+                                const struct AppointmentBlock* block, int offset,
+                                struct Appointment* appoint)
+{
+    if (pool->layout == STORE_COLUMNS)
+    {
+        appoint->patientNumber = block->records.columns.patientNumbers[offset];
+        appoint->key = block->records.columns.keys[offset];
+    }
+    else
+    {
+        *appoint = block->records.rows[offset];
+    }
+}
+
+// Store an appointment in a block
+static void putBlockAppointment(const struct BlockPool* pool, struct AppointmentBlock* block,
+                                int offset, const struct Appointment* appoint)
+{
+    if (pool->layout == STORE_COLUMNS)
+    {
+        block->records.columns.patientNumbers[offset] = appoint->patientNumber;
+        block->records.columns.keys[offset] = appoint->key;
+    }
+    else
+    {
+        block->records.rows[offset] = *appoint;
+    }
+}
+
+// Move a run of appointments within or between blocks (the runs may overlap)
+static void moveBlockAppointments(const struct BlockPool* pool, struct AppointmentBlock* to,
+                                  int toOffset, const struct AppointmentBlock* from,
+                                  int fromOffset, int count)
+{
+    if (pool->layout == STORE_COLUMNS)
+    {
+        memmove(&to->records.columns.keys[toOffset], &from->records.columns.keys[fromOffset],
+                count * sizeof(unsigned int));
+        memmove(&to->records.columns.patientNumbers[toOffset],
+                &from->records.columns.patientNumbers[fromOffset], count * sizeof(int));
+    }
+    else
+    {
+        memmove(&to->records.rows[toOffset], &from->records.rows[fromOffset],
+                count * sizeof(struct Appointment));
+    }
+}
+
+
+//////////////////////////////////////
+// APPOINTMENT CHAIN HELPERS
+//////////////////////////////////////
+
+// Appointment block at a position in the directory
+static struct AppointmentBlock* chainBlock(const struct ClinicData* data, int dirIndex)
+{
+    return blockAt(&data->pool, data->appointments.blocks[dirIndex]);
+}
+
+// Make room for one more directory entry (returns 0 if out of memory)
+static int reserveChainEntry(struct AppointmentTable* table)
+{
+    int size, result = 1;
+
+    int* blocks;
+
+    if (table->blockCount == table->capacity)
+    {
+        size = table->capacity ? table->capacity * 2 : 16;
+        blocks = realloc(table->blocks, size * sizeof(int));
+
+        if (blocks != NULL)
+        {
+            table->blocks = blocks;
+            table->capacity = size;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
+
+// Directory position of the block a date/time belongs in: the last block
+// whose first record is before it (or not after it when "after" is set)
+static int findChainBlock(const struct ClinicData* data, const struct Appointment* appoint,
+                          int after)
+{
+    int low = 0, high = data->appointments.blockCount, mid;
+
+    unsigned int key;
+
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        key = blockKey(&data->pool, chainBlock(data, mid), 0);
+
+        if (key < appoint->key || (after && key == appoint->key))
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low > 0 ? low - 1 : 0;
+}
+
+// Offset of the first record in a block at or after a date/time (or after
+// it when "after" is set)
+static int findBlockOffset(const struct BlockPool* pool, const struct AppointmentBlock* block,
+                           const struct Appointment* appoint, int after)
+{
+    int low = 0, high = block->count, mid;
+
+    unsigned int key;
+
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        key = blockKey(pool, block, mid);
+
+        if (key < appoint->key || (after && key == appoint->key))
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+// Split a full block in two, linking the new half in after it
+// (returns 0 if out of memory)
+static int splitChainBlock(struct ClinicData* data, int dirIndex)
+{
+    int newBlock, half, result = 0;
+
+    struct AppointmentTable* table = &data->appointments;
+    struct AppointmentBlock* block;
+    struct AppointmentBlock* upper;
+
+    if (reserveChainEntry(table))
+    {
+        newBlock = allocBlock(&data->pool);
+
+        if (newBlock != -1)
+        {
+            block = chainBlock(data, dirIndex);
+            upper = blockAt(&data->pool, newBlock);
+
+            half = block->count / 2;
+            upper->count = block->count - half;
+            moveBlockAppointments(&data->pool, upper, 0, block, half, upper->count);
+            block->count = half;
+
+            upper->next = block->next;
+            block->next = newBlock;
+
+            memmove(&table->blocks[dirIndex + 2], &table->blocks[dirIndex + 1],
+                    (table->blockCount - dirIndex - 1) * sizeof(int));
+            table->blocks[dirIndex + 1] = newBlock;
+            table->blockCount++;
+
+            result = 1;
+        }
+    }
+
+    return result;
+}
+
+// Merge neighbouring appointment blocks that fit in one, moving up to
+// "budget" records (returns the budget left over)
+static int compactAppointmentStep(struct ClinicData* data, int budget)
+{
+    int upperBlock;
+
+    struct AppointmentTable* table = &data->appointments;
+    struct AppointmentBlock* block;
+    struct AppointmentBlock* upper;
+
+    // Start a pass when the blocks are on average less than half full.
+    // Half full blocks need not have a neighbour they fit in with, so after
+    // a pass that merged nothing the next waits for deletes to free more
+    if (!table->compacting && table->blockCount > 1 &&
+        table->count * 2 < table->blockCount * APPOINT_BLOCK_LEN &&
+        (!table->idleCount || table->count < table->idleCount))
+    {
+        table->compacting = 1;
+        table->compactCursor = 0;
+        table->idleCount = table->count;
+    }
+
+    while (table->compacting && budget > 0)
+    {
+        if (table->compactCursor + 1 >= table->blockCount)
+        {
+            table->compacting = 0;
+        }
+        else
+        {
+            block = chainBlock(data, table->compactCursor);
+            upper = chainBlock(data, table->compactCursor + 1);
+
+            if (block->count + upper->count <= APPOINT_LOAD_LEN)
+            {
+                moveBlockAppointments(&data->pool, block, block->count, upper, 0,
+                                      upper->count);
+                block->count += upper->count;
+                block->next = upper->next;
+                budget -= upper->count;
+
+                upperBlock = table->blocks[table->compactCursor + 1];
+
+                memmove(&table->blocks[table->compactCursor + 1],
+                        &table->blocks[table->compactCursor + 2],
+                        (table->blockCount - table->compactCursor - 2) * sizeof(int));
+                table->blockCount--;
+
+                recycleBlock(&data->pool, upperBlock);
+
+                // The pass merged something, so the next can start at once
+                table->idleCount = 0;
+            }
+            else
+            {
+                table->compactCursor++;
+            }
+
+            budget--;
+        }
+    }
+
+    return budget;
+}
+
+// Release every appointment block and the directory
+static void freeAppointmentChain(struct ClinicData* data)
+{
+    int i;
+
+    struct AppointmentTable empty = { 0 };
+
+    for (i = 0; i < data->appointments.blockCount; i++)
+    {
+        recycleBlock(&data->pool, data->appointments.blocks[i]);
+    }
+    free(data->appointments.blocks);
+
+    data->appointments = empty;
+}
+
+
+//////////////////////////////////////
+// PATIENT TABLE HELPERS
+//////////////////////////////////////
+
+// Patient block at a position in the table
+static struct PatientBlock* patientBlock(const struct ClinicData* data, int blockIndex)
+{
+    return blockAt(&data->pool, data->patients.blocks[blockIndex]);
+}
+
+// Put an emptied slot on the free list (without room on the list the slot
+// stays a hole until compaction)
+static void keepFreeSlot(struct PatientTable* table, int slot)
+{
+    int size;
+
+    int* freeSlots;
+
+    if (table->freeCount == table->freeCapacity)
+    {
+        size = table->freeCapacity ? table->freeCapacity * 2 : 16;
+        freeSlots = realloc(table->freeSlots, size * sizeof(int));
+
+        if (freeSlots != NULL)
+        {
+            table->freeSlots = freeSlots;
+            table->freeCapacity = size;
+        }
+    }
+
+    if (table->freeCount < table->freeCapacity)
+    {
+        table->freeSlots[table->freeCount++] = slot;
+    }
+}
+
+// Move the patient in one slot to a lower empty slot, pointing its index
+// entries at the new slot
+static void movePatientSlot(struct ClinicData* data, int from, int to)
+{
+    long long key;
+
+    struct Patient patient;
+    struct Patient empty = { 0 };
+
+    readPatient(data, from, &patient);
+    writePatient(data, to, &patient);
+    writePatient(data, from, &empty);
+
+    // Neither update needs memory: the patient number is already a key, and
+    // the phone key count is unchanged with "to" below a slot already chained
+    if (findPatientSlot(&data->patientIndex, patient.patientNumber) == from)
+    {
+        insertPatientSlot(&data->patientIndex, patient.patientNumber, to);
+    }
+
+    key = phoneNumberKey(&patient.phone);
+    removePhoneSlot(&data->phoneIndex, key, from);
+    insertPhoneSlot(&data->phoneIndex, key, to);
+}
+
+// Slide live patients down over the empty slots, examining up to "budget"
+// slots (returns the budget left over)
+static int compactPatientStep(struct ClinicData* data, int budget)
+{
+    struct PatientTable* table = &data->patients;
+
+    int holes = table->slotCount - table->liveCount;
+
+    if (!table->compacting && holes >= COMPACT_MIN_HOLES && holes * 4 > table->slotCount)
+    {
+        // Every hole is about to be squeezed out, so none is handed out again
+        table->compacting = 1;
+        table->compactRead = 0;
+        table->compactWrite = 0;
+        table->freeCount = 0;
+    }
+
+    while (table->compacting && budget > 0)
+    {
+        if (table->compactRead == table->slotCount)
+        {
+            // The slots past the last live record are all empty: drop them
+            // and give back the blocks they used
+            table->slotCount = table->compactWrite;
+
+            while (table->blockCount * PATIENT_BLOCK_LEN - table->slotCount >= PATIENT_BLOCK_LEN)
+            {
+                recycleBlock(&data->pool, table->blocks[--table->blockCount]);
+            }
+
+            if (table->blockCount)
+            {
+                patientBlock(data, table->blockCount - 1)->next = -1;
+            }
+
+            table->compacting = 0;
+        }
+        else
+        {
+            if (patientNumberAt(data, table->compactRead))
+            {
+                if (table->compactRead != table->compactWrite)
+                {
+                    movePatientSlot(data, table->compactRead, table->compactWrite);
+                }
+                table->compactWrite++;
+            }
+
+            table->compactRead++;
+            budget--;
+        }
+    }
+
+    return budget;
+}
+
+
+//////////////////////////////////////
+// NAME ARENA HELPERS
+//////////////////////////////////////
+
+// Name block at a position in the arena
+static struct NameBlock* nameBlock(const struct ClinicData* data, int blockIndex)
+{
+    return blockAt(&data->pool, data->names.blocks[blockIndex]);
+}
+
+// Name with a reference
+static const char* nameAt(const struct ClinicData* data, unsigned int ref)
+{
+    return &nameBlock(data, (int)((ref - 1) / NAME_BLOCK_BYTES))->text[(ref - 1) % NAME_BLOCK_BYTES];
+}
+
+// Hash of a name (32-bit FNV-1a)
+static unsigned int nameHash(const char* name)
+{
+    unsigned int hash = 2166136261u;
+
+    while (*name)
+    {
+        hash = (hash ^ (unsigned char)*name++) * 16777619u;
+    }
+
+    return hash;
+}
+
+// Bucket of the intern table holding a name, or the empty bucket it
+// belongs in (the table must have an empty bucket)
+static int findNameBucket(const struct ClinicData* data, const char* name)
+{
+    const struct NameArena* arena = &data->names;
+
+    int mask = arena->refCapacity - 1;
+    int bucket = (int)(nameHash(name) & (unsigned int)mask);
+
+    while (arena->refs[bucket] && strcmp(nameAt(data, arena->refs[bucket]), name) != 0)
+    {
+        bucket = (bucket + 1) & mask;
+    }
+
+    return bucket;
+}
+
+// Double the intern table (or create it) and re-file every name
+// (returns 0 if out of memory)
+static int growNameTable(struct ClinicData* data)
+{
+    int i, bucket, oldCapacity, result = 0;
+
+    unsigned int* oldRefs;
+
+    struct NameArena* arena = &data->names;
+
+    int size = arena->refCapacity ? arena->refCapacity * 2 : 64;
+    unsigned int* refs = calloc(size, sizeof(unsigned int));
+
+    if (refs != NULL)
+    {
+        oldRefs = arena->refs;
+        oldCapacity = arena->refCapacity;
+
+        arena->refs = refs;
+        arena->refCapacity = size;
+        arena->nameCount = 0;
+
+        // The names in the old table are all different
+        for (i = 0; i < oldCapacity; i++)
+        {
+            if (oldRefs[i])
+            {
+                bucket = findNameBucket(data, nameAt(data, oldRefs[i]));
+                refs[bucket] = oldRefs[i];
+                arena->nameCount++;
+            }
+        }
+
+        free(oldRefs);
+        result = 1;
+    }
+
+    return result;
+}
+
+// File a stored name in the intern table unless an equal name is there
+// already (returns 0 if out of memory)
+static int fileNameRef(struct ClinicData* data, unsigned int ref)
+{
+    int bucket, result = 1;
+
+    struct NameArena* arena = &data->names;
+
+    // The table is kept at most half full
+    if (arena->nameCount * 2 >= arena->refCapacity)
+    {
+        result = growNameTable(data);
+    }
+
+    if (result)
+    {
+        bucket = findNameBucket(data, nameAt(data, ref));
+
+        if (!arena->refs[bucket])
+        {
+            arena->refs[bucket] = ref;
+            arena->nameCount++;
+        }
+    }
+
+    return result;
+}
+
+// Copy a name to the end of the arena, starting a new block when it does
+// not fit in the last one and "grow" is set (returns its reference, or 0
+// if out of memory or it needs a new block that may not be started)
+static unsigned int appendName(struct ClinicData* data, const char* name, int grow)
+{
+    int block, size = (int)strlen(name) + 1;
+
+    unsigned int ref = 0;
+
+    int* blocks;
+
+    struct NameArena* arena = &data->names;
+
+    if (grow && (!arena->blockCount || arena->used + size > NAME_BLOCK_BYTES))
+    {
+        blocks = realloc(arena->blocks, (arena->blockCount + 1) * sizeof(int));
+
+        if (blocks != NULL)
+        {
+            arena->blocks = blocks;
+            block = allocBlock(&data->pool);
+
+            if (block != -1)
+            {
+                ((struct NameBlock*)blockAt(&data->pool, block))->next = -1;
+
+                if (arena->blockCount)
+                {
+                    nameBlock(data, arena->blockCount - 1)->next = block;
+                }
+
+                arena->blocks[arena->blockCount++] = block;
+                arena->used = 0;
+            }
+        }
+    }
+
+    if (arena->blockCount && arena->used + size <= NAME_BLOCK_BYTES)
+    {
+        memcpy(&nameBlock(data, arena->blockCount - 1)->text[arena->used], name, size);
+
+        ref = (unsigned int)(arena->blockCount - 1) * NAME_BLOCK_BYTES + arena->used + 1;
+        arena->used += size;
+    }
+
+    return ref;
+}
+
+// Find or store a name in the name arena, starting a new block if it does
+// not fit and "grow" is set (returns its reference or 0 if it could not
+// be stored)
+static unsigned int internArenaName(struct ClinicData* data, const char* name, int grow)
+{
+    int bucket;
+
+    unsigned int ref = 0;
+
+    struct NameArena* arena = &data->names;
+
+    // The table is kept at most half full
+    if (arena->nameCount * 2 < arena->refCapacity || growNameTable(data))
+    {
+        bucket = findNameBucket(data, name);
+        ref = arena->refs[bucket];
+
+        if (!ref && (ref = appendName(data, name, grow)) != 0)
+        {
+            arena->refs[bucket] = ref;
+            arena->nameCount++;
+        }
+    }
+
+    return ref;
+}
+
+// Bytes in use in a name block: up to the terminator of its last name
+static int nameBlockUsed(const struct NameBlock* block)
+{
+    int used = NAME_BLOCK_BYTES - 1;
+
+    while (used > 0 && !block->text[used - 1])
+    {
+        used--;
+    }
+
+    return used ? used + 1 : 0;
+}
+
+
+//////////////////////////////////////
+// CLINIC IMAGE HELPERS
+//////////////////////////////////////
+
+// Checksum of the header fields (32-bit FNV-1a)
+static unsigned int imageChecksum(const struct ImageHeader* header)
+{
+    size_t i;
+
+    unsigned int hash = 2166136261u;
+
+    const unsigned char* bytes = (const unsigned char*)header;
+
+    for (i = 0; i < offsetof(struct ImageHeader, checksum); i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+// Write every mapped segment back to the image, then a header describing
+// the tables (returns 0 if the sync failed)
+static int syncImage(struct ClinicData* data, int open)
+{
+    int i, result = 1;
+
+    struct BlockPool* pool = &data->pool;
+    struct ImageHeader* header = pool->imageHeader;
+
+    for (i = 0; i < pool->segmentCount; i++)
+    {
+        result = syncFileRange(&pool->image, pool->segments[i], (size_t)SEGMENT_BYTES) && result;
+    }
+
+    // The header only ever describes blocks that are already on disk
+    header->open = open;
+    header->blockCount = pool->blockCount;
+    header->freeList = pool->freeList;
+    header->patientFirst = data->patients.blockCount ? data->patients.blocks[0] : -1;
+    header->slotCount = data->patients.slotCount;
+    header->appointFirst = data->appointments.blockCount ? data->appointments.blocks[0] : -1;
+    header->nameFirst = data->names.blockCount ? data->names.blocks[0] : -1;
+    header->checksum = imageChecksum(header);
+
+    return syncFileRange(&pool->image, header, STORE_IMAGE_HEADER_SIZE) && result;
+}
+
+// Unmap and close an image that failed to open, without writing to it
+static void discardImage(struct ClinicData* data)
+{
+    int i;
+
+    struct BlockPool* pool = &data->pool;
+
+    for (i = 0; i < pool->segmentCount; i++)
+    {
+        unmapFileRange(pool->segments[i], (size_t)SEGMENT_BYTES);
+    }
+    pool->segmentCount = 0;
+
+    if (pool->imageHeader != NULL)
+    {
+        unmapFileRange(pool->imageHeader, STORE_IMAGE_HEADER_SIZE);
+        pool->imageHeader = NULL;
+    }
+
+    closeMappedFile(&pool->image);
+
+    freeClinicData(data);
+}
+
+// Follow a chain of blocks from its first block, reading each link at
+// "nextOffset" in the block and filling "blocks" when it is not NULL
+// (returns the chain length or -1 if a link is out of range)
+static int walkImageChain(const struct BlockPool* pool, int first, size_t nextOffset,
+                          int* blocks)
+{
+    int block, count = 0;
+
+    for (block = first; block != -1 && count != -1; )
+    {
+        // A chain longer than the pool must loop back on itself
+        if (block < 0 || block >= pool->blockCount || count == pool->blockCount)
+        {
+            count = -1;
+        }
+        else
+        {
+            if (blocks != NULL)
+            {
+                blocks[count] = block;
+            }
+            count++;
+
+            block = *(const int*)((const char*)blockAt(pool, block) + nextOffset);
+        }
+    }
+
+    return count;
+}
+
+// Rebuild the table directories, counts, free slots and indexes from the
+// records of a mapped image (returns an error message or NULL)
+static const char* loadImageTables(struct ClinicData* data, const struct ImageHeader* header)
+{
+    int i, offset, length, used, count, patientBlocks, appointBlocks, nameBlocks;
+
+    unsigned int key;
+
+    const char* error = NULL;
+
+    struct PatientTable* patients = &data->patients;
+    struct AppointmentTable* appoints = &data->appointments;
+    struct NameArena* names = &data->names;
+    struct Patient patient;
+    struct NameBlock* block;
+
+    patientBlocks = walkImageChain(&data->pool, header->patientFirst,
+                                   offsetof(struct PatientBlock, next), NULL);
+    appointBlocks = walkImageChain(&data->pool, header->appointFirst,
+                                   offsetof(struct AppointmentBlock, next), NULL);
+    nameBlocks = walkImageChain(&data->pool, header->nameFirst,
+                                offsetof(struct NameBlock, next), NULL);
+
+    if (patientBlocks == -1 || appointBlocks == -1 || nameBlocks == -1 ||
+        header->slotCount < 0 ||
+        patientBlocks != (header->slotCount + PATIENT_BLOCK_LEN - 1) / PATIENT_BLOCK_LEN)
+    {
+        error = "table links are damaged";
+    }
+    else if ((patientBlocks && (patients->blocks = malloc(patientBlocks * sizeof(int))) == NULL) ||
+             (appointBlocks && (appoints->blocks = malloc(appointBlocks * sizeof(int))) == NULL) ||
+             (nameBlocks && (names->blocks = malloc(nameBlocks * sizeof(int))) == NULL))
+    {
+        error = "out of memory";
+    }
+    else
+    {
+        walkImageChain(&data->pool, header->patientFirst, offsetof(struct PatientBlock, next),
+                       patients->blocks);
+        walkImageChain(&data->pool, header->appointFirst,
+                       offsetof(struct AppointmentBlock, next), appoints->blocks);
+        walkImageChain(&data->pool, header->nameFirst, offsetof(struct NameBlock, next),
+                       names->blocks);
+
+        patients->blockCount = patientBlocks;
+        patients->slotCount = header->slotCount;
+        appoints->blockCount = appointBlocks;
+        appoints->capacity = appointBlocks;
+        names->blockCount = nameBlocks;
+
+        for (i = 0; i < appointBlocks && error == NULL; i++)
+        {
+            count = chainBlock(data, i)->count;
+
+            if (count < 0 || count > APPOINT_BLOCK_LEN)
+            {
+                error = "appointment block is damaged";
+            }
+            appoints->count += count;
+        }
+    }
+
+    // The intern table is rebuilt from the names themselves; a block whose
+    // last byte is not a terminator could send a name past its end
+    for (i = 0; i < names->blockCount && error == NULL; i++)
+    {
+        block = nameBlock(data, i);
+        used = nameBlockUsed(block);
+
+        if (block->text[NAME_BLOCK_BYTES - 1])
+        {
+            error = "name block is damaged";
+        }
+
+        for (offset = 0; offset < used && error == NULL; offset += length + 1)
+        {
+            length = (int)strlen(&block->text[offset]);
+
+            if (length && !fileNameRef(data, (unsigned int)i * NAME_BLOCK_BYTES + offset + 1))
+            {
+                error = "out of memory";
+            }
+        }
+
+        names->used = used;
+    }
+
+    // The indexes are not kept in the image; building them reads each
+    // record once and parses nothing
+    for (i = 0; i < patients->slotCount && error == NULL; i++)
+    {
+        readPatient(data, i, &patient);
+
+        if (patient.patientNumber && (patient.name == 0 ||
+            patient.name > (unsigned int)names->blockCount * NAME_BLOCK_BYTES))
+        {
+            error = "patient name is damaged";
+        }
+        else if (patient.patientNumber)
+        {
+            patients->liveCount++;
+            notePatientNumber(data, patient.patientNumber);
+
+            if ((findPatientSlot(&data->patientIndex, patient.patientNumber) == -1 &&
+                 !insertPatientSlot(&data->patientIndex, patient.patientNumber, i)) ||
+                !insertPhoneSlot(&data->phoneIndex, phoneNumberKey(&patient.phone), i))
+            {
+                error = "out of memory";
+            }
+        }
+        else
+        {
+            keepFreeSlot(patients, i);
+        }
+    }
+
+    for (i = firstAppointmentIndex(data); i != -1 && error == NULL;
+         i = nextAppointmentIndex(data, i))
+    {
+        key = appointmentKeyAt(data, i);
+
+        if (!addDayCount(&data->dayIndex, (int)(key >> KEY_DATE_SHIFT),
+                         (int)(key & KEY_SLOT_MASK)))
+        {
+            error = "out of memory";
+        }
+    }
+
+    return error;
+}
+
+
+//////////////////////////////////////
+// STORAGE FUNCTIONS
+//////////////////////////////////////
+
+// Set the record layout of clinics created from now on (STORE_ROWS or
+// STORE_COLUMNS); a clinic image keeps the layout it was created with
+void setStoreLayout(int layout)
+{
+    storeLayout = layout == STORE_COLUMNS ? STORE_COLUMNS : STORE_ROWS;
+}
+
+// Release every table, index and block owned by the clinic data
+void freeClinicData(struct ClinicData* data)
+{
+    struct PatientTable emptyPatients = { 0 };
+    struct AppointmentTable emptyAppointments = { 0 };
+    struct NameArena emptyNames = { 0 };
+
+    if (data != NULL)
+    {
+        if (data->pool.imageHeader != NULL && !syncImage(data, 0))
+        {
+            fprintf(stderr, "ERROR: The clinic image could not be written back!\n");
+        }
+
+        freePatientIndex(&data->patientIndex);
+        freePhoneIndex(&data->phoneIndex);
+        freeDayIndex(&data->dayIndex);
+
+        free(data->patients.blocks);
+        free(data->patients.freeSlots);
+        data->patients = emptyPatients;
+
+        free(data->appointments.blocks);
+        data->appointments = emptyAppointments;
+
+        free(data->names.blocks);
+        free(data->names.refs);
+        data->names = emptyNames;
+
+        freeBlockPool(&data->pool);
+    }
+}
+
+// Map a clinic image file as the storage of an empty clinic, creating the
+// file if missing, and rebuild the indexes from the mapped records (returns
+// 1 if the image holds a clinic, 0 if it was created empty or -1 if it
+// could not be opened)
+int openClinicImage(struct ClinicData* data, const char* imagefile)
+{
+    int i, segments, result = -1;
+
+    const char* error = NULL;
+
+    struct BlockPool* pool = &data->pool;
+    struct ImageHeader* header = NULL;
+    struct ImageHeader fresh = { 0 };
+
+    traceBegin(__func__);
+
+    memcpy(fresh.magic, IMAGE_MAGIC, sizeof(fresh.magic));
+
+    if (!openMappedFile(&pool->image, imagefile))
+    {
+        error = "could not be opened";
+    }
+    else if (pool->image.size == 0)
+    {
+        if (resizeMappedFile(&pool->image, STORE_IMAGE_HEADER_SIZE) &&
+            (header = mapFileRange(&pool->image, 0, STORE_IMAGE_HEADER_SIZE)) != NULL)
+        {
+            fresh.version = STORE_IMAGE_VERSION;
+            fresh.layout = storeLayout;
+            fresh.blockSize = STORE_BLOCK_SIZE;
+            fresh.patientSize = sizeof(struct Patient);
+            fresh.appointSize = sizeof(struct Appointment);
+            *header = fresh;
+
+            pool->layout = fresh.layout;
+            pool->imageHeader = header;
+            result = 0;
+        }
+        else
+        {
+            error = "could not be created";
+        }
+    }
+    else if (pool->image.size < STORE_IMAGE_HEADER_SIZE ||
+             (pool->image.size - STORE_IMAGE_HEADER_SIZE) % SEGMENT_BYTES != 0 ||
+             (header = mapFileRange(&pool->image, 0, STORE_IMAGE_HEADER_SIZE)) == NULL ||
+             memcmp(header->magic, fresh.magic, sizeof(fresh.magic)) != 0)
+    {
+        error = "is not a clinic image";
+    }
+    else if (header->version != STORE_IMAGE_VERSION || header->blockSize != STORE_BLOCK_SIZE ||
+             header->patientSize != (int)sizeof(struct Patient) ||
+             header->appointSize != (int)sizeof(struct Appointment))
+    {
+        error = "was written by a different version";
+    }
+    else if (header->checksum != imageChecksum(header))
+    {
+        error = "header checksum does not match";
+    }
+    else
+    {
+        segments = (int)((pool->image.size - STORE_IMAGE_HEADER_SIZE) / SEGMENT_BYTES);
+        pool->segments = malloc((segments + 1) * sizeof(char*));
+
+        for (i = 0; i < segments && pool->segments != NULL && error == NULL; i++)
+        {
+            pool->segments[i] = mapFileRange(&pool->image, STORE_IMAGE_HEADER_SIZE +
+                                             i * SEGMENT_BYTES, (size_t)SEGMENT_BYTES);
+
+            if (pool->segments[i] == NULL)
+            {
+                error = "could not be mapped";
+            }
+            else
+            {
+                pool->segmentCount++;
+            }
+        }
+
+        if (pool->segments == NULL)
+        {
+            error = "out of memory";
+        }
+        else if (error == NULL && (header->blockCount < 0 ||
+                 header->blockCount > segments * STORE_SEGMENT_BLOCKS ||
+                 header->freeList < 0 || header->freeList > header->blockCount ||
+                 (header->layout != STORE_ROWS && header->layout != STORE_COLUMNS)))
+        {
+            error = "header is damaged";
+        }
+
+        if (error == NULL)
+        {
+            pool->layout = header->layout;
+            pool->blockCount = header->blockCount;
+            pool->freeList = header->freeList;
+            pool->imageHeader = header;
+
+            if (header->open)
+            {
+                fprintf(stderr, "WARNING: %s was not closed cleanly, changes after the "
+                        "last sync may be lost\n", imagefile);
+            }
+
+            error = loadImageTables(data, header);
+            result = 1;
+        }
+    }
+
+    if (error == NULL && !syncImage(data, 1))
+    {
+        error = "could not be written";
+    }
+
+    if (error != NULL)
+    {
+        if (pool->imageHeader == NULL && header != NULL)
+        {
+            unmapFileRange(header, STORE_IMAGE_HEADER_SIZE);
+        }
+
+        fprintf(stderr, "ERROR: %s %s!\n", imagefile, error);
+        discardImage(data);
+        result = -1;
+    }
+
+    traceEnd(__func__);
+
+    return result;
+}
+
+// Write the changes of a mapped clinic to its image and update the header
+// (returns 0 if the sync failed; a heap-backed clinic has nothing to sync)
+int syncClinicImage(struct ClinicData* data)
+{
+    int result = 1;
+
+    traceBegin(__func__);
+
+    if (data->pool.imageHeader != NULL)
+    {
+        result = syncImage(data, 1);
+
+        if (!result)
+        {
+            fprintf(stderr, "ERROR: The clinic image could not be written!\n");
+        }
+    }
+
+    traceEnd(__func__);
+
+    return result;
+}
+
+// Copy the patient record in a slot (slot must be below slotCount)
+void readPatient(const struct ClinicData* data, int slot, struct Patient* patient)
+{
+    getBlockPatient(&data->pool, patientBlock(data, slot / PATIENT_BLOCK_LEN),
+                    slot % PATIENT_BLOCK_LEN, patient);
+}
+
+// Store a patient record in a slot (slot must be below slotCount)
+void writePatient(struct ClinicData* data, int slot, const struct Patient* patient)
+{
+    putBlockPatient(&data->pool, patientBlock(data, slot / PATIENT_BLOCK_LEN),
+                    slot % PATIENT_BLOCK_LEN, patient);
+}
+
+// Patient number in a slot (0 if the slot is empty)
+int patientNumberAt(const struct ClinicData* data, int slot)
+{
+    const struct PatientBlock* block = patientBlock(data, slot / PATIENT_BLOCK_LEN);
+
+    return data->pool.layout == STORE_COLUMNS ?
+           block->slots.columns.numbers[slot % PATIENT_BLOCK_LEN] :
+           block->slots.rows[slot % PATIENT_BLOCK_LEN].patientNumber;
+}
+
+// First slot at or after "slot" holding a patient (returns -1 if none)
+int nextPatientSlot(const struct ClinicData* data, int slot)
+{
+    int base, offset, end, found = -1;
+
+    const struct PatientBlock* block;
+
+    while (slot < data->patients.slotCount && found == -1)
+    {
+        base = slot - slot % PATIENT_BLOCK_LEN;
+        block = patientBlock(data, base / PATIENT_BLOCK_LEN);
+        offset = slot - base;
+        end = data->patients.slotCount - base < PATIENT_BLOCK_LEN ?
+              data->patients.slotCount - base : PATIENT_BLOCK_LEN;
+
+        // Each layout gets its own loop so the scan stays a tight one
+        if (data->pool.layout == STORE_COLUMNS)
+        {
+            while (offset < end && !block->slots.columns.numbers[offset])
+            {
+                offset++;
+            }
+        }
+        else
+        {
+            while (offset < end && !block->slots.rows[offset].patientNumber)
+            {
+                offset++;
+            }
+        }
+
+        if (offset < end)
+        {
+            found = base + offset;
+        }
+        else
+        {
+            slot = base + end;
+        }
+    }
+
+    return found;
+}
+
+// Fill "slots" with up to "max" slots of patients whose phone key is from
+// "low" to "high", scanning the whole table (returns # of patients found)
+int filterPatientsByPhone(const struct ClinicData* data, long long low, long long high,
+                          int* slots, int max)
+{
+    int i, b, count, selected, found = 0;
+
+    int offsets[PATIENT_BLOCK_LEN];
+
+    long long key;
+
+    unsigned long long bitmap[SCAN_BITMAP_WORDS(PATIENT_BLOCK_LEN)];
+    unsigned long long packedLow, packedHigh;
+
+    const struct PatientBlock* block;
+
+    // Phones hold the key above the contact type, so a range of keys is
+    // one range of packed phones
+    low = low > 0 ? low : 0;
+    packedLow = (unsigned long long)low << PHONE_TYPE_BITS;
+    packedHigh = (unsigned long long)high << PHONE_TYPE_BITS | ((1 << PHONE_TYPE_BITS) - 1);
+
+    for (b = 0; b < data->patients.blockCount && found < max && low <= high; b++)
+    {
+        block = patientBlock(data, b);
+        count = data->patients.slotCount - b * PATIENT_BLOCK_LEN;
+        count = count < PATIENT_BLOCK_LEN ? count : PATIENT_BLOCK_LEN;
+
+        // The patient number is only read to rule out an empty slot
+        if (data->pool.layout == STORE_COLUMNS)
+        {
+            selectRange64(block->slots.columns.phones, count, packedLow, packedHigh, bitmap);
+            selected = bitmapPositions(bitmap, count, 0, offsets, PATIENT_BLOCK_LEN);
+
+            for (i = 0; i < selected && found < max; i++)
+            {
+                if (block->slots.columns.numbers[offsets[i]])
+                {
+                    slots[found++] = b * PATIENT_BLOCK_LEN + offsets[i];
+                }
+            }
+        }
+        else
+        {
+            for (i = 0; i < count && found < max; i++)
+            {
+                key = (long long)(block->slots.rows[i].phone.packed >> PHONE_TYPE_BITS);
+
+                if (key >= low && key <= high && block->slots.rows[i].patientNumber)
+                {
+                    slots[found++] = b * PATIENT_BLOCK_LEN + i;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+// Get the name of a patient (the patient slot must be in use)
+const char* patientName(const struct ClinicData* data, const struct Patient* patient)
+{
+    return nameAt(data, patient->name);
+}
+
+// Find or store a name in the name arena (returns its reference or 0 if
+// out of memory)
+unsigned int internName(struct ClinicData* data, const char* name)
+{
+    return internArenaName(data, name, 1);
+}
+
+// Find or store a name in the name arena without starting a new arena
+// block, so only the intern table and the last block's free bytes change
+// (returns its reference, or 0 if it needs a new block or out of memory)
+unsigned int internNameInBlock(struct ClinicData* data, const char* name)
+{
+    return internArenaName(data, name, 0);
+}
+
+// Get an empty patient slot, growing the table if needed (returns -1 if out of memory)
+int allocPatientSlot(struct ClinicData* data)
+{
+    int slot, block;
+
+    int* blocks;
+
+    struct PatientTable* table = &data->patients;
+
+    if ((slot = takePatientSlot(data)) == -1)
+    {
+        // Only the small block directory is re-allocated; records never move
+        blocks = realloc(table->blocks, (table->blockCount + 1) * sizeof(int));
+
+        if (blocks != NULL)
+        {
+            table->blocks = blocks;
+            block = allocBlock(&data->pool);
+
+            if (block != -1)
+            {
+                ((struct PatientBlock*)blockAt(&data->pool, block))->next = -1;
+
+                if (table->blockCount)
+                {
+                    patientBlock(data, table->blockCount - 1)->next = block;
+                }
+
+                table->blocks[table->blockCount++] = block;
+                slot = table->slotCount++;
+                table->liveCount++;
+            }
+        }
+    }
+
+    return slot;
+}
+
+// Get an empty patient slot without growing the table, so only the free
+// list and counts change (returns -1 if every slot is in use)
+int takePatientSlot(struct ClinicData* data)
+{
+    int slot = -1;
+
+    struct PatientTable* table = &data->patients;
+
+    if (table->freeCount)
+    {
+        slot = table->freeSlots[--table->freeCount];
+    }
+    else if (table->slotCount < table->blockCount * PATIENT_BLOCK_LEN)
+    {
+        slot = table->slotCount++;
+    }
+
+    if (slot != -1)
+    {
+        table->liveCount++;
+    }
+
+    return slot;
+}
+
+// Empty a patient slot and keep it for re-use
+void clearPatientSlot(struct ClinicData* data, int slot)
+{
+    int number = patientNumberAt(data, slot);
+
+    struct PatientTable* table = &data->patients;
+    struct Patient empty = { 0 };
+
+    if (number && number == table->highestNumber)
+    {
+        table->highestStale = 1;
+    }
+
+    writePatient(data, slot, &empty);
+    table->liveCount--;
+
+    // A running compaction pass owns the slots from its write position up;
+    // the hole is squeezed out by the pass instead of being re-used
+    if (!table->compacting || slot < table->compactWrite)
+    {
+        keepFreeSlot(table, slot);
+    }
+}
+
+// Note the patient number stored in a newly filled slot
+void notePatientNumber(struct ClinicData* data, int patientNumber)
+{
+    if (patientNumber > data->patients.highestNumber)
+    {
+        data->patients.highestNumber = patientNumber;
+    }
+}
+
+// Take the next patient number before its patient is stored, so it is not
+// handed out again meanwhile; settlePatientNumber must follow (returns the
+// number)
+int reservePatientNumber(struct ClinicData* data)
+{
+    int patientNumber = highestPatientNumber(data) + 1;
+
+    notePatientNumber(data, patientNumber);
+    data->patients.reserved++;
+
+    return patientNumber;
+}
+
+// Settle a number from reservePatientNumber once its patient is stored
+// ("stored" set) or given up
+void settlePatientNumber(struct ClinicData* data, int patientNumber, int stored)
+{
+    struct PatientTable* table = &data->patients;
+
+    table->reserved--;
+
+    if (!stored && patientNumber == table->highestNumber)
+    {
+        table->highestStale = 1;
+    }
+}
+
+// Highest patient number stored (rescans only after the highest was
+// removed, and while no number is reserved)
+int highestPatientNumber(struct ClinicData* data)
+{
+    int i;
+
+    struct PatientTable* table = &data->patients;
+
+    // A rescan would miss the numbers reserved but not stored yet
+    if (table->highestStale && !table->reserved)
+    {
+        table->highestNumber = 0;
+
+        for (i = 0; i < table->slotCount; i++)
+        {
+            notePatientNumber(data, patientNumberAt(data, i));
+        }
+
+        table->highestStale = 0;
+    }
+
+    return table->highestNumber;
+}
+
+// Do a bounded amount of compaction work on both tables, starting a pass
+// when deletes have left them sparse (returns 1 while a pass is under way)
+int compactClinicData(struct ClinicData* data, int budget)
+{
+    budget = compactPatientStep(data, budget);
+    compactAppointmentStep(data, budget);
+
+    return data->patients.compacting || data->appointments.compacting;
+}
+
+// Copy the appointment at a position
+void readAppointment(const struct ClinicData* data, int pos, struct Appointment* appoint)
+{
+    getBlockAppointment(&data->pool, blockAt(&data->pool, pos / APPOINT_BLOCK_LEN),
+                        pos % APPOINT_BLOCK_LEN, appoint);
+}
+
+// Ordering key of the appointment at a position
+unsigned int appointmentKeyAt(const struct ClinicData* data, int pos)
+{
+    return blockKey(&data->pool, blockAt(&data->pool, pos / APPOINT_BLOCK_LEN),
+                    pos % APPOINT_BLOCK_LEN);
+}
+
+// Patient number of the appointment at a position
+int appointmentPatientAt(const struct ClinicData* data, int pos)
+{
+    const struct AppointmentBlock* block = blockAt(&data->pool, pos / APPOINT_BLOCK_LEN);
+
+    return data->pool.layout == STORE_COLUMNS ?
+           block->records.columns.patientNumbers[pos % APPOINT_BLOCK_LEN] :
+           block->records.rows[pos % APPOINT_BLOCK_LEN].patientNumber;
+}
+
+// Fill "positions" with up to "max" positions of a patient's appointments
+// in date/time order, scanning the whole table (returns # found)
+int filterAppointmentsByPatient(const struct ClinicData* data, int patientNumber,
+                                int* positions, int max)
+{
+    int i, d, base, found = 0;
+
+    unsigned long long bitmap[SCAN_BITMAP_WORDS(APPOINT_BLOCK_LEN)];
+
+    const struct AppointmentBlock* block;
+
+    for (d = 0; d < data->appointments.blockCount && found < max; d++)
+    {
+        block = chainBlock(data, d);
+        base = data->appointments.blocks[d] * APPOINT_BLOCK_LEN;
+
+        if (data->pool.layout == STORE_COLUMNS)
+        {
+            // A one-number range
+            if (selectRange32((const unsigned int*)block->records.columns.patientNumbers,
+                              block->count, (unsigned int)patientNumber,
+                              (unsigned int)patientNumber, bitmap))
+            {
+                found += bitmapPositions(bitmap, block->count, base, positions + found,
+                                         max - found);
+            }
+        }
+        else
+        {
+            for (i = 0; i < block->count && found < max; i++)
+            {
+                if (block->records.rows[i].patientNumber == patientNumber)
+                {
+                    positions[found++] = base + i;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+// Fill "positions" with up to "max" positions of the appointments whose
+// key is from "low" to "high", in date/time order (returns # found)
+int filterAppointmentsByKey(const struct ClinicData* data, unsigned int low, unsigned int high,
+                            int* positions, int max)
+{
+    int i, d, base, found = 0;
+
+    unsigned long long bitmap[SCAN_BITMAP_WORDS(APPOINT_BLOCK_LEN)];
+
+    struct Appointment first = { 0 };
+
+    const struct AppointmentBlock* block;
+
+    first.key = low;
+
+    // Keys are sorted, so only the blocks from the one "low" belongs in up
+    // to the first that starts after "high" can hold any
+    for (d = data->appointments.count ? findChainBlock(data, &first, 0) : 0;
+         d < data->appointments.blockCount && found < max &&
+         blockKey(&data->pool, chainBlock(data, d), 0) <= high;
+         d++)
+    {
+        block = chainBlock(data, d);
+        base = data->appointments.blocks[d] * APPOINT_BLOCK_LEN;
+
+        if (data->pool.layout == STORE_COLUMNS)
+        {
+            if (selectRange32(block->records.columns.keys, block->count, low, high, bitmap))
+            {
+                found += bitmapPositions(bitmap, block->count, base, positions + found,
+                                         max - found);
+            }
+        }
+        else
+        {
+            for (i = 0; i < block->count && found < max; i++)
+            {
+                if (block->records.rows[i].key >= low && block->records.rows[i].key <= high)
+                {
+                    positions[found++] = base + i;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+// Position of the earliest appointment (returns -1 if there are none)
+int firstAppointmentIndex(const struct ClinicData* data)
+{
+    int pos = -1;
+
+    if (data->appointments.count)
+    {
+        pos = data->appointments.blocks[0] * APPOINT_BLOCK_LEN;
+    }
+
+    return pos;
+}
+
+// Position following an appointment (returns -1 after the last one)
+int nextAppointmentIndex(const struct ClinicData* data, int pos)
+{
+    struct AppointmentBlock* block = blockAt(&data->pool, pos / APPOINT_BLOCK_LEN);
+
+    if (pos % APPOINT_BLOCK_LEN + 1 < block->count)
+    {
+        pos++;
+    }
+    else if (block->next != -1)
+    {
+        pos = block->next * APPOINT_BLOCK_LEN;
+    }
+    else
+    {
+        pos = -1;
+    }
+
+    return pos;
+}
+
+// Find the position of the first appointment at or after the date/time of
+// the given appointment (returns -1 if every appointment is earlier)
+int findAppointmentIndex(const struct ClinicData* data, const struct Appointment* appoint)
+{
+    int dirIndex, offset, pos = -1;
+
+    struct AppointmentBlock* block;
+
+    if (data->appointments.count)
+    {
+        dirIndex = findChainBlock(data, appoint, 0);
+        block = chainBlock(data, dirIndex);
+        offset = findBlockOffset(&data->pool, block, appoint, 0);
+
+        if (offset < block->count)
+        {
+            pos = data->appointments.blocks[dirIndex] * APPOINT_BLOCK_LEN + offset;
+        }
+        else if (block->next != -1)
+        {
+            pos = block->next * APPOINT_BLOCK_LEN;
+        }
+    }
+
+    return pos;
+}
+
+// Store an appointment at its sorted position, after any with the same
+// date/time (returns its position or -1 if out of memory)
+int storeAppointment(struct ClinicData* data, const struct Appointment* appoint)
+{
+    int dirIndex, offset, block, pos = -1;
+
+    struct AppointmentTable* table = &data->appointments;
+    struct AppointmentBlock* chain;
+
+    if (!table->blockCount && reserveChainEntry(table))
+    {
+        block = allocBlock(&data->pool);
+
+        if (block != -1)
+        {
+            chain = blockAt(&data->pool, block);
+            chain->next = -1;
+            table->blocks[table->blockCount++] = block;
+        }
+    }
+
+    if (table->blockCount)
+    {
+        dirIndex = findChainBlock(data, appoint, 1);
+        chain = chainBlock(data, dirIndex);
+        offset = findBlockOffset(&data->pool, chain, appoint, 1);
+
+        if (chain->count == APPOINT_BLOCK_LEN && splitChainBlock(data, dirIndex))
+        {
+            if (offset > chain->count)
+            {
+                offset -= chain->count;
+                dirIndex++;
+                chain = chainBlock(data, dirIndex);
+            }
+        }
+
+        if (chain->count < APPOINT_BLOCK_LEN)
+        {
+            moveBlockAppointments(&data->pool, chain, offset + 1, chain, offset,
+                                  chain->count - offset);
+            putBlockAppointment(&data->pool, chain, offset, appoint);
+            chain->count++;
+            table->count++;
+
+            pos = table->blocks[dirIndex] * APPOINT_BLOCK_LEN + offset;
+        }
+    }
+
+    return pos;
+}
+
+// Remove the appointment at a position (returns the position of the
+// appointment that followed it or -1 if it was the last one)
+int eraseAppointment(struct ClinicData* data, int pos)
+{
+    int dirIndex, block = pos / APPOINT_BLOCK_LEN, offset = pos % APPOINT_BLOCK_LEN;
+
+    struct AppointmentTable* table = &data->appointments;
+    struct AppointmentBlock* chain = blockAt(&data->pool, block);
+    struct Appointment first;
+
+    if (chain->count == 1)
+    {
+        // Unlink the emptied block; blocks sharing its first date/time are
+        // next to each other in the directory
+        getBlockAppointment(&data->pool, chain, 0, &first);
+        dirIndex = findChainBlock(data, &first, 0);
+
+        while (table->blocks[dirIndex] != block)
+        {
+            dirIndex++;
+        }
+
+        if (dirIndex > 0)
+        {
+            chainBlock(data, dirIndex - 1)->next = chain->next;
+        }
+
+        memmove(&table->blocks[dirIndex], &table->blocks[dirIndex + 1],
+                (table->blockCount - dirIndex - 1) * sizeof(int));
+        table->blockCount--;
+
+        pos = chain->next != -1 ? chain->next * APPOINT_BLOCK_LEN : -1;
+
+        recycleBlock(&data->pool, block);
+    }
+    else
+    {
+        moveBlockAppointments(&data->pool, chain, offset, chain, offset + 1,
+                              chain->count - offset - 1);
+        chain->count--;
+
+        if (offset == chain->count)
+        {
+            pos = chain->next != -1 ? chain->next * APPOINT_BLOCK_LEN : -1;
+        }
+    }
+
+    table->count--;
+
+    return pos;
+}
+
+// Number of the block a date/time is looked up in: the last whose first
+// appointment is before it (or not after it when "after" is set); only the
+// blocks' first appointments are read (returns -1 if there are none)
+int findAppointmentBlock(const struct ClinicData* data, const struct Appointment* appoint,
+                         int after)
+{
+    int block = -1;
+
+    if (data->appointments.blockCount)
+    {
+        block = data->appointments.blocks[findChainBlock(data, appoint, after)];
+    }
+
+    return block;
+}
+
+// Block following one in date/time order when its first appointment's key
+// is not after "high" (returns -1 otherwise or after the last block)
+int nextAppointmentBlock(const struct ClinicData* data, int block, unsigned int high)
+{
+    struct AppointmentBlock* chain = blockAt(&data->pool, block);
+
+    int next = chain->next;
+
+    if (next != -1 && blockKey(&data->pool, blockAt(&data->pool, next), 0) > high)
+    {
+        next = -1;
+    }
+
+    return next;
+}
+
+// Copy up to "max" of a block's appointments whose key is from "low" to
+// "high", in date/time order (returns # copied)
+int readBlockAppointments(const struct ClinicData* data, int block, unsigned int low,
+                          unsigned int high, struct Appointment* appoints, int max)
+{
+    int offset, count = 0;
+
+    struct AppointmentBlock* chain = blockAt(&data->pool, block);
+    struct Appointment first = { 0 };
+
+    first.key = low;
+
+    for (offset = findBlockOffset(&data->pool, chain, &first, 0);
+         offset < chain->count && count < max && blockKey(&data->pool, chain, offset) <= high;
+         offset++)
+    {
+        getBlockAppointment(&data->pool, chain, offset, &appoints[count++]);
+    }
+
+    return count;
+}
+
+// Position of the appointment with the same patient, date and time in a
+// block (returns -1 if the block does not hold it)
+int findBlockAppointment(const struct ClinicData* data, int block,
+                         const struct Appointment* appoint)
+{
+    int offset, found = -1;
+
+    struct AppointmentBlock* chain = blockAt(&data->pool, block);
+
+    for (offset = findBlockOffset(&data->pool, chain, appoint, 0);
+         offset < chain->count && found == -1 &&
+         blockKey(&data->pool, chain, offset) == appoint->key;
+         offset++)
+    {
+        if (appointmentPatientAt(data, block * APPOINT_BLOCK_LEN + offset) ==
+            appoint->patientNumber)
+        {
+            found = block * APPOINT_BLOCK_LEN + offset;
+        }
+    }
+
+    return found;
+}
+
+// Store an appointment in the block findAppointmentBlock gives for it
+// with "after" set, when the block has room and the appointment does not
+// go first, so no other block, first appointment or the directory changes;
+// the caller counts it in the table (returns its position, or -1 and
+// stores nothing otherwise)
+int storeBlockAppointment(struct ClinicData* data, int block, const struct Appointment* appoint)
+{
+    int offset, pos = -1;
+
+    struct AppointmentBlock* chain = blockAt(&data->pool, block);
+
+    offset = findBlockOffset(&data->pool, chain, appoint, 1);
+
+    if (offset > 0 && chain->count < APPOINT_BLOCK_LEN)
+    {
+        moveBlockAppointments(&data->pool, chain, offset + 1, chain, offset,
+                              chain->count - offset);
+        putBlockAppointment(&data->pool, chain, offset, appoint);
+        chain->count++;
+
+        pos = block * APPOINT_BLOCK_LEN + offset;
+    }
+
+    return pos;
+}
+
+// Remove the appointment at a position when it is not the first of its
+// block, so no other block, first appointment or the directory changes;
+// the caller uncounts it from the table (returns 1 if appointments are
+// left at its date/time, 0 if none are, or -1 and removes nothing if it is
+// its block's first)
+int eraseBlockAppointment(struct ClinicData* data, int pos)
+{
+    int block = pos / APPOINT_BLOCK_LEN, offset = pos % APPOINT_BLOCK_LEN, result = -1;
+
+    unsigned int key;
+
+    struct AppointmentBlock* chain = blockAt(&data->pool, block);
+
+    if (offset > 0)
+    {
+        key = blockKey(&data->pool, chain, offset);
+
+        moveBlockAppointments(&data->pool, chain, offset, chain, offset + 1,
+                              chain->count - offset - 1);
+        chain->count--;
+
+        // The appointment before it is in the block, so any left at the
+        // same date/time are next to it there or start the next block
+        if (blockKey(&data->pool, chain, offset - 1) == key)
+        {
+            result = 1;
+        }
+        else if (offset < chain->count)
+        {
+            result = blockKey(&data->pool, chain, offset) == key;
+        }
+        else
+        {
+            result = chain->next != -1 &&
+                     blockKey(&data->pool, blockAt(&data->pool, chain->next), 0) == key;
+        }
+    }
+
+    return result;
+}
+
+// Replace every appointment with an already sorted array (returns 0 if out of memory)
+int loadAppointments(struct ClinicData* data, const struct Appointment* appoints, int count)
+{
+    int i, j, len, block, result = 1;
+
+    struct AppointmentTable* table = &data->appointments;
+    struct AppointmentBlock* chain = NULL;
+
+    freeAppointmentChain(data);
+
+    for (i = 0; i < count && result; i += len)
+    {
+        len = count - i < APPOINT_LOAD_LEN ? count - i : APPOINT_LOAD_LEN;
+
+        block = reserveChainEntry(table) ? allocBlock(&data->pool) : -1;
+
+        if (block != -1)
+        {
+            if (chain != NULL)
+            {
+                chain->next = block;
+            }
+
+            chain = blockAt(&data->pool, block);
+            chain->count = len;
+            chain->next = -1;
+            if (data->pool.layout == STORE_COLUMNS)
+            {
+                for (j = 0; j < len; j++)
+                {
+                    putBlockAppointment(&data->pool, chain, j, &appoints[i + j]);
+                }
+            }
+            else
+            {
+                memcpy(chain->records.rows, &appoints[i], len * sizeof(struct Appointment));
+            }
+
+            table->blocks[table->blockCount++] = block;
+            table->count += len;
+        }
+        else
+        {
+            result = 0;
+        }
+    }
+
+    return result;
+}
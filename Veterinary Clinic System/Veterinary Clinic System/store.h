@@ -0,0 +1,265 @@
+#ifndef STORE_H
+#define STORE_H
+
+#include "mapfile.h"
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// Every table is built from fixed-size blocks carved out of larger segments
+#define STORE_BLOCK_SIZE 8192
+#define STORE_SEGMENT_BLOCKS 64
+
+// Records the compaction pass may examine or move per call from the menus
+#define STORE_COMPACT_BUDGET 256
+
+// How the blocks of a pool lay out their records
+#define STORE_ROWS 0        // each record's fields together (array of structs)
+#define STORE_COLUMNS 1     // each field in its own array (struct of arrays)
+
+// Clinic image files: a header area followed by the pool's segments
+#define STORE_IMAGE_VERSION 5
+#define STORE_IMAGE_HEADER_SIZE 65536
+
+//////////////////////////////////////
+// Structures
+//////////////////////////////////////
+
+struct ClinicData;
+struct Patient;
+struct Appointment;
+
+// Data type: BlockPool
+// Arena that hands out STORE_BLOCK_SIZE blocks by number.  Segments are
+// never moved or freed while the pool is alive, so a block's address stays
+// valid as the pool grows.  Segments come from the heap, or from a clinic
+// image file when one is open; then every block lives in the file.  The
+// record layout of every table block is fixed when the first segment is
+// created (see setStoreLayout).  A zeroed structure is a valid empty heap pool.
+struct BlockPool
+{
+    char** segments;    // STORE_SEGMENT_BLOCKS blocks per segment
+    int segmentCount;
+    int layout;         // STORE_ROWS or STORE_COLUMNS
+    int blockCount;     // blocks handed out from the segments so far
+    int freeList;       // 1 + number of the first recycled block (0 if none)
+    struct MappedFile image;    // clinic image the segments are mapped from
+    void* imageHeader;          // mapped header area (NULL for a heap pool)
+};
+
+// Data type: PatientTable
+// Patient records live in numbered slots and the indexes refer to them by
+// slot number.  Emptied slots are kept on a free list for re-use; once they
+// pile up, compaction slides the live records down over them (keeping
+// their order) and rewrites the index entries of each record it moves.
+// Each block also links to the next so a clinic image can find them.
+struct PatientTable
+{
+    int* blocks;        // block number holding each run of slots
+    int blockCount;
+    int slotCount;      // slots handed out so far (used or emptied)
+    int liveCount;      // slots holding a patient
+    int* freeSlots;     // emptied slots ready for re-use (last in, first out)
+    int freeCount;
+    int freeCapacity;
+    int highestNumber;  // highest patient number stored...
+    int highestStale;   // ...unless set: the highest was removed, rescan
+    int reserved;       // numbers reserved whose patients are not settled
+    int compacting;     // set while a compaction pass is under way
+    int compactRead;    // next slot the pass examines
+    int compactWrite;   // next slot the pass fills (the slots between are empty)
+};
+
+// Data type: NameArena
+// Patient names stored end to end (each with its terminator) in a chain of
+// linked blocks.  A name is referred to by 1 + its byte position across
+// the chain, so references stay valid as the arena grows, and the intern
+// table (open addressing on the name's hash) finds a name already stored
+// so patients sharing a name share its bytes.  Names are never removed.
+struct NameArena
+{
+    int* blocks;        // block number holding each run of names
+    int blockCount;
+    int used;           // bytes used in the last block
+    unsigned int* refs; // intern table of name references (0: empty bucket)
+    int refCapacity;    // buckets in "refs" (a power of 2)
+    int nameCount;      // distinct names stored
+};
+
+// Data type: AppointmentTable
+// Appointments are kept sorted by ordering key in a chain of blocks.  The
+// block directory lists the chain in order so a date/time is found by
+// binary search; inserts and deletes shift records inside one block only.
+// storeBlockAppointment and eraseBlockAppointment change one block without
+// touching the directory or any first record, so only readers of that
+// block have to wait for them.
+struct AppointmentTable
+{
+    int* blocks;        // block numbers in date/time order
+    int blockCount;
+    int capacity;       // entries allocated in "blocks"
+    int count;          // appointments stored
+    int compacting;     // set while under-filled blocks are being merged
+    int compactCursor;  // directory position the merge pass examines next
+    int idleCount;      // "count" when a pass last merged nothing (0: none
+                        // has); the next one waits until fewer are stored
+};
+
+
+//////////////////////////////////////
+// STORAGE FUNCTIONS
+//////////////////////////////////////
+
+// Set the record layout of clinics created from now on (STORE_ROWS or
+// STORE_COLUMNS); a clinic image keeps the layout it was created with
+void setStoreLayout(int layout);
+
+// Release every table, index and block owned by the clinic data; a mapped
+// clinic is written back to its image first
+void freeClinicData(struct ClinicData* data);
+
+// Map a clinic image file as the storage of an empty clinic, creating the
+// file if missing, and rebuild the indexes from the mapped records (returns
+// 1 if the image holds a clinic, 0 if it was created empty or -1 if it
+// could not be opened)
+int openClinicImage(struct ClinicData* data, const char* imagefile);
+
+// Write the changes of a mapped clinic to its image and update the header
+// (returns 0 if the sync failed; a heap-backed clinic has nothing to sync)
+int syncClinicImage(struct ClinicData* data);
+
+// Copy the patient record in a slot (slot must be below slotCount)
+void readPatient(const struct ClinicData* data, int slot, struct Patient* patient);
+
+// Store a patient record in a slot (slot must be below slotCount)
+void writePatient(struct ClinicData* data, int slot, const struct Patient* patient);
+
+// Patient number in a slot (0 if the slot is empty)
+int patientNumberAt(const struct ClinicData* data, int slot);
+
+// First slot at or after "slot" holding a patient (returns -1 if none)
+int nextPatientSlot(const struct ClinicData* data, int slot);
+
+// Fill "slots" with up to "max" slots of patients whose phone key is from
+// "low" to "high", scanning the whole table (returns # of patients found)
+int filterPatientsByPhone(const struct ClinicData* data, long long low, long long high,
+                          int* slots, int max);
+
+// Get the name of a patient (the patient slot must be in use)
+const char* patientName(const struct ClinicData* data, const struct Patient* patient);
+
+// Find or store a name in the name arena (returns its reference or 0 if
+// out of memory)
+unsigned int internName(struct ClinicData* data, const char* name);
+
+// Find or store a name in the name arena without starting a new arena
+// block, so only the intern table and the last block's free bytes change
+// (returns its reference, or 0 if it needs a new block or out of memory)
+unsigned int internNameInBlock(struct ClinicData* data, const char* name);
+
+// Get an empty patient slot, growing the table if needed (returns -1 if out of memory)
+int allocPatientSlot(struct ClinicData* data);
+
+// Get an empty patient slot without growing the table, so only the free
+// list and counts change (returns -1 if every slot is in use)
+int takePatientSlot(struct ClinicData* data);
+
+// Empty a patient slot and keep it for re-use
+void clearPatientSlot(struct ClinicData* data, int slot);
+
+// Note the patient number stored in a newly filled slot
+void notePatientNumber(struct ClinicData* data, int patientNumber);
+
+// Take the next patient number before its patient is stored, so it is not
+// handed out again meanwhile; settlePatientNumber must follow (returns the
+// number)
+int reservePatientNumber(struct ClinicData* data);
+
+// Settle a number from reservePatientNumber once its patient is stored
+// ("stored" set) or given up
+void settlePatientNumber(struct ClinicData* data, int patientNumber, int stored);
+
+// Highest patient number stored (rescans only after the highest was
+// removed, and while no number is reserved)
+int highestPatientNumber(struct ClinicData* data);
+
+// Do a bounded amount of compaction work on both tables, starting a pass
+// when deletes have left them sparse (returns 1 while a pass is under way)
+int compactClinicData(struct ClinicData* data, int budget);
+
+// Copy the appointment at a position
+void readAppointment(const struct ClinicData* data, int pos, struct Appointment* appoint);
+
+// Ordering key of the appointment at a position
+unsigned int appointmentKeyAt(const struct ClinicData* data, int pos);
+
+// Patient number of the appointment at a position
+int appointmentPatientAt(const struct ClinicData* data, int pos);
+
+// Fill "positions" with up to "max" positions of a patient's appointments
+// in date/time order, scanning the whole table (returns # found)
+int filterAppointmentsByPatient(const struct ClinicData* data, int patientNumber,
+                                int* positions, int max);
+
+// Fill "positions" with up to "max" positions of the appointments whose
+// key is from "low" to "high", in date/time order (returns # found)
+int filterAppointmentsByKey(const struct ClinicData* data, unsigned int low, unsigned int high,
+                            int* positions, int max);
+
+// Position of the earliest appointment (returns -1 if there are none)
+int firstAppointmentIndex(const struct ClinicData* data);
+
+// Position following an appointment (returns -1 after the last one)
+int nextAppointmentIndex(const struct ClinicData* data, int pos);
+
+// Find the position of the first appointment at or after the date/time of
+// the given appointment (returns -1 if every appointment is earlier)
+int findAppointmentIndex(const struct ClinicData* data, const struct Appointment* appoint);
+
+// Store an appointment at its sorted position, after any with the same
+// date/time (returns its position or -1 if out of memory)
+int storeAppointment(struct ClinicData* data, const struct Appointment* appoint);
+
+// Remove the appointment at a position (returns the position of the
+// appointment that followed it or -1 if it was the last one)
+int eraseAppointment(struct ClinicData* data, int pos);
+
+// Number of the block a date/time is looked up in: the last whose first
+// appointment is before it (or not after it when "after" is set); only the
+// blocks' first appointments are read (returns -1 if there are none)
+int findAppointmentBlock(const struct ClinicData* data, const struct Appointment* appoint,
+                         int after);
+
+// Block following one in date/time order when its first appointment's key
+// is not after "high" (returns -1 otherwise or after the last block)
+int nextAppointmentBlock(const struct ClinicData* data, int block, unsigned int high);
+
+// Copy up to "max" of a block's appointments whose key is from "low" to
+// "high", in date/time order (returns # copied)
+int readBlockAppointments(const struct ClinicData* data, int block, unsigned int low,
+                          unsigned int high, struct Appointment* appoints, int max);
+
+// Position of the appointment with the same patient, date and time in a
+// block (returns -1 if the block does not hold it)
+int findBlockAppointment(const struct ClinicData* data, int block,
+                         const struct Appointment* appoint);
+
+// Store an appointment in the block findAppointmentBlock gives for it
+// with "after" set, when the block has room and the appointment does not
+// go first, so no other block, first appointment or the directory changes;
+// the caller counts it in the table (returns its position, or -1 and
+// stores nothing otherwise)
+int storeBlockAppointment(struct ClinicData* data, int block, const struct Appointment* appoint);
+
+// Remove the appointment at a position when it is not the first of its
+// block, so no other block, first appointment or the directory changes;
+// the caller uncounts it from the table (returns 1 if appointments are
+// left at its date/time, 0 if none are, or -1 and removes nothing if it is
+// its block's first)
+int eraseBlockAppointment(struct ClinicData* data, int pos);
+
+// Replace every appointment with an already sorted array (returns 0 if out of memory)
+int loadAppointments(struct ClinicData* data, const struct Appointment* appoints, int count);
+
+#endif // !STORE_H
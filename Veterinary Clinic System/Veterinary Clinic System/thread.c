@@ -0,0 +1,289 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "stats.h"
+#include "thread.h"
+#include "trace.h"
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+#ifdef _WIN32
+
+// Entry point handed to the operating system
+static DWORD WINAPI threadMain(LPVOID arg)
+{
+    struct Thread* thread = arg;
+
+    thread->run(thread->arg);
+
+    releaseTraceRing();
+    releaseThreadStats();
+
+    return 0;
+}
+
+#else
+
+// Entry point handed to the operating system
+static void* threadMain(void* arg)
+{
+    struct Thread* thread = arg;
+
+    thread->run(thread->arg);
+
+    releaseTraceRing();
+    releaseThreadStats();
+
+    return NULL;
+}
+
+#endif
+
+
+//////////////////////////////////////
+// THREAD FUNCTIONS
+//////////////////////////////////////
+
+// Start running "run(arg)" on a new thread (returns 0 if it could not start)
+int startThread(struct Thread* thread, void (*run)(void* arg), void* arg)
+{
+    thread->run = run;
+    thread->arg = arg;
+
+#ifdef _WIN32
+    thread->handle = CreateThread(NULL, 0, threadMain, thread, 0, NULL);
+#else
+    thread->handle = malloc(sizeof(pthread_t));
+
+    if (thread->handle != NULL && pthread_create(thread->handle, NULL, threadMain, thread) != 0)
+    {
+        free(thread->handle);
+        thread->handle = NULL;
+    }
+#endif
+
+    return thread->handle != NULL;
+}
+
+// Wait for a started thread to finish and release it
+void joinThread(struct Thread* thread)
+{
+    if (thread->handle != NULL)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(thread->handle, INFINITE);
+        CloseHandle(thread->handle);
+#else
+        pthread_join(*(pthread_t*)thread->handle, NULL);
+        free(thread->handle);
+#endif
+        thread->handle = NULL;
+    }
+}
+
+// Number of processors available to the program (at least 1)
+int processorCount(void)
+{
+    int count;
+
+#ifdef _WIN32
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    count = (int)info.dwNumberOfProcessors;
+#else
+    count = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return count > 0 ? count : 1;
+}
+
+// Take a flag that is 0, setting it to 1 (returns 0 if another thread has
+// it); what its last holder wrote before releaseFlag is then visible
+int claimFlag(volatile long* flag)
+{
+#if defined(_MSC_VER)
+    return _InterlockedCompareExchange(flag, 1, 0) == 0;
+#else
+    long expected = 0;
+
+    return __atomic_compare_exchange_n(flag, &expected, 1, 0, __ATOMIC_ACQUIRE,
+                                       __ATOMIC_RELAXED);
+#endif
+}
+
+// Set a flag taken by claimFlag back to 0 once everything written before
+// is visible
+void releaseFlag(volatile long* flag)
+{
+#if defined(_MSC_VER)
+    // MSVC's volatile stores have release semantics on x86 and x64
+    *flag = 0;
+#else
+    __atomic_store_n(flag, 0, __ATOMIC_RELEASE);
+#endif
+}
+
+// Read a flag other threads claim and release, as a cheap check before
+// claimFlag (returns 1 if it is taken; it can change right after)
+int flagTaken(volatile long* flag)
+{
+#if defined(_MSC_VER)
+    return *flag != 0;
+#else
+    return __atomic_load_n(flag, __ATOMIC_RELAXED) != 0;
+#endif
+}
+
+
+//////////////////////////////////////
+// LOCK FUNCTIONS
+//////////////////////////////////////
+
+// Create an unlocked mutex (returns 0 if out of memory)
+int initMutex(struct Mutex* mutex)
+{
+#ifdef _WIN32
+    mutex->handle = malloc(sizeof(CRITICAL_SECTION));
+
+    if (mutex->handle != NULL)
+    {
+        InitializeCriticalSection(mutex->handle);
+    }
+#else
+    mutex->handle = malloc(sizeof(pthread_mutex_t));
+
+    if (mutex->handle != NULL && pthread_mutex_init(mutex->handle, NULL) != 0)
+    {
+        free(mutex->handle);
+        mutex->handle = NULL;
+    }
+#endif
+
+    return mutex->handle != NULL;
+}
+
+// Wait for a mutex and take it
+void lockMutex(struct Mutex* mutex)
+{
+#ifdef _WIN32
+    EnterCriticalSection(mutex->handle);
+#else
+    pthread_mutex_lock(mutex->handle);
+#endif
+}
+
+// Let go of a mutex this thread holds
+void unlockMutex(struct Mutex* mutex)
+{
+#ifdef _WIN32
+    LeaveCriticalSection(mutex->handle);
+#else
+    pthread_mutex_unlock(mutex->handle);
+#endif
+}
+
+// Release an unlocked mutex (one that was never created is skipped)
+void freeMutex(struct Mutex* mutex)
+{
+    if (mutex->handle != NULL)
+    {
+#ifdef _WIN32
+        DeleteCriticalSection(mutex->handle);
+#else
+        pthread_mutex_destroy(mutex->handle);
+#endif
+        free(mutex->handle);
+        mutex->handle = NULL;
+    }
+}
+
+// Create an unlocked reader/writer lock (returns 0 if out of memory)
+int initRwLock(struct RwLock* lock)
+{
+#ifdef _WIN32
+    lock->handle = malloc(sizeof(SRWLOCK));
+
+    if (lock->handle != NULL)
+    {
+        InitializeSRWLock(lock->handle);
+    }
+#else
+    lock->handle = malloc(sizeof(pthread_rwlock_t));
+
+    if (lock->handle != NULL && pthread_rwlock_init(lock->handle, NULL) != 0)
+    {
+        free(lock->handle);
+        lock->handle = NULL;
+    }
+#endif
+
+    return lock->handle != NULL;
+}
+
+// Wait until no writer holds the lock and take it as one of its readers
+void readLock(struct RwLock* lock)
+{
+#ifdef _WIN32
+    AcquireSRWLockShared(lock->handle);
+#else
+    pthread_rwlock_rdlock(lock->handle);
+#endif
+}
+
+// Let go of the lock taken by readLock
+void readUnlock(struct RwLock* lock)
+{
+#ifdef _WIN32
+    ReleaseSRWLockShared(lock->handle);
+#else
+    pthread_rwlock_unlock(lock->handle);
+#endif
+}
+
+// Wait until no one holds the lock and take it alone
+void writeLock(struct RwLock* lock)
+{
+#ifdef _WIN32
+    AcquireSRWLockExclusive(lock->handle);
+#else
+    pthread_rwlock_wrlock(lock->handle);
+#endif
+}
+
+// Let go of the lock taken by writeLock
+void writeUnlock(struct RwLock* lock)
+{
+#ifdef _WIN32
+    ReleaseSRWLockExclusive(lock->handle);
+#else
+    pthread_rwlock_unlock(lock->handle);
+#endif
+}
+
+// Release an unlocked reader/writer lock (one that was never created is
+// skipped)
+void freeRwLock(struct RwLock* lock)
+{
+    if (lock->handle != NULL)
+    {
+#ifndef _WIN32
+        pthread_rwlock_destroy(lock->handle);
+#endif
+        free(lock->handle);
+        lock->handle = NULL;
+    }
+}
@@ -0,0 +1,107 @@
+#ifndef THREAD_H
+#define THREAD_H
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// Storage class of a variable each thread has its own copy of
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+
+//////////////////////////////////////
+// Structures
+//////////////////////////////////////
+
+// Data type: Thread
+// A worker thread running one function; Windows threads under MSVC and
+// POSIX threads elsewhere (link with -pthread)
+struct Thread
+{
+    void (*run)(void* arg);
+    void* arg;
+    void* handle;       // platform thread handle (owned by thread.c)
+};
+
+// Data type: Mutex
+// A lock one thread holds at a time (not recursive)
+struct Mutex
+{
+    void* handle;       // platform lock (owned by thread.c)
+};
+
+// Data type: RwLock
+// A lock many readers hold at once, or one writer alone (not recursive;
+// a reader cannot become the writer without letting go first)
+struct RwLock
+{
+    void* handle;       // platform lock (owned by thread.c)
+};
+
+
+//////////////////////////////////////
+// THREAD FUNCTIONS
+//////////////////////////////////////
+
+// Start running "run(arg)" on a new thread (returns 0 if it could not start)
+int startThread(struct Thread* thread, void (*run)(void* arg), void* arg);
+
+// Wait for a started thread to finish and release it
+void joinThread(struct Thread* thread);
+
+// Number of processors available to the program (at least 1)
+int processorCount(void);
+
+// Take a flag that is 0, setting it to 1 (returns 0 if another thread has
+// it); what its last holder wrote before releaseFlag is then visible
+int claimFlag(volatile long* flag);
+
+// Set a flag taken by claimFlag back to 0 once everything written before
+// is visible
+void releaseFlag(volatile long* flag);
+
+// Read a flag other threads claim and release, as a cheap check before
+// claimFlag (returns 1 if it is taken; it can change right after)
+int flagTaken(volatile long* flag);
+
+
+//////////////////////////////////////
+// LOCK FUNCTIONS
+//////////////////////////////////////
+
+// Create an unlocked mutex (returns 0 if out of memory)
+int initMutex(struct Mutex* mutex);
+
+// Wait for a mutex and take it
+void lockMutex(struct Mutex* mutex);
+
+// Let go of a mutex this thread holds
+void unlockMutex(struct Mutex* mutex);
+
+// Release an unlocked mutex (one that was never created is skipped)
+void freeMutex(struct Mutex* mutex);
+
+// Create an unlocked reader/writer lock (returns 0 if out of memory)
+int initRwLock(struct RwLock* lock);
+
+// Wait until no writer holds the lock and take it as one of its readers
+void readLock(struct RwLock* lock);
+
+// Let go of the lock taken by readLock
+void readUnlock(struct RwLock* lock);
+
+// Wait until no one holds the lock and take it alone
+void writeLock(struct RwLock* lock);
+
+// Let go of the lock taken by writeLock
+void writeUnlock(struct RwLock* lock);
+
+// Release an unlocked reader/writer lock (one that was never created is
+// skipped)
+void freeRwLock(struct RwLock* lock);
+
+#endif // !THREAD_H
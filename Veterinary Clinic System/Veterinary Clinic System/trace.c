@@ -0,0 +1,318 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Recording takes no lock: each thread writes only the ring it claimed,
+// publishing each event by storing the ring's count after it, and rings
+// are claimed with claimFlag.  MSVC's volatile loads and stores have
+// acquire and release semantics on x86 and x64.
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "stats.h"
+#include "thread.h"
+#include "trace.h"
+
+#ifdef CLINIC_TRACE
+
+// Data type: TraceEvent (the start or end of a call; the name is the
+// function's, which needs no escaping in JSON)
+struct TraceEvent
+{
+    unsigned long long ticks;
+    const char* name;
+    char phase;                         // 'B' begin or 'E' end
+};
+
+// Data type: TraceRing
+// The last TRACE_EVENTS events recorded by the threads that owned it;
+// "count" counts every event ever recorded, so event i is at
+// i % TRACE_EVENTS
+struct TraceRing
+{
+    volatile long owned;
+    volatile long long count;
+    struct TraceEvent* events;
+};
+
+static struct TraceRing rings[TRACE_THREADS];
+
+static THREAD_LOCAL struct TraceRing* threadRing;
+
+static volatile int tracing;
+
+static const char* traceFileName;
+static double traceSeconds;
+static unsigned long long traceStartTicks;
+
+
+//////////////////////////////////////
+// HELPER FUNCTIONS
+//////////////////////////////////////
+
+// Publish a ring's count once the events written before are visible
+static void storeCount(volatile long long* count, long long value)
+{
+#if defined(_MSC_VER)
+    *count = value;
+#else
+    __atomic_store_n(count, value, __ATOMIC_RELEASE);
+#endif
+}
+
+// Read a ring's count: the events below it are then visible, and the
+// reads made before it are done
+static long long loadCount(volatile long long* count)
+{
+#if defined(_MSC_VER)
+    _ReadBarrier();
+    return *count;
+#else
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(count, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Claim a free ring for this thread, allocating its events the first time
+// (returns NULL if every ring is taken or out of memory)
+static struct TraceRing* claimRing(void)
+{
+    int i;
+
+    struct TraceRing* ring = NULL;
+
+    for (i = 0; i < TRACE_THREADS && ring == NULL; i++)
+    {
+        if (!flagTaken(&rings[i].owned) && claimFlag(&rings[i].owned))
+        {
+            ring = &rings[i];
+
+            if (ring->events == NULL &&
+                (ring->events = malloc(TRACE_EVENTS * sizeof(struct TraceEvent))) == NULL)
+            {
+                releaseFlag(&ring->owned);
+                ring = NULL;
+            }
+        }
+    }
+
+    threadRing = ring;
+
+    return ring;
+}
+
+// Record an event on this thread's ring
+static void recordEvent(const char* name, char phase)
+{
+    long long count;
+
+    struct TraceEvent* event;
+    struct TraceRing* ring = threadRing != NULL ? threadRing : claimRing();
+
+    if (ring != NULL)
+    {
+        count = ring->count;
+
+        event = &ring->events[count & (TRACE_EVENTS - 1)];
+        event->ticks = statTicks();
+        event->name = name;
+        event->phase = phase;
+
+        storeCount(&ring->count, count + 1);
+    }
+}
+
+// Copy the events a ring still holds to "copy", oldest first, leaving out
+// any its owner overwrote while they were copied (returns # of events)
+static int copyRing(struct TraceRing* ring, struct TraceEvent copy[])
+{
+    long long i, first, last, valid;
+
+    last = loadCount(&ring->count);
+    first = last > TRACE_EVENTS ? last - TRACE_EVENTS : 0;
+
+    for (i = first; i < last; i++)
+    {
+        copy[i - first] = ring->events[i & (TRACE_EVENTS - 1)];
+    }
+
+    // By now the owner may have recorded more events over the oldest ones
+    // and be writing over the next
+    valid = loadCount(&ring->count) + 1 - TRACE_EVENTS;
+
+    if (valid > last)
+    {
+        valid = last;
+    }
+    if (valid > first)
+    {
+        memmove(copy, copy + (valid - first),
+                (size_t)(last - valid) * sizeof(struct TraceEvent));
+        first = valid;
+    }
+
+    return (int)(last - first);
+}
+
+// Write one ring's events as JSON objects, each after a comma, leaving out
+// those from before "since" and ends whose begin was left out or
+// overwritten (returns # of events written)
+static int writeRing(FILE* fp, int tid, const struct TraceEvent events[], int count,
+                     unsigned long long since, double usPerTick)
+{
+    int i, depth = 0, result = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        if (events[i].ticks >= since && (events[i].phase == 'B' || depth > 0))
+        {
+            depth += events[i].phase == 'B' ? 1 : -1;
+
+            fprintf(fp, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d}",
+                    events[i].name, events[i].phase,
+                    (double)(events[i].ticks - traceStartTicks) * usPerTick, tid);
+            result++;
+        }
+    }
+
+    return result;
+}
+
+
+//////////////////////////////////////
+// TRACE FUNCTIONS
+//////////////////////////////////////
+
+// Record the start of a call on this thread's ring (when tracing)
+void traceBegin(const char* name)
+{
+    if (tracing)
+    {
+        recordEvent(name, 'B');
+    }
+}
+
+// Record the end of a call on this thread's ring (when tracing)
+void traceEnd(const char* name)
+{
+    if (tracing)
+    {
+        recordEvent(name, 'E');
+    }
+}
+
+// Give this thread's ring back for another thread to record on (called
+// by a thread as it finishes; its events are kept until overwritten)
+void releaseTraceRing(void)
+{
+    if (threadRing != NULL)
+    {
+        releaseFlag(&threadRing->owned);
+        threadRing = NULL;
+    }
+}
+
+// Start recording events for flushTrace to write to a trace file, keeping
+// those of the last "lastSeconds" seconds (0: all the rings hold)
+// (returns 0 if tracing is compiled out)
+int startTrace(const char* traceFile, double lastSeconds)
+{
+    traceFileName = traceFile;
+    traceSeconds = lastSeconds;
+
+    startStatClock();
+    traceStartTicks = statTicks();
+
+    // The calling thread takes the first ring, shown as the main thread
+    claimRing();
+
+    tracing = 1;
+
+    return 1;
+}
+
+// Write the recorded events to the trace file in the Chrome trace format
+// (JSON), one timeline row per ring, without stopping the threads that
+// record them (returns # of events written, -1 if not tracing or the file
+// could not be written)
+int flushTrace(void)
+{
+    int i, count, rows = 0, result = -1;
+
+    unsigned long long window, since = 0;
+
+    double usPerTick;
+
+    struct TraceEvent* events = NULL;
+
+    FILE* fp = NULL;
+
+    if (tracing && traceFileName != NULL)
+    {
+        usPerTick = statNsPerTick() / 1e3;
+
+        if (traceSeconds > 0)
+        {
+            since = statTicks();
+            window = (unsigned long long)(traceSeconds * 1e6 / usPerTick);
+            since = since > window ? since - window : 0;
+        }
+
+        events = malloc(TRACE_EVENTS * sizeof(struct TraceEvent));
+        fp = events != NULL ? fopen(traceFileName, "w") : NULL;
+    }
+
+    if (fp != NULL)
+    {
+        result = 0;
+
+        fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+        for (i = 0; i < TRACE_THREADS; i++)
+        {
+            if (loadCount(&rings[i].count) > 0)
+            {
+                // Each ring is a row named after it
+                fprintf(fp, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                            "\"args\":{\"name\":\"ring %d%s\"}}", rows++ ? "," : "", i, i,
+                        i ? "" : " (main thread)");
+
+                count = copyRing(&rings[i], events);
+                result += writeRing(fp, i, events, count, since, usPerTick);
+            }
+        }
+
+        fprintf(fp, "\n]}\n");
+
+        if (fclose(fp) != 0)
+        {
+            result = -1;
+        }
+    }
+
+    free(events);
+
+    return result;
+}
+
+#else
+
+// Start recording events (returns 0: tracing is compiled out)
+int startTrace(const char* traceFile, double lastSeconds)
+{
+    (void)traceFile;
+    (void)lastSeconds;
+
+    return 0;
+}
+
+// Write the recorded events (returns -1: tracing is compiled out)
+int flushTrace(void)
+{
+    return -1;
+}
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+//////////////////////////////////////
+// Macros
+//////////////////////////////////////
+
+// Events are recorded unless CLINIC_NO_TRACE is defined, which turns
+// traceBegin, traceEnd and releaseTraceRing into nothing
+#ifndef CLINIC_NO_TRACE
+#define CLINIC_TRACE
+#endif
+
+// Events each thread's ring holds (a power of two); once it is full the
+// oldest are overwritten
+#define TRACE_EVENTS 16384
+
+// Threads that can record at once (a finished thread's ring is reused)
+#define TRACE_THREADS 64
+
+
+//////////////////////////////////////
+// TRACE FUNCTIONS
+//////////////////////////////////////
+
+#ifdef CLINIC_TRACE
+
+// Record the start of a call on this thread's ring (when tracing)
+void traceBegin(const char* name);
+
+// Record the end of a call on this thread's ring (when tracing)
+void traceEnd(const char* name);
+
+// Give this thread's ring back for another thread to record on (called
+// by a thread as it finishes; its events are kept until overwritten)
+void releaseTraceRing(void);
+
+#else
+
+#define traceBegin(name) ((void)0)
+#define traceEnd(name) ((void)0)
+#define releaseTraceRing() ((void)0)
+
+#endif
+
+// Start recording events for flushTrace to write to a trace file, keeping
+// those of the last "lastSeconds" seconds (0: all the rings hold)
+// (returns 0 if tracing is compiled out)
+int startTrace(const char* traceFile, double lastSeconds);
+
+// Write the recorded events to the trace file in the Chrome trace format
+// (JSON), one timeline row per ring, without stopping the threads that
+// record them (returns # of events written, -1 if not tracing or the file
+// could not be written)
+int flushTrace(void);
+
+#endif // !TRACE_H